@@ -1,58 +1,90 @@
-#ifndef AABB_H
-#define AABB_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "rtweekend.h"
-
-class aabb
-{
-public:
-    aabb() {}
-    aabb(const point3& a, const point3& b)
-    {
-        minimum = a;
-        maximum = b;
-    }
-
-    point3 min() const { return minimum; }
-    point3 max() const { return maximum; }
-
-    bool hit(const ray& r, double t_min, double t_max) const
-    {
-        for (int a = 0; a < 3; a++)
-        {
-            auto t0 = fmin((minimum[a] - r.origin()[a]) / r.direction()[a],
-                (maximum[a] - r.origin()[a]) / r.direction()[a]);
-            auto t1 = fmax((minimum[a] - r.origin()[a]) / r.direction()[a],
-                (maximum[a] - r.origin()[a]) / r.direction()[a]);
-            t_min = fmax(t0, t_min);
-            t_max = fmin(t1, t_max);
-            if (t_max <= t_min)
-                return false;
-        }
-        return true;
-    }
-
-    point3 minimum;
-    point3 maximum;
-};
-
-aabb surrounding_box(aabb box0, aabb box1)
-{
-    point3 small(fmin(box0.min().x(), box1.min().x()),
-        fmin(box0.min().y(), box1.min().y()),
-        fmin(box0.min().z(), box1.min().z()));
-
-    point3 big(fmax(box0.max().x(), box1.max().x()),
-        fmax(box0.max().y(), box1.max().y()),
-        fmax(box0.max().z(), box1.max().z()));
-
-    return aabb(small, big);
-}
-
+#ifndef AABB_H
+#define AABB_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+
+template <typename T>
+class basic_aabb
+{
+public:
+    basic_aabb() {}
+    basic_aabb(const basic_vec3<T>& a, const basic_vec3<T>& b)
+    {
+        minimum = a;
+        maximum = b;
+    }
+
+    basic_vec3<T> min() const { return minimum; }
+    basic_vec3<T> max() const { return maximum; }
+
+    T surface_area() const
+    {
+        auto d = maximum - minimum;
+        return 2.0 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    // Multiplies by the ray's cached reciprocals and picks each slab's near plane by
+    // its sign bit, with no divisions and no early exit. A ray lying in a slab's plane
+    // gives 0 * inf = NaN there; the comparisons below keep the old bound rather than
+    // the NaN, so such a ray counts as inside that slab. Boxes of zero thickness, e.g.
+    // around a triangle in an axis plane, are hit when t_min == t_max.
+    bool hit(const basic_ray<T>& r, T t_min, T t_max) const
+    {
+        for (int a = 0; a < 3; a++)
+        {
+            const auto& near_bound = r.sign[a] ? maximum : minimum;
+            const auto& far_bound = r.sign[a] ? minimum : maximum;
+            T t0 = (near_bound[a] - r.orig[a]) * r.inv_dir[a];
+            T t1 = (far_bound[a] - r.orig[a]) * r.inv_dir[a];
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+        }
+        return t_min <= t_max;
+    }
+
+    // hit() with every far distance pushed out by its worst-case rounding (Pharr, Jakob
+    // and Humphreys, "Physically Based Rendering", section 3.9.2), so that a ray through
+    // a face, edge or corner two boxes share enters at least one of them. A mesh's
+    // hierarchy needs that: its leaves meet exactly where its triangles do.
+    bool hit_conservative(const basic_ray<T>& r, T t_min, T t_max) const
+    {
+        const T widen = 1 + 3 * std::numeric_limits<T>::epsilon();
+        for (int a = 0; a < 3; a++)
+        {
+            const auto& near_bound = r.sign[a] ? maximum : minimum;
+            const auto& far_bound = r.sign[a] ? minimum : maximum;
+            T t0 = (near_bound[a] - r.orig[a]) * r.inv_dir[a];
+            T t1 = (far_bound[a] - r.orig[a]) * r.inv_dir[a] * widen;
+            t_min = t0 > t_min ? t0 : t_min;
+            t_max = t1 < t_max ? t1 : t_max;
+        }
+        return t_min <= t_max;
+    }
+
+    basic_vec3<T> minimum;
+    basic_vec3<T> maximum;
+};
+
+using aabb = basic_aabb<real>;
+
+template <typename T>
+basic_aabb<T> surrounding_box(basic_aabb<T> box0, basic_aabb<T> box1)
+{
+    basic_vec3<T> small(fmin(box0.min().x(), box1.min().x()),
+        fmin(box0.min().y(), box1.min().y()),
+        fmin(box0.min().z(), box1.min().z()));
+
+    basic_vec3<T> big(fmax(box0.max().x(), box1.max().x()),
+        fmax(box0.max().y(), box1.max().y()),
+        fmax(box0.max().z(), box1.max().z()));
+
+    return basic_aabb<T>(small, big);
+}
+
 #endif
\ No newline at end of file
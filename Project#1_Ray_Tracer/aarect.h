@@ -1,148 +1,222 @@
-#ifndef AARECT_H
-#define AARECT_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "rtweekend.h"
-#include "hittable.h"
-
-class xy_rect : public hittable
-{
-public:
-    xy_rect() {}
-
-    xy_rect(
-        double _x0, double _x1, double _y0, double _y1, double _k, shared_ptr<material> mat) : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {};
-
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
-    {
-        // The bounding box must have non-zero width in each dimension, so pad the Z
-        // dimension a small amount.
-        output_box = aabb(point3(x0, y0, k - 0.0001), point3(x1, y1, k + 0.0001));
-        return true;
-    }
-
-public:
-    shared_ptr<material> mp;
-    double x0, x1, y0, y1, k;
-};
-
-class xz_rect : public hittable
-{
-public:
-    xz_rect() {}
-
-    xz_rect(
-        double _x0, double _x1, double _z0, double _z1, double _k, shared_ptr<material> mat) : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
-
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
-    {
-        // The bounding box must have non-zero width in each dimension, so pad the Y
-        // dimension a small amount.
-        output_box = aabb(point3(x0, k - 0.0001, z0), point3(x1, k + 0.0001, z1));
-        return true;
-    }
-
-public:
-    shared_ptr<material> mp;
-    double x0, x1, z0, z1, k;
-};
-
-class yz_rect : public hittable
-{
-public:
-    yz_rect() {}
-
-    yz_rect(
-        double _y0, double _y1, double _z0, double _z1, double _k, shared_ptr<material> mat) : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
-
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
-    {
-        // The bounding box must have non-zero width in each dimension, so pad the X
-        // dimension a small amount.
-        output_box = aabb(point3(k - 0.0001, y0, z0), point3(k + 0.0001, y1, z1));
-        return true;
-    }
-
-public:
-    shared_ptr<material> mp;
-    double y0, y1, z0, z1, k;
-};
-
-bool xy_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
-{
-    auto t = (k - r.origin().z()) / r.direction().z();
-    if (t < t_min || t > t_max)
-        return false;
-
-    auto x = r.origin().x() + t * r.direction().x();
-    auto y = r.origin().y() + t * r.direction().y();
-    if (x < x0 || x > x1 || y < y0 || y > y1)
-        return false;
-
-    rec.u = (x - x0) / (x1 - x0);
-    rec.v = (y - y0) / (y1 - y0);
-    rec.t = t;
-    auto outward_normal = vec3(0, 0, 1);
-    rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
-    rec.p = r.at(t);
-
-    return true;
-}
-
-bool xz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
-{
-    auto t = (k - r.origin().y()) / r.direction().y();
-    if (t < t_min || t > t_max)
-        return false;
-
-    auto x = r.origin().x() + t * r.direction().x();
-    auto z = r.origin().z() + t * r.direction().z();
-    if (x < x0 || x > x1 || z < z0 || z > z1)
-        return false;
-
-    rec.u = (x - x0) / (x1 - x0);
-    rec.v = (z - z0) / (z1 - z0);
-    rec.t = t;
-    auto outward_normal = vec3(0, 1, 0);
-    rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
-    rec.p = r.at(t);
-
-    return true;
-}
-
-bool yz_rect::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
-{
-    auto t = (k - r.origin().x()) / r.direction().x();
-    if (t < t_min || t > t_max)
-        return false;
-
-    auto y = r.origin().y() + t * r.direction().y();
-    auto z = r.origin().z() + t * r.direction().z();
-    if (y < y0 || y > y1 || z < z0 || z > z1)
-        return false;
-
-    rec.u = (y - y0) / (y1 - y0);
-    rec.v = (z - z0) / (z1 - z0);
-    rec.t = t;
-    auto outward_normal = vec3(1, 0, 0);
-    rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
-    rec.p = r.at(t);
-
-    return true;
-}
-
+#ifndef AARECT_H
+#define AARECT_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+class xy_rect : public hittable
+{
+public:
+    xy_rect() {}
+
+    xy_rect(
+        real _x0, real _x1, real _y0, real _y1, real _k, uint32_t mat) : x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mat_id(mat) {};
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    // Geometry-only test shared with box and primitive_list; leaves rec.mat_id alone.
+    static bool intersect(
+        real _x0, real _x1, real _y0, real _y1, real _k,
+        const ray& r, real t_min, real t_max, hit_record& rec);
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
+    {
+        // The bounding box must have non-zero width in each dimension, so pad the Z
+        // dimension a small amount.
+        output_box = aabb(point3(x0, y0, k - 0.0001), point3(x1, y1, k + 0.0001));
+        return true;
+    }
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override
+    {
+        return finish_packet(packet, packet_simd().rect(packet, { 2, 0, 1, k, x0, x1, y0, y1 }, t_min), t_min);
+    }
+
+public:
+    real x0, x1, y0, y1, k;
+    uint32_t mat_id;
+};
+
+class xz_rect : public hittable
+{
+public:
+    xz_rect() {}
+
+    xz_rect(
+        real _x0, real _x1, real _z0, real _z1, real _k, uint32_t mat) : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    // Geometry-only test shared with box and primitive_list; leaves rec.mat_id alone.
+    static bool intersect(
+        real _x0, real _x1, real _z0, real _z1, real _k,
+        const ray& r, real t_min, real t_max, hit_record& rec);
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
+    {
+        // The bounding box must have non-zero width in each dimension, so pad the Y
+        // dimension a small amount.
+        output_box = aabb(point3(x0, k - 0.0001, z0), point3(x1, k + 0.0001, z1));
+        return true;
+    }
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override
+    {
+        return finish_packet(packet, packet_simd().rect(packet, { 1, 0, 2, k, x0, x1, z0, z1 }, t_min), t_min);
+    }
+
+public:
+    real x0, x1, z0, z1, k;
+    uint32_t mat_id;
+};
+
+class yz_rect : public hittable
+{
+public:
+    yz_rect() {}
+
+    yz_rect(
+        real _y0, real _y1, real _z0, real _z1, real _k, uint32_t mat) : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mat_id(mat) {};
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    // Geometry-only test shared with box and primitive_list; leaves rec.mat_id alone.
+    static bool intersect(
+        real _y0, real _y1, real _z0, real _z1, real _k,
+        const ray& r, real t_min, real t_max, hit_record& rec);
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
+    {
+        // The bounding box must have non-zero width in each dimension, so pad the X
+        // dimension a small amount.
+        output_box = aabb(point3(k - 0.0001, y0, z0), point3(k + 0.0001, y1, z1));
+        return true;
+    }
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override
+    {
+        return finish_packet(packet, packet_simd().rect(packet, { 0, 1, 2, k, y0, y1, z0, z1 }, t_min), t_min);
+    }
+
+public:
+    real y0, y1, z0, z1, k;
+    uint32_t mat_id;
+};
+
+bool xy_rect::hit(const ray& r, real t_min, real t_max, hit_record& rec) const
+{
+    if (!intersect(x0, x1, y0, y1, k, r, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    return true;
+}
+
+bool xy_rect::intersect(
+    real _x0, real _x1, real _y0, real _y1, real _k,
+    const ray& r, real t_min, real t_max, hit_record& rec)
+{
+    count_stat(stat_counter::xy_rect_tests);
+    // A ray lying in the plane gives t = 0/0; NaN fails every comparison, so the test
+    // is written to reject it.
+    auto t = (_k - r.origin().z()) / r.direction().z();
+    if (!(t >= t_min && t <= t_max))
+        return false;
+
+    auto x = r.origin().x() + t * r.direction().x();
+    auto y = r.origin().y() + t * r.direction().y();
+    if (x < _x0 || x > _x1 || y < _y0 || y > _y1)
+        return false;
+
+    rec.u = (x - _x0) / (_x1 - _x0);
+    rec.v = (y - _y0) / (_y1 - _y0);
+    rec.uv_scale = std::fmin(_x1 - _x0, _y1 - _y0);
+    rec.t = t;
+    auto outward_normal = vec3(0, 0, 1);
+    rec.set_face_normal(r, outward_normal);
+    rec.p = r.at(t);
+    if (precision_traits<real>::offset_origins)
+        rec.p[2] = _k;   // exactly on the plane, so no margin is needed off it
+    rec.p_error = 0;
+
+    return true;
+}
+
+bool xz_rect::hit(const ray& r, real t_min, real t_max, hit_record& rec) const
+{
+    if (!intersect(x0, x1, z0, z1, k, r, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    return true;
+}
+
+bool xz_rect::intersect(
+    real _x0, real _x1, real _z0, real _z1, real _k,
+    const ray& r, real t_min, real t_max, hit_record& rec)
+{
+    count_stat(stat_counter::xz_rect_tests);
+    auto t = (_k - r.origin().y()) / r.direction().y();
+    if (!(t >= t_min && t <= t_max))
+        return false;
+
+    auto x = r.origin().x() + t * r.direction().x();
+    auto z = r.origin().z() + t * r.direction().z();
+    if (x < _x0 || x > _x1 || z < _z0 || z > _z1)
+        return false;
+
+    rec.u = (x - _x0) / (_x1 - _x0);
+    rec.v = (z - _z0) / (_z1 - _z0);
+    rec.uv_scale = std::fmin(_x1 - _x0, _z1 - _z0);
+    rec.t = t;
+    auto outward_normal = vec3(0, 1, 0);
+    rec.set_face_normal(r, outward_normal);
+    rec.p = r.at(t);
+    if (precision_traits<real>::offset_origins)
+        rec.p[1] = _k;   // exactly on the plane, so no margin is needed off it
+    rec.p_error = 0;
+
+    return true;
+}
+
+bool yz_rect::hit(const ray& r, real t_min, real t_max, hit_record& rec) const
+{
+    if (!intersect(y0, y1, z0, z1, k, r, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    return true;
+}
+
+bool yz_rect::intersect(
+    real _y0, real _y1, real _z0, real _z1, real _k,
+    const ray& r, real t_min, real t_max, hit_record& rec)
+{
+    count_stat(stat_counter::yz_rect_tests);
+    auto t = (_k - r.origin().x()) / r.direction().x();
+    if (!(t >= t_min && t <= t_max))
+        return false;
+
+    auto y = r.origin().y() + t * r.direction().y();
+    auto z = r.origin().z() + t * r.direction().z();
+    if (y < _y0 || y > _y1 || z < _z0 || z > _z1)
+        return false;
+
+    rec.u = (y - _y0) / (_y1 - _y0);
+    rec.v = (z - _z0) / (_z1 - _z0);
+    rec.uv_scale = std::fmin(_y1 - _y0, _z1 - _z0);
+    rec.t = t;
+    auto outward_normal = vec3(1, 0, 0);
+    rec.set_face_normal(r, outward_normal);
+    rec.p = r.at(t);
+    if (precision_traits<real>::offset_origins)
+        rec.p[0] = _k;   // exactly on the plane, so no margin is needed off it
+    rec.p_error = 0;
+
+    return true;
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,178 @@
+#ifndef AOV_H
+#define AOV_H
+
+#include "rtweekend.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "material_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// First-hit feature buffers (AOVs) that guide the denoiser: the albedo, normal and
+// distance of whatever each camera ray hit first. Like the radiance, they are summed
+// per sample and averaged on use, so edges come out antialiased in the same way.
+//
+// The integrator describes its first hit with record_first_hit(), which leaves the
+// features in a per-thread slot; the tile renderer picks them up from there after each
+// sample, the way it parks the thread's generator and sampler between lanes.
+
+struct surface_features {
+    color albedo;
+    vec3 normal;
+    double depth;
+};
+
+// Stands in for the depth of rays that leave the scene, so that the denoiser's
+// relative depth test always tells sky from geometry.
+const double background_depth = 1e6;
+
+inline surface_features& current_features() {
+    // One per render thread, like current_sampler().
+    thread_local surface_features f;
+    return f;
+}
+
+// The features of the first vertex of a path. Primary hits on glass and mirror-like
+// metal (fuzz below 0.1) are followed along the refracted or reflected direction to
+// the next surface, up to max_specular_vertices times, so that what is seen through
+// them keeps its edges; the depth then adds up along the way and a mirror's albedo
+// tints what it reflects. Following them traces extra rays but draws no random
+// numbers, so the image is the same with or without features.
+//
+// A miss takes the background as its albedo and faces the camera. Materials without
+// an albedo of their own count as white, and lights as their emission scaled to a
+// brightest channel of 1. Textured albedos are filtered over a ray cone of the given
+// pixel_spread, as in shade_path().
+inline void record_first_hit(
+    ray r, bool hit, hit_record rec, const color& background, const hittable& world, const material_table& materials,
+    double pixel_spread = 0
+) {
+    const int max_specular_vertices = 4;
+    const double mirror_fuzz = 0.1;
+
+    auto& f = current_features();
+    color tint(1, 1, 1);
+    double distance = 0;
+    for (int vertex = 0; ; ++vertex) {
+        if (!hit) {
+            f.albedo = tint * background;
+            f.normal = -unit_vector(r.direction());
+            f.depth = background_depth;
+            return;
+        }
+
+        f.normal = rec.normal;
+        distance += rec.t * r.direction().length();
+        f.depth = distance;
+
+        auto type = materials.type[rec.mat_id];
+        bool mirror = type == material_type::metal && materials.fuzz[rec.mat_id] < mirror_fuzz;
+        if ((type == material_type::dielectric || mirror) && vertex < max_specular_vertices) {
+            auto unit_direction = unit_vector(r.direction());
+            vec3 direction = reflect(unit_direction, rec.normal);
+            if (mirror) {
+                tint = tint * materials.albedo[rec.mat_id];
+            }
+            else {
+                double ratio = rec.front_face ? 1.0 / materials.ir[rec.mat_id] : materials.ir[rec.mat_id];
+                double cos_theta = std::fmin(dot(-unit_direction, rec.normal), 1.0);
+                if (ratio * std::sqrt(1.0 - cos_theta * cos_theta) <= 1.0)
+                    direction = refract(unit_direction, rec.normal, ratio);
+            }
+            r = rec.spawn_ray(direction);
+            hit = world.hit(r, ray_t_min, infinity, rec);
+            continue;
+        }
+
+        switch (type) {
+        case material_type::lambertian:
+        case material_type::metal:
+            f.albedo = tint * materials.albedo_at(rec.mat_id, r, rec, pixel_spread * distance);
+            break;
+        case material_type::diffuse_light: {
+            auto e = materials.emitted(rec.mat_id, rec.u, rec.v, rec.p);
+            auto brightest = std::max(e.x(), std::max(e.y(), e.z()));
+            f.albedo = brightest > 0 ? tint * (e / brightest) : color(0, 0, 0);
+            break;
+        }
+        default:
+            f.albedo = tint;
+            break;
+        }
+        return;
+    }
+}
+
+class feature_buffers {
+public:
+    feature_buffers(int w, int h)
+        : width(w), height(h), albedo(static_cast<size_t>(w) * h), normal(albedo.size()),
+          depth(albedo.size(), 0.0), samples(albedo.size(), 0) {}
+
+    void add_sample(size_t pixel, const surface_features& f) {
+        albedo[pixel] += f.albedo;
+        normal[pixel] += f.normal;
+        depth[pixel] += f.depth;
+        samples[pixel]++;
+    }
+
+    // The averaged features of one pixel; the normal is renormalized.
+    surface_features resolve(size_t pixel) const;
+
+    // The buffers as images for write_image(): the albedo as it is, normals mapped from
+    // [-1, 1] to [0, 1] and the depth in all three channels (best written as .pfm).
+    framebuffer albedo_image() const;
+    framebuffer normal_image() const;
+    framebuffer depth_image() const;
+
+public:
+    int width;
+    int height;
+    std::vector<color> albedo;
+    std::vector<vec3> normal;
+    std::vector<double> depth;
+    std::vector<int> samples;
+};
+
+surface_features feature_buffers::resolve(size_t pixel) const {
+    surface_features f{ color(0, 0, 0), vec3(0, 0, 0), background_depth };
+    auto n = samples[pixel];
+    if (n == 0)
+        return f;
+
+    f.albedo = albedo[pixel] / n;
+    f.depth = depth[pixel] / n;
+    auto length = normal[pixel].length();
+    if (length > 0)
+        f.normal = normal[pixel] / length;
+    return f;
+}
+
+framebuffer feature_buffers::albedo_image() const {
+    framebuffer image(width, height);
+    for (size_t p = 0; p < samples.size(); ++p)
+        image.add_sample(p, resolve(p).albedo);
+    return image;
+}
+
+framebuffer feature_buffers::normal_image() const {
+    framebuffer image(width, height);
+    for (size_t p = 0; p < samples.size(); ++p) {
+        auto n = resolve(p).normal;
+        image.add_sample(p, 0.5 * color(n.x() + 1, n.y() + 1, n.z() + 1));
+    }
+    return image;
+}
+
+framebuffer feature_buffers::depth_image() const {
+    framebuffer image(width, height);
+    for (size_t p = 0; p < samples.size(); ++p) {
+        auto d = resolve(p).depth;
+        image.add_sample(p, color(d, d, d));
+    }
+    return image;
+}
+
+#endif
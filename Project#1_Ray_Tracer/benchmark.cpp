@@ -0,0 +1,646 @@
+// Microbenchmarks for the intersection kernels and the materials, and timed renders of
+// the built-in scenes (and of any scene files named with --scene) at a fixed size and
+// sample count. A second program next to main.cpp, built on Linux with
+//
+//     make benchmark        (g++ -std=c++17 -O2 -pthread benchmark.cpp -o benchmark)
+//
+// Command line: [--json FILE] [--baseline FILE] [--filter TEXT] [--quick]
+//               [--width N] [--spp N] [--threads N] [--scene FILE]...
+// Results go to stdout as a table: wall time of the fastest repetition, ns per
+// operation, and Mrays/s. For the kernels one operation is one ray against one object
+// (one call to hittable_list::hit, i.e. one ray, for the lists and meshes), for the
+// materials one scatter(), for the textures one lookup, and for the renders one ray of
+// any kind traced through the world.
+// --json also writes them as JSON, one result per line, so runs on two commits can be
+// diffed; --baseline reads such a file back and prints the change against it.
+// --filter runs only the benchmarks whose name contains the text, and --quick trades
+// accuracy for a run of a few seconds. --width and --spp set the render size (384 and
+// 16 by default; the aspect ratio stays the scene's), --threads the render workers.
+
+#include "rtweekend.h"
+
+#include "aabb.h"
+#include "aarect.h"
+#include "box.h"
+#include "bvh.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "hittable_list.h"
+#include "image_texture.h"
+#include "integrator.h"
+#include "lights.h"
+#include "material.h"
+#include "material_table.h"
+#include "mesh.h"
+#include "primitive.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scenes.h"
+#include "sphere.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+struct benchmark_options {
+    std::string filter;
+    double min_seconds = 0.2;   // per repetition
+    int repetitions = 5;
+    int render_repetitions = 3;
+    int width = 384;
+    int samples_per_pixel = 16;
+    unsigned threads = 0;
+};
+
+bool selected(const benchmark_options& options, const std::string& name) {
+    return name.find(options.filter) != std::string::npos;
+}
+
+struct benchmark_result {
+    std::string name;
+    std::string group;              // kernel, list, mesh, material, texture or render
+    long long operations = 0;       // per repetition
+    double seconds = 0;             // fastest repetition
+    double ns_per_op = 0;
+    double mrays_per_s = 0;
+    double ns_per_intersection = 0; // lists only: ns_per_op over the list size
+    double hit_rate = -1;           // kernels and lists: fraction of operations that hit
+    double build_seconds = 0;       // renders only: scene set-up and BVH build
+};
+
+// Where the benchmarks put their results so that the compiler cannot drop the work.
+volatile double benchmark_sink;
+
+using clock_type = std::chrono::steady_clock;
+
+double seconds_since(clock_type::time_point start) {
+    return std::chrono::duration<double>(clock_type::now() - start).count();
+}
+
+// Repeats batch() until one repetition takes at least min_seconds, then keeps the
+// fastest of several such repetitions. batch() does a fixed amount of work and
+// returns how many operations that was.
+template <typename Batch>
+void time_batches(const benchmark_options& options, benchmark_result& result, Batch&& batch) {
+    long long batches = 1;
+    for (;;) {
+        auto start = clock_type::now();
+        long long operations = 0;
+        for (long long b = 0; b < batches; ++b)
+            operations += batch();
+        double elapsed = seconds_since(start);
+        if (elapsed >= options.min_seconds || batches >= (1LL << 40)) {
+            result.operations = operations;
+            result.seconds = elapsed;
+            break;
+        }
+        batches = elapsed > 0 ? std::max(batches * 2, static_cast<long long>(batches * 1.2 * options.min_seconds / elapsed)) : batches * 2;
+    }
+
+    for (int rep = 1; rep < options.repetitions; ++rep) {
+        auto start = clock_type::now();
+        for (long long b = 0; b < batches; ++b)
+            batch();
+        result.seconds = std::min(result.seconds, seconds_since(start));
+    }
+
+    result.ns_per_op = 1e9 * result.seconds / result.operations;
+    result.mrays_per_s = result.operations / result.seconds / 1e6;
+}
+
+// Rays from a cube around the objects toward random points inside it, so that a
+// fair share of them hits.
+std::vector<ray> random_rays(size_t count) {
+    std::vector<ray> rays;
+    for (size_t i = 0; i < count; ++i) {
+        point3 origin(random_double(-4, 4), random_double(-4, 4), random_double(-4, 4));
+        point3 target(random_double(-1, 1), random_double(-1, 1), random_double(-1, 1));
+        rays.push_back(ray(origin, target - origin));
+    }
+    return rays;
+}
+
+point3 random_point() {
+    return point3(random_double(-1, 1), random_double(-1, 1), random_double(-1, 1));
+}
+
+// Every ray against every one of count objects; test(i, r, rec) intersects object i.
+template <typename Test>
+benchmark_result bench_intersections(
+    const std::string& name, size_t count, const std::vector<ray>& rays, const benchmark_options& options, Test&& test
+) {
+    benchmark_result result;
+    result.name = name;
+    result.group = "kernel";
+    long long hits = 0;
+    time_batches(options, result, [&] {
+        hit_record rec;
+        long long batch_hits = 0;
+        double sum = 0;
+        for (const auto& r : rays) {
+            for (size_t i = 0; i < count; ++i) {
+                if (test(i, r, rec)) {
+                    ++batch_hits;
+                    sum += rec.t;
+                }
+            }
+        }
+        benchmark_sink = benchmark_sink + sum;
+        hits = batch_hits;
+        return static_cast<long long>(rays.size() * count);
+    });
+    result.hit_rate = static_cast<double>(hits) / (rays.size() * count);
+    return result;
+}
+
+void bench_kernels(const benchmark_options& options, const std::vector<ray>& rays, std::vector<benchmark_result>& results) {
+    const size_t count = 64;
+
+    std::vector<sphere> spheres;
+    std::vector<aabb> boxes;
+    std::vector<xy_rect> rects;
+    std::vector<box> solid_boxes;
+    for (size_t i = 0; i < count; ++i) {
+        spheres.push_back(sphere(random_point(), random_double(0.1, 0.5), 0));
+        point3 c = random_point();
+        vec3 half(random_double(0.1, 0.5), random_double(0.1, 0.5), random_double(0.1, 0.5));
+        boxes.push_back(aabb(c - half, c + half));
+        solid_boxes.push_back(box(c - half, c + half, 0));
+        rects.push_back(xy_rect(c.x() - half.x(), c.x() + half.x(), c.y() - half.y(), c.y() + half.y(), c.z(), 0));
+    }
+
+    // Qualified calls, so each loop measures the kernel rather than the virtual call.
+    if (selected(options, "sphere::hit"))
+        results.push_back(bench_intersections("sphere::hit", count, rays, options, [&](size_t i, const ray& r, hit_record& rec) {
+            return spheres[i].sphere::hit(r, ray_t_min, infinity, rec);
+        }));
+    if (selected(options, "aabb::hit"))
+        results.push_back(bench_intersections("aabb::hit", count, rays, options, [&](size_t i, const ray& r, hit_record& rec) {
+            rec.t = 0;
+            return boxes[i].hit(r, ray_t_min, infinity);
+        }));
+    if (selected(options, "xy_rect::hit"))
+        results.push_back(bench_intersections("xy_rect::hit", count, rays, options, [&](size_t i, const ray& r, hit_record& rec) {
+            return rects[i].xy_rect::hit(r, ray_t_min, infinity, rec);
+        }));
+    if (selected(options, "box::hit"))
+        results.push_back(bench_intersections("box::hit", count, rays, options, [&](size_t i, const ray& r, hit_record& rec) {
+            return solid_boxes[i].box::hit(r, ray_t_min, infinity, rec);
+        }));
+}
+
+void bench_lists(const benchmark_options& options, const std::vector<ray>& rays, std::vector<benchmark_result>& results) {
+    for (size_t size : { 1, 8, 64, 512 }) {
+        auto name = "hittable_list::hit/" + std::to_string(size);
+        if (!selected(options, name))
+            continue;
+
+        // Smaller spheres in longer lists keep the hit rate from saturating.
+        hittable_list list;
+        auto radius = 0.5 / std::cbrt(static_cast<double>(size));
+        for (size_t i = 0; i < size; ++i)
+            list.add(make_shared<sphere>(random_point(), random_double(0.5, 1) * radius, 0));
+
+        auto result = bench_intersections(name, 1, rays, options, [&](size_t, const ray& r, hit_record& rec) {
+            return list.hit(r, ray_t_min, infinity, rec);
+        });
+        result.group = "list";
+        result.ns_per_intersection = result.ns_per_op / size;
+        results.push_back(result);
+    }
+}
+
+// A tessellated sphere of radius 1, as a triangle_mesh and as the same triangles in a
+// bvh_node, which is how a scene file's "triangle" statements are traced.
+void bench_meshes(const benchmark_options& options, const std::vector<ray>& rays, std::vector<benchmark_result>& results) {
+    for (int rings : { 16, 64 }) {
+        int segments = 2 * rings;
+        triangle_mesh mesh;
+        for (int j = 0; j <= rings; ++j) {
+            double theta = pi * j / rings;
+            for (int i = 0; i < segments; ++i) {
+                double phi = 2 * pi * i / segments;
+                mesh.add_position(point3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+            }
+        }
+        std::vector<primitive> triangles;
+        auto add = [&](uint32_t a, uint32_t b, uint32_t c) {
+            triangle_mesh::face f = {};
+            f.position[0] = a;
+            f.position[1] = b;
+            f.position[2] = c;
+            for (int k = 0; k < 3; ++k)
+                f.normal[k] = f.uv[k] = triangle_mesh::no_index;
+            mesh.add_face(f);
+            triangles.push_back(primitive::make_triangle(mesh.positions[a], mesh.positions[b], mesh.positions[c], 0));
+        };
+        for (int j = 0; j < rings; ++j) {
+            for (int i = 0; i < segments; ++i) {
+                uint32_t a = j * segments + i, b = j * segments + (i + 1) % segments;
+                if (j > 0)
+                    add(a, b, a + segments);
+                if (j + 1 < rings)
+                    add(b, b + segments, a + segments);
+            }
+        }
+        mesh.build();
+        bvh_node tree(triangles.data(), triangles.size());
+
+        auto size = std::to_string(triangles.size());
+        auto run = [&](const std::string& name, const hittable& object) {
+            if (!selected(options, name))
+                return;
+            auto result = bench_intersections(name, 1, rays, options, [&](size_t, const ray& r, hit_record& rec) {
+                return object.hit(r, ray_t_min, infinity, rec);
+            });
+            result.group = "mesh";
+            results.push_back(result);
+        };
+        run("triangle_mesh::hit/" + size, mesh);
+        run("bvh_node::hit/tris/" + size, tree);
+    }
+}
+
+void bench_materials(const benchmark_options& options, std::vector<benchmark_result>& results) {
+    // Rays arriving at a point on the plane y = 0 from both sides, so that dielectric
+    // sees both entering and leaving rays.
+    const size_t count = 1024;
+    std::vector<ray> incoming;
+    std::vector<hit_record> records;
+    for (size_t i = 0; i < count; ++i) {
+        point3 p(random_double(-1, 1), 0, random_double(-1, 1));
+        vec3 d = random_unit_vector();
+        ray r(p - d, d);
+        hit_record rec;
+        rec.t = 1;
+        rec.p = p;
+        rec.p_error = 0;
+        rec.mat_id = 0;
+        rec.u = rec.v = 0.5;
+        rec.uv_scale = 0;
+        rec.set_face_normal(r, vec3(0, 1, 0));
+        incoming.push_back(r);
+        records.push_back(rec);
+    }
+
+    std::vector<std::pair<std::string, shared_ptr<material>>> materials = {
+        { "lambertian::scatter", make_shared<lambertian>(color(0.7, 0.3, 0.3)) },
+        { "metal::scatter", make_shared<metal>(color(0.8, 0.8, 0.8), 0.3) },
+        { "dielectric::scatter", make_shared<dielectric>(1.5) },
+        { "diffuse_light::scatter", make_shared<diffuse_light>(color(4, 4, 4)) },
+    };
+
+    for (const auto& named : materials) {
+        if (!selected(options, named.first))
+            continue;
+
+        benchmark_result result;
+        result.name = named.first;
+        result.group = "material";
+        const material& m = *named.second;
+        time_batches(options, result, [&] {
+            double sum = 0;
+            for (size_t i = 0; i < count; ++i) {
+                color attenuation(0, 0, 0);
+                ray scattered;
+                if (m.scatter(incoming[i], records[i], attenuation, scattered))
+                    sum += scattered.direction().x() + attenuation.x();
+                sum += m.emitted(records[i].u, records[i].v, records[i].p).x();
+            }
+            benchmark_sink = benchmark_sink + sum;
+            return static_cast<long long>(count);
+        });
+        result.mrays_per_s = 0;   // no rays traced
+        results.push_back(result);
+    }
+}
+
+void bench_textures(const benchmark_options& options, std::vector<benchmark_result>& results) {
+    // A 2048x2048 image of random bytes, so that neighbouring texels differ, looked up
+    // at random points: the worst case for the tile cache. Full resolution fits in the
+    // default cache once expanded (48 MB); the capped run evicts on most lookups, and
+    // the filtered one reads the level of 8x8 texel footprints.
+    const int size = 2048;
+    std::vector<uint8_t> rgb(static_cast<size_t>(size) * size * 3);
+    for (auto& b : rgb)
+        b = static_cast<uint8_t>(random_double() * 256);
+    image_texture image(make_shared<mip_pyramid>("noise", rgb.data(), size, size));
+
+    const size_t count = 4096;
+    std::vector<std::pair<double, double>> uvs;
+    for (size_t i = 0; i < count; ++i)
+        uvs.emplace_back(random_double(), random_double());
+
+    struct variant {
+        std::string name;
+        double footprint;
+        size_t capacity;
+    };
+    const size_t default_capacity = texture_tiles().capacity_bytes();
+    for (const auto& v : { variant{ "image_texture::value", 0, default_capacity },
+                           variant{ "image_texture::value/4MB", 0, size_t(4) << 20 },
+                           variant{ "image_texture::filtered/8x8", 8.0 / size, default_capacity } }) {
+        if (!selected(options, v.name))
+            continue;
+
+        benchmark_result result;
+        result.name = v.name;
+        result.group = "texture";
+        texture_tiles().set_capacity(v.capacity);
+        time_batches(options, result, [&] {
+            double sum = 0;
+            for (const auto& uv : uvs)
+                sum += image.filtered(uv.first, uv.second, point3(0, 0, 0), v.footprint).x();
+            benchmark_sink = benchmark_sink + sum;
+            return static_cast<long long>(count);
+        });
+        texture_tiles().set_capacity(default_capacity);
+        result.mrays_per_s = 0;   // no rays traced
+        results.push_back(result);
+    }
+}
+
+// Counts the rays traced through the world it wraps: camera, bounce and shadow rays
+// alike. Each thread counts on its own and adds its count to the total as it exits,
+// so the render workers never share a counter.
+struct thread_ray_count {
+    long long rays = 0;
+    ~thread_ray_count() { total() += rays; }
+
+    static std::atomic<long long>& total() {
+        static std::atomic<long long> sum(0);
+        return sum;
+    }
+
+    static thread_ray_count& local() {
+        thread_local thread_ray_count count;
+        return count;
+    }
+
+    // The total so far, including the calling thread's own rays; starts over at zero.
+    static long long take() {
+        long long rays = total().exchange(0) + local().rays;
+        local().rays = 0;
+        return rays;
+    }
+};
+
+class counting_hittable : public hittable {
+public:
+    counting_hittable(const hittable& world) : world(world) {}
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override {
+        ++thread_ray_count::local().rays;
+        return world.hit(r, t_min, t_max, rec);
+    }
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override {
+        return world.bounding_box(time0, time1, output_box);
+    }
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override {
+        for (int k = 0; k < packet_width; ++k)
+            thread_ray_count::local().rays += packet.active >> k & 1;
+        return world.hit_packet(packet, t_min);
+    }
+
+private:
+    const hittable& world;
+};
+
+// Renders the scene the way main() does by default: Sobol samples, packets for the
+// primary rays, and the iterative integrator with next-event estimation.
+benchmark_result bench_render(const std::string& name, const scene_description& scene, const benchmark_options& options) {
+    const int roulette_depth = 3;
+
+    benchmark_result result;
+    result.name = name;
+    result.group = "render";
+
+    auto build_start = clock_type::now();
+    const auto& settings = scene.settings;
+    material_table materials;
+    scene.build_materials(materials);
+    light_list lights;
+    for (size_t i = 0; i < scene.primitive_count(); ++i)
+        lights.add(scene.primitives()[i], materials);
+    std::vector<shared_ptr<hittable>> instances;
+    scene.build_instances(instances);
+    bvh_node world_bvh(scene.primitives(), scene.primitive_count(), instances);
+    result.build_seconds = seconds_since(build_start);
+
+    counting_hittable world(world_bvh);
+    const int image_width = options.width;
+    const int image_height = static_cast<int>(image_width / settings.aspect_ratio);
+    camera cam(settings.lookfrom, settings.lookat, settings.vup, settings.vfov, settings.aspect_ratio);
+
+    tile_renderer renderer(32, options.threads);
+    renderer.sampling.type = sampler_type::sobol;
+    renderer.sampling.samples_per_pixel = options.samples_per_pixel;
+
+    packet_tracer tracer;
+    tracer.world = &world;
+    tracer.primary = [&](int i, int j) {
+        double du, dv;
+        sample_2d(du, dv);
+        return cam.get_ray((i + du) / (image_width - 1), (j + dv) / (image_height - 1));
+    };
+    tracer.shade = [&](const ray& r, bool hit, const hit_record& rec) {
+        return shade_path(r, hit, rec, settings.background, world, materials, settings.max_depth, roulette_depth, &lights);
+    };
+
+    for (int rep = 0; rep < options.render_repetitions; ++rep) {
+        framebuffer image(image_width, image_height);
+        thread_ray_count::take();
+        auto start = clock_type::now();
+        renderer.render(image, settings.seed, 0, options.samples_per_pixel, tracer);
+        double elapsed = seconds_since(start);
+        result.operations = thread_ray_count::take();
+        result.seconds = rep == 0 ? elapsed : std::min(result.seconds, elapsed);
+    }
+
+    result.ns_per_op = 1e9 * result.seconds / result.operations;
+    result.mrays_per_s = result.operations / result.seconds / 1e6;
+    return result;
+}
+
+std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            out += c;
+    }
+    return out + '"';
+}
+
+bool write_json(const std::string& path, const benchmark_options& options, const std::vector<benchmark_result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write " << path << ".\n";
+        return false;
+    }
+
+    out << "{\n";
+#ifdef RT_REVISION
+    out << "  \"revision\": " << json_string(RT_REVISION) << ",\n";
+#endif
+#ifdef __VERSION__
+    out << "  \"compiler\": " << json_string(__VERSION__) << ",\n";
+#endif
+    out << "  \"precision\": \"" << (sizeof(real) == sizeof(float) ? "float32" : "float64") << "\",\n";
+    out << "  \"packets\": \"" << packet_simd().name << "\",\n";
+    out << "  \"threads\": " << (options.threads ? options.threads : tile_renderer::default_thread_count()) << ",\n";
+    out << "  \"width\": " << options.width << ",\n";
+    out << "  \"samples_per_pixel\": " << options.samples_per_pixel << ",\n";
+    out << "  \"results\": [\n";
+    out.precision(6);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        out << "    { \"name\": " << json_string(r.name) << ", \"group\": \"" << r.group << '"'
+            << ", \"operations\": " << r.operations << ", \"seconds\": " << r.seconds
+            << ", \"ns_per_op\": " << r.ns_per_op << ", \"mrays_per_s\": " << r.mrays_per_s;
+        if (r.ns_per_intersection > 0)
+            out << ", \"ns_per_intersection\": " << r.ns_per_intersection;
+        if (r.hit_rate >= 0)
+            out << ", \"hit_rate\": " << r.hit_rate;
+        if (r.group == "render")
+            out << ", \"build_seconds\": " << r.build_seconds;
+        out << " }" << (i + 1 < results.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+// Reads ns_per_op by name back out of a file written by write_json(), which puts
+// every result on a line of its own.
+bool read_baseline(const std::string& path, std::map<std::string, double>& ns_per_op) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open " << path << ".\n";
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line)) {
+        auto name_at = line.find("\"name\": \"");
+        auto ns_at = line.find("\"ns_per_op\": ");
+        if (name_at == std::string::npos || ns_at == std::string::npos)
+            continue;
+        name_at += 9;
+        std::string name;
+        for (auto i = name_at; i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size())
+                ++i;
+            name += line[i];
+        }
+        ns_per_op[name] = std::atof(line.c_str() + ns_at + 13);
+    }
+    return true;
+}
+
+void print_results(const std::vector<benchmark_result>& results, const std::map<std::string, double>& baseline) {
+    std::printf("%-28s %12s %12s %10s %10s%s\n", "benchmark", "time (s)", "ns/op", "Mrays/s", "ns/isect",
+                baseline.empty() ? "" : "   vs baseline");
+    for (const auto& r : results) {
+        std::printf("%-28s %12.4f %12.2f ", r.name.c_str(), r.seconds, r.ns_per_op);
+        if (r.mrays_per_s > 0)
+            std::printf("%10.2f ", r.mrays_per_s);
+        else
+            std::printf("%10s ", "-");
+        if (r.ns_per_intersection > 0)
+            std::printf("%10.2f", r.ns_per_intersection);
+        else
+            std::printf("%10s", "-");
+
+        // Positive is slower than the baseline.
+        auto old = baseline.find(r.name);
+        if (old != baseline.end() && old->second > 0)
+            std::printf("   %+7.1f%%", 100 * (r.ns_per_op / old->second - 1));
+        std::printf("\n");
+    }
+}
+
+int main(int argc, char* argv[]) {
+    benchmark_options options;
+    std::string json_path;
+    std::string baseline_path;
+    std::vector<std::string> scene_paths;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (arg == "--json" && has_value)
+            json_path = argv[++a];
+        else if (arg == "--baseline" && has_value)
+            baseline_path = argv[++a];
+        else if (arg == "--filter" && has_value)
+            options.filter = argv[++a];
+        else if (arg == "--quick") {
+            options.min_seconds = 0.02;
+            options.repetitions = 2;
+            options.render_repetitions = 1;
+        }
+        else if (arg == "--width" && has_value)
+            options.width = std::max(8, std::atoi(argv[++a]));
+        else if (arg == "--spp" && has_value)
+            options.samples_per_pixel = std::max(1, std::atoi(argv[++a]));
+        else if (arg == "--threads" && has_value)
+            options.threads = static_cast<unsigned>(std::max(0, std::atoi(argv[++a])));
+        else if (arg == "--scene" && has_value)
+            scene_paths.push_back(argv[++a]);
+        else {
+            std::cerr << "Unknown argument " << arg << ".\n";
+            return 1;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baseline_path.empty() && !read_baseline(baseline_path, baseline))
+        return 1;
+
+    // The same objects and rays on every run.
+    seed_random(405, 0, 0);
+    auto rays = random_rays(256);
+
+    std::vector<benchmark_result> results;
+    bench_kernels(options, rays, results);
+    bench_lists(options, rays, results);
+    bench_meshes(options, rays, results);
+    bench_materials(options, results);
+    bench_textures(options, results);
+
+    // The built-in scenes, then the scene files, each loaded only if it is selected.
+    for (const auto& builtin : builtin_scenes) {
+        auto name = std::string("render/") + builtin.name;
+        if (!selected(options, name))
+            continue;
+        hittable_list world;
+        material_table materials;
+        scene_description scene;
+        builtin.build(world, materials, scene.settings);
+        if (!scene.capture(world, materials))
+            return 1;
+        results.push_back(bench_render(name, scene, options));
+    }
+    for (const auto& path : scene_paths) {
+        scene_description scene;
+        if (!selected(options, "render/" + path))
+            continue;
+        if (!scene.load(path))
+            return 1;
+        results.push_back(bench_render("render/" + path, scene, options));
+    }
+
+    print_results(results, baseline);
+    if (!json_path.empty() && !write_json(json_path, options, results))
+        return 1;
+}
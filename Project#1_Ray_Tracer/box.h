@@ -1,53 +1,108 @@
-#ifndef BOX_H
-#define BOX_H
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "rtweekend.h"
-#include "aarect.h"
-#include "hittable_list.h"
-
-class box : public hittable
-{
-public:
-    box() {}
-    box(const point3& p0, const point3& p1, shared_ptr<material> ptr);
-
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
-    {
-        output_box = aabb(box_min, box_max);
-        return true;
-    }
-
-public:
-    point3 box_min;
-    point3 box_max;
-    hittable_list sides;
-};
-
-box::box(const point3& p0, const point3& p1, shared_ptr<material> ptr)
-{
-    box_min = p0;
-    box_max = p1;
-
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), ptr));
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), ptr));
-
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), ptr));
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), ptr));
-
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), ptr));
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), ptr));
-}
-
-bool box::hit(const ray& r, double t_min, double t_max, hit_record& rec) const
-{
-    return sides.hit(r, t_min, t_max, rec);
-}
-
-#endif
\ No newline at end of file
+#ifndef BOX_H
+#define BOX_H
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+// An axis-aligned box, intersected with one slab test instead of as six rects. Rotated
+// boxes are instances of one of these.
+class box : public hittable
+{
+public:
+    box() {}
+    box(const point3& p0, const point3& p1, uint32_t mat) : box_min(p0), box_max(p1), mat_id(mat) {}
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    // Geometry-only test shared with primitive_list; leaves rec.mat_id alone.
+    static bool intersect(const real lo[3], const real hi[3], const ray& r, real t_min, real t_max, hit_record& rec);
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override
+    {
+        return finish_packet(packet, packet_simd().slab(packet, box_min.e, box_max.e, t_min), t_min);
+    }
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override
+    {
+        output_box = aabb(box_min, box_max);
+        return true;
+    }
+
+public:
+    point3 box_min;
+    point3 box_max;
+    uint32_t mat_id;
+};
+
+bool box::hit(const ray& r, real t_min, real t_max, hit_record& rec) const
+{
+    if (!intersect(box_min.e, box_max.e, r, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    return true;
+}
+
+bool box::intersect(const real lo[3], const real hi[3], const ray& r, real t_min, real t_max, hit_record& rec)
+{
+    count_stat(stat_counter::box_tests);
+    // The ray is inside the box between the last plane it enters and the first one it
+    // leaves (Kay and Kajiya), found as in aabb::hit from the ray's cached reciprocals
+    // and sign bits. A ray parallel to a slab and on its plane gets a NaN, which
+    // neither comparison takes.
+    real t_near = -infinity;
+    real t_far = infinity;
+    int near_axis = 0;
+    int far_axis = 0;
+    for (int a = 0; a < 3; a++)
+    {
+        real t0 = ((r.sign[a] ? hi : lo)[a] - r.orig[a]) * r.inv_dir[a];
+        real t1 = ((r.sign[a] ? lo : hi)[a] - r.orig[a]) * r.inv_dir[a];
+        if (t0 > t_near) { t_near = t0; near_axis = a; }
+        if (t1 < t_far) { t_far = t1; far_axis = a; }
+    }
+    if (t_near > t_far)
+        return false;
+
+    // The entering face, or the leaving one for a ray that starts inside.
+    real t;
+    int axis;
+    bool max_side;
+    if (t_near >= t_min && t_near <= t_max)
+    {
+        t = t_near;
+        axis = near_axis;
+        max_side = r.sign[axis];
+    }
+    else if (t_far >= t_min && t_far <= t_max)
+    {
+        t = t_far;
+        axis = far_axis;
+        max_side = !r.sign[axis];
+    }
+    else
+        return false;
+
+    // UVs run across the face along the other two axes in order, as on the aarects.
+    int u_axis = axis == 0 ? 1 : 0;
+    int v_axis = axis == 2 ? 1 : 2;
+    rec.p = r.at(t);
+    rec.u = (rec.p[u_axis] - lo[u_axis]) / (hi[u_axis] - lo[u_axis]);
+    rec.v = (rec.p[v_axis] - lo[v_axis]) / (hi[v_axis] - lo[v_axis]);
+    rec.uv_scale = std::fmin(hi[u_axis] - lo[u_axis], hi[v_axis] - lo[v_axis]);
+    rec.t = t;
+    vec3 outward_normal;
+    outward_normal[axis] = max_side ? 1 : -1;
+    rec.set_face_normal(r, outward_normal);
+    if (precision_traits<real>::offset_origins)
+        rec.p[axis] = max_side ? hi[axis] : lo[axis];   // exactly on the face, as on a rect
+    rec.p_error = 0;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef BVH_H
+#define BVH_H
+
+//==============================================================================================
+// Based on bvh_node, originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing: The Next Week. raytracing.github.io/books/RayTracingTheNextWeek.html
+// (accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "sphere_set.h"
+#include "primitive.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// Summary of a built hierarchy. The SAH cost is expressed in units of one primitive
+// intersection, so a flat hittable_list of n objects has a cost of n.
+struct bvh_stats {
+    int node_count = 0;
+    int leaf_count = 0;
+    int max_depth = 0;
+    double sah_cost = 0;
+};
+
+// Splits are chosen with a binned surface area heuristic (SAH) instead of the book's
+// random-axis median split.
+class bvh_node : public hittable {
+public:
+    bvh_node() {}
+
+    bvh_node(const hittable_list& list, double time0, double time1)
+        : bvh_node(list.objects, 0, list.objects.size(), time0, time1)
+    {}
+
+    bvh_node(
+        const std::vector<shared_ptr<hittable>>& src_objects,
+        size_t start, size_t end, double time0, double time1);
+
+    // Builds over primitives held by value, e.g. straight from a mapped scene file.
+    // Leaves copy their primitives, so nothing is allocated per object. Any objects,
+    // e.g. instances, are placed in the same hierarchy.
+    bvh_node(const primitive* primitives, size_t count,
+             const std::vector<shared_ptr<hittable>>& objects = {});
+
+    virtual bool hit(
+        const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override;
+
+    bvh_stats statistics() const;
+
+public:
+    // Interior nodes have both children. A leaf keeps its primitive(s) in left and
+    // leaves right empty. A node built over nothing has neither, and a box that
+    // bounds nothing, so it is never traversed.
+    shared_ptr<hittable> left;
+    shared_ptr<hittable> right;
+    aabb box;
+    size_t leaf_size = 0;
+    bool sphere_leaf = false;   // the leaf is a sphere_set
+
+    static const int bin_count = 12;
+    static const int max_leaf_size = 4;
+    static constexpr double traversal_cost = 1.0;    // relative to one primitive test
+    static constexpr double intersection_cost = 1.0;
+    static constexpr double sphere_block_cost = 2.5;  // one sphere_set block of 8 spheres
+
+private:
+    // Either a hittable or, when building from primitives, one of those.
+    struct build_item {
+        shared_ptr<hittable> object;
+        const primitive* prim = nullptr;
+        aabb box;
+        point3 centroid;
+        bool is_sphere;
+    };
+
+    struct bin {
+        aabb box;
+        int count = 0;
+    };
+
+    bvh_node(std::vector<build_item>& items, size_t start, size_t end);
+    void build(std::vector<build_item>& items, size_t start, size_t end);
+    void accumulate(bvh_stats& stats, int depth, double root_area) const;
+
+    static double leaf_cost(size_t count, bool spheres) {
+        if (!spheres)
+            return intersection_cost * count;
+        return sphere_block_cost * ((count + sphere_block_size - 1) / sphere_block_size);
+    }
+};
+
+bvh_node::bvh_node(
+    const std::vector<shared_ptr<hittable>>& src_objects,
+    size_t start, size_t end, double time0, double time1
+) {
+    // Boxes and centroids are computed once up front; the recursive build only
+    // shuffles these records around.
+    std::vector<build_item> items;
+    items.reserve(end - start);
+    for (size_t i = start; i < end; ++i) {
+        build_item item;
+        item.object = src_objects[i];
+        if (!item.object->bounding_box(time0, time1, item.box))
+            std::cerr << "No bounding box in bvh_node constructor.\n";
+        item.centroid = 0.5 * (item.box.min() + item.box.max());
+        item.is_sphere = dynamic_cast<const sphere*>(item.object.get()) != nullptr;
+        items.push_back(item);
+    }
+
+    build(items, 0, items.size());
+}
+
+bvh_node::bvh_node(
+    const primitive* primitives, size_t count, const std::vector<shared_ptr<hittable>>& objects
+) {
+    std::vector<build_item> items(count + objects.size());
+    for (size_t i = 0; i < count; ++i) {
+        auto& item = items[i];
+        item.prim = &primitives[i];
+        item.box = primitive_bounds(primitives[i]);
+        item.centroid = 0.5 * (item.box.min() + item.box.max());
+        item.is_sphere = primitives[i].type == primitive_type::sphere;
+    }
+    for (size_t i = 0; i < objects.size(); ++i) {
+        auto& item = items[count + i];
+        item.object = objects[i];
+        if (!item.object->bounding_box(0, 1, item.box))
+            std::cerr << "No bounding box in bvh_node constructor.\n";
+        item.centroid = 0.5 * (item.box.min() + item.box.max());
+        item.is_sphere = dynamic_cast<const sphere*>(item.object.get()) != nullptr;
+    }
+
+    build(items, 0, items.size());
+}
+
+bvh_node::bvh_node(std::vector<build_item>& items, size_t start, size_t end) {
+    build(items, start, end);
+}
+
+void bvh_node::build(std::vector<build_item>& items, size_t start, size_t end) {
+    size_t object_span = end - start;
+    if (object_span == 0) {
+        box = aabb(point3(0, 0, 0), point3(0, 0, 0));
+        return;
+    }
+
+    box = items[start].box;
+    aabb centroid_box(items[start].centroid, items[start].centroid);
+    for (size_t i = start + 1; i < end; ++i) {
+        box = surrounding_box(box, items[i].box);
+        centroid_box = surrounding_box(centroid_box, aabb(items[i].centroid, items[i].centroid));
+    }
+
+    // A range of nothing but spheres becomes a sphere_set leaf, which tests a whole
+    // block of them for little more than the cost of two single spheres.
+    bool all_spheres = true;
+    for (size_t i = start; i < end && all_spheres; ++i)
+        all_spheres = items[i].is_sphere;
+    size_t leaf_limit = all_spheres ? sphere_block_size : max_leaf_size;
+
+    auto make_leaf = [&]() {
+        leaf_size = object_span;
+        if (object_span == 1 && items[start].object) {
+            left = items[start].object;
+            return;
+        }
+
+        if (all_spheres && object_span > 1) {
+            auto spheres = make_shared<sphere_set>();
+            for (size_t i = start; i < end; ++i) {
+                if (const auto* p = items[i].prim)
+                    spheres->add(to_point(p->shape.sphere.center), p->shape.sphere.radius, p->mat_id);
+                else
+                    spheres->add(static_cast<const sphere&>(*items[i].object));
+            }
+            left = spheres;
+            sphere_leaf = true;
+            return;
+        }
+
+        // Mixed leaves of the closed primitive types are stored by value and dispatched
+        // with a switch; anything else stays a list of virtual hittables next to them.
+        auto primitives = make_shared<primitive_list>();
+        auto objects = make_shared<hittable_list>();
+        for (size_t i = start; i < end; ++i) {
+            if (const auto* p = items[i].prim)
+                primitives->add(*p);
+            else if (!primitives->add(*items[i].object))
+                objects->add(items[i].object);
+        }
+        if (objects->objects.empty()) {
+            left = primitives;
+            return;
+        }
+
+        if (primitives->size())
+            objects->add(primitives);
+        left = objects;
+    };
+
+    if (object_span == 1) {
+        make_leaf();
+        return;
+    }
+
+    // Bin the centroids along every axis and sweep the bin boundaries from both sides
+    // to find the cheapest split plane.
+    double best_cost = infinity;
+    int best_axis = -1;
+    int best_split = 0;
+
+    for (int axis = 0; axis < 3; ++axis) {
+        double lo = centroid_box.min()[axis];
+        double extent = centroid_box.max()[axis] - lo;
+        if (extent <= 0)
+            continue;
+
+        bin bins[bin_count];
+        for (size_t i = start; i < end; ++i) {
+            int b = std::min(bin_count - 1, static_cast<int>(bin_count * (items[i].centroid[axis] - lo) / extent));
+            bins[b].box = bins[b].count ? surrounding_box(bins[b].box, items[i].box) : items[i].box;
+            bins[b].count++;
+        }
+
+        double right_area[bin_count];
+        int right_count[bin_count];
+        aabb sweep;
+        int count = 0;
+        for (int b = bin_count - 1; b > 0; --b) {
+            if (bins[b].count)
+                sweep = count ? surrounding_box(sweep, bins[b].box) : bins[b].box;
+            count += bins[b].count;
+            right_area[b] = count ? sweep.surface_area() : 0;
+            right_count[b] = count;
+        }
+
+        count = 0;
+        for (int b = 0; b < bin_count - 1; ++b) {
+            if (bins[b].count)
+                sweep = count ? surrounding_box(sweep, bins[b].box) : bins[b].box;
+            count += bins[b].count;
+            if (count == 0 || right_count[b + 1] == 0)
+                continue;
+
+            double cost = count * sweep.surface_area() + right_count[b + 1] * right_area[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // Turn the unnormalized sweep cost into the expected cost of splitting here and
+    // compare it with intersecting every primitive directly.
+    double this_leaf_cost = leaf_cost(object_span, all_spheres);
+    double split_cost = traversal_cost + intersection_cost * best_cost / box.surface_area();
+
+    if (best_axis < 0) {
+        // All centroids coincide, so no plane separates them. Split by count instead.
+        if (object_span <= leaf_limit) {
+            make_leaf();
+            return;
+        }
+        auto mid = start + object_span / 2;
+        left = shared_ptr<bvh_node>(new bvh_node(items, start, mid));
+        right = shared_ptr<bvh_node>(new bvh_node(items, mid, end));
+        return;
+    }
+
+    if (object_span <= leaf_limit && this_leaf_cost <= split_cost) {
+        make_leaf();
+        return;
+    }
+
+    double lo = centroid_box.min()[best_axis];
+    double extent = centroid_box.max()[best_axis] - lo;
+    auto middle = std::partition(items.begin() + start, items.begin() + end,
+        [&](const build_item& item) {
+            int b = std::min(bin_count - 1, static_cast<int>(bin_count * (item.centroid[best_axis] - lo) / extent));
+            return b <= best_split;
+        });
+    auto mid = static_cast<size_t>(middle - items.begin());
+
+    left = shared_ptr<bvh_node>(new bvh_node(items, start, mid));
+    right = shared_ptr<bvh_node>(new bvh_node(items, mid, end));
+}
+
+bool bvh_node::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    count_stat(stat_counter::bvh_nodes);
+    if (!left || !box.hit(r, t_min, t_max))
+        return false;
+
+    if (!right)
+        return left->hit(r, t_min, t_max, rec);
+
+    bool hit_left = left->hit(r, t_min, t_max, rec);
+    bool hit_right = right->hit(r, t_min, hit_left ? rec.t : t_max, rec);
+
+    return hit_left || hit_right;
+}
+
+unsigned bvh_node::hit_packet(ray_packet& packet, real t_min) const {
+    // Lanes that miss the box sit out this subtree; the others see the same t_max as in
+    // hit(), lane by lane.
+    count_lanes(stat_counter::bvh_nodes, packet.active);
+    if (!left)
+        return 0;
+    unsigned entered = packet_simd().slab(packet, box.minimum.e, box.maximum.e, t_min);
+    if (!entered)
+        return 0;
+
+    unsigned active = packet.active;
+    packet.active = entered;
+    unsigned hits = left->hit_packet(packet, t_min);
+    if (right)
+        hits |= right->hit_packet(packet, t_min);
+    packet.active = active;
+
+    return hits;
+}
+
+bool bvh_node::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = box;
+    return true;
+}
+
+bvh_stats bvh_node::statistics() const {
+    bvh_stats stats;
+    accumulate(stats, 1, box.surface_area());
+    return stats;
+}
+
+void bvh_node::accumulate(bvh_stats& stats, int depth, double root_area) const {
+    // Probability of visiting a node is its surface area relative to the root's.
+    double visit_probability = root_area > 0 ? box.surface_area() / root_area : 1.0;
+
+    stats.node_count++;
+    stats.max_depth = std::max(stats.max_depth, depth);
+
+    if (!right) {
+        stats.leaf_count++;
+        stats.sah_cost += visit_probability * leaf_cost(leaf_size, sphere_leaf);
+        return;
+    }
+
+    stats.sah_cost += visit_probability * traversal_cost;
+    static_cast<const bvh_node&>(*left).accumulate(stats, depth + 1, root_area);
+    static_cast<const bvh_node&>(*right).accumulate(stats, depth + 1, root_area);
+}
+
+#endif
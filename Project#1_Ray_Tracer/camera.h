@@ -1,46 +1,57 @@
-#ifndef CAMERA_H
-#define CAMERA_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "rtweekend.h"
-
-class camera {
-public:
-    camera(
-        point3 lookfrom,
-        point3 lookat,
-        vec3   vup,
-        double vfov, // vertical field-of-view in degrees
-        double aspect_ratio
-    ) {
-        auto theta = degrees_to_radians(vfov);
-        auto h = tan(theta / 2);
-        auto viewport_height = 2.0 * h;
-        auto viewport_width = aspect_ratio * viewport_height;
-
-        auto w = unit_vector(lookfrom - lookat);
-        auto u = unit_vector(cross(vup, w));
-        auto v = cross(w, u);
-
-        origin = lookfrom;
-        horizontal = viewport_width * u;
-        vertical = viewport_height * v;
-        lower_left_corner = origin - horizontal / 2 - vertical / 2 - w;
-    }
-
-    ray get_ray(double s, double t) const {
-        return ray(origin, lower_left_corner + s * horizontal + t * vertical - origin);
-    }
-
-private:
-    point3 origin;
-    point3 lower_left_corner;
-    vec3 horizontal;
-    vec3 vertical;
-};
+#ifndef CAMERA_H
+#define CAMERA_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+#include "stats.h"
+
+template <typename T>
+class basic_camera {
+public:
+    basic_camera(
+        basic_vec3<T> lookfrom,
+        basic_vec3<T> lookat,
+        basic_vec3<T> vup,
+        T vfov, // vertical field-of-view in degrees
+        T aspect_ratio
+    ) {
+        auto theta = degrees_to_radians(vfov);
+        auto h = tan(theta / 2);
+        auto viewport_height = 2.0 * h;
+        auto viewport_width = aspect_ratio * viewport_height;
+
+        auto w = unit_vector(lookfrom - lookat);
+        auto u = unit_vector(cross(vup, w));
+        auto v = cross(w, u);
+
+        origin = lookfrom;
+        horizontal = viewport_width * u;
+        vertical = viewport_height * v;
+        lower_left_corner = origin - horizontal / 2 - vertical / 2 - w;
+    }
+
+    // The angle one pixel of an image_height rows high subtends at the center of the
+    // view: the spread of the ray cone through it (see shade_path).
+    T pixel_spread(int image_height) const {
+        return atan(vertical.length() / image_height);
+    }
+
+    basic_ray<T> get_ray(T s, T t) const {
+        count_stat(stat_counter::primary_rays);
+        return basic_ray<T>(origin, lower_left_corner + s * horizontal + t * vertical - origin);
+    }
+
+private:
+    basic_vec3<T> origin;
+    basic_vec3<T> lower_left_corner;
+    basic_vec3<T> horizontal;
+    basic_vec3<T> vertical;
+};
+
+using camera = basic_camera<real>;
 #endif
\ No newline at end of file
@@ -0,0 +1,284 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "aov.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// What the samples of a checkpoint or partial render were taken of and with: a
+// fingerprint of the scene (scene_description::fingerprint()) and the names of the
+// sampler and integrator. Sums that differ in any of these estimate different images
+// and are never added together.
+struct render_setup {
+    uint64_t scene_hash;
+    char sampler[16];
+    char integrator[16];
+};
+
+render_setup make_render_setup(uint64_t scene_hash, const std::string& sampler, const std::string& integrator) {
+    render_setup setup = {};
+    setup.scene_hash = scene_hash;
+    std::strncpy(setup.sampler, sampler.c_str(), sizeof(setup.sampler) - 1);
+    std::strncpy(setup.integrator, integrator.c_str(), sizeof(setup.integrator) - 1);
+    return setup;
+}
+
+bool same_setup(const render_setup& a, const render_setup& b) {
+    return a.scene_hash == b.scene_hash
+        && std::strncmp(a.sampler, b.sampler, sizeof(a.sampler)) == 0
+        && std::strncmp(a.integrator, b.integrator, sizeof(a.integrator)) == 0;
+}
+
+std::string describe(const render_setup& setup) {
+    // The names come from a file, so they are not trusted to be terminated.
+    auto name = [](const char (&field)[16]) { return std::string(field, std::find(field, field + 16, '\0')); };
+    char scene[20];
+    std::snprintf(scene, sizeof(scene), "%016llx", static_cast<unsigned long long>(setup.scene_hash));
+    return std::string("scene ") + scene + ", sampler " + name(setup.sampler) + ", integrator " + name(setup.integrator);
+}
+
+// Snapshot of a progressive render: the raw accumulation buffers plus enough metadata to
+// carry on where it stopped. The sums are stored as native doubles, so a resumed render
+// continues from bit-identical state. The share of the frame being rendered is recorded
+// too, since a checkpoint of one sample range or set of tiles cannot be carried on as
+// another, and so is the render setup. A render that records first-hit features (aov.h) saves their sums as well,
+// since the denoiser and the AOVs need them for every sample taken, not just for those
+// taken after a restart.
+//
+// Layout: "RTCK" | version | width | height | seed | samples per pixel of the frame
+//         | first sample | sample end | tile part | tile parts | samples taken | features
+//         | render setup | width*height*3 doubles (radiance sums) | width*height ints (sample counts)
+//         | width*height doubles (squared luminance sums)
+//         [ | width*height*3 doubles (albedo sums) | width*height*3 doubles (normal sums)
+//           | width*height doubles (depth sums) | width*height ints (feature sample counts) ]
+struct checkpoint_header {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint32_t seed;
+    int32_t samples_per_pixel;
+    int32_t first_sample;
+    int32_t sample_end;
+    int32_t tile_part;
+    int32_t tile_parts;
+    int32_t samples_taken;
+    int32_t features;       // 1 if the feature buffers follow the accumulation buffers
+    render_setup setup;
+};
+
+const uint32_t checkpoint_version = 5;
+
+// The accumulation buffers of an image, in the order both checkpoints and partial
+// renders store them.
+void write_accumulation(std::ostream& out, const framebuffer& image) {
+    out.write(reinterpret_cast<const char*>(image.pixels.data()), image.pixels.size() * sizeof(color));
+    out.write(reinterpret_cast<const char*>(image.samples.data()), image.samples.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(image.luminance_sq.data()), image.luminance_sq.size() * sizeof(double));
+}
+
+void read_accumulation(std::istream& in, framebuffer& image) {
+    in.read(reinterpret_cast<char*>(image.pixels.data()), image.pixels.size() * sizeof(color));
+    in.read(reinterpret_cast<char*>(image.samples.data()), image.samples.size() * sizeof(int));
+    in.read(reinterpret_cast<char*>(image.luminance_sq.data()), image.luminance_sq.size() * sizeof(double));
+}
+
+void write_features(std::ostream& out, const feature_buffers& features) {
+    out.write(reinterpret_cast<const char*>(features.albedo.data()), features.albedo.size() * sizeof(color));
+    out.write(reinterpret_cast<const char*>(features.normal.data()), features.normal.size() * sizeof(vec3));
+    out.write(reinterpret_cast<const char*>(features.depth.data()), features.depth.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(features.samples.data()), features.samples.size() * sizeof(int));
+}
+
+void read_features(std::istream& in, feature_buffers& features) {
+    in.read(reinterpret_cast<char*>(features.albedo.data()), features.albedo.size() * sizeof(color));
+    in.read(reinterpret_cast<char*>(features.normal.data()), features.normal.size() * sizeof(vec3));
+    in.read(reinterpret_cast<char*>(features.depth.data()), features.depth.size() * sizeof(double));
+    in.read(reinterpret_cast<char*>(features.samples.data()), features.samples.size() * sizeof(int));
+}
+
+// The caller fills in the seed, the share of the frame (samples per pixel, sample
+// range, tiles) and the render setup; the rest comes from the image and, if the render records them, its
+// feature buffers.
+bool save_checkpoint(
+    const std::string& path, const framebuffer& image, const checkpoint_header& share, int samples_taken,
+    const feature_buffers* features = nullptr
+) {
+    checkpoint_header header = share;
+    std::memcpy(header.magic, "RTCK", 4);
+    header.version = checkpoint_version;
+    header.width = image.width;
+    header.height = image.height;
+    header.samples_taken = samples_taken;
+    header.features = features ? 1 : 0;
+
+    // Write next to the old checkpoint and swap it in afterwards, so a job killed in the
+    // middle of a save still leaves the previous checkpoint intact.
+    std::string temp_path = path + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_accumulation(out, image);
+        if (features)
+            write_features(out, *features);
+        if (!out) {
+            std::cerr << "Cannot write checkpoint " << temp_path << ".\n";
+            return false;
+        }
+    }
+
+    std::remove(path.c_str());
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "Cannot replace checkpoint " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Returns false when there is no usable checkpoint, including one of a different share
+// of the frame or render setup or, when features are asked for, one saved without them; the image and
+// the features are only modified on success.
+bool load_checkpoint(
+    const std::string& path, framebuffer& image, const checkpoint_header& share, int& samples_taken,
+    feature_buffers* features = nullptr
+) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+
+    checkpoint_header header;
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, "RTCK", 4) != 0 || header.version != checkpoint_version) {
+        std::cerr << path << " is not a checkpoint file, ignoring it.\n";
+        return false;
+    }
+
+    if (header.width != image.width || header.height != image.height || header.seed != share.seed) {
+        std::cerr << "Checkpoint " << path << " was taken at " << header.width << 'x' << header.height
+                  << " with seed " << header.seed << ", ignoring it.\n";
+        return false;
+    }
+
+    if (header.samples_per_pixel != share.samples_per_pixel || header.first_sample != share.first_sample
+        || header.sample_end != share.sample_end || header.tile_part != share.tile_part
+        || header.tile_parts != share.tile_parts) {
+        std::cerr << "Checkpoint " << path << " is of samples " << header.first_sample << " to " << header.sample_end
+                  << " of " << header.samples_per_pixel << ", tiles " << header.tile_part << '/' << header.tile_parts
+                  << ", ignoring it.\n";
+        return false;
+    }
+
+    if (header.samples_taken < header.first_sample || header.samples_taken > header.sample_end) {
+        std::cerr << "Checkpoint " << path << " is corrupt, ignoring it.\n";
+        return false;
+    }
+
+    if (!same_setup(header.setup, share.setup)) {
+        std::cerr << "Checkpoint " << path << " is of " << describe(header.setup) << ", not "
+                  << describe(share.setup) << ", ignoring it.\n";
+        return false;
+    }
+
+    if (features && !header.features) {
+        std::cerr << "Checkpoint " << path << " has no feature buffers for --denoise or --aovs, ignoring it.\n";
+        return false;
+    }
+
+    framebuffer saved(image.width, image.height);
+    read_accumulation(in, saved);
+    feature_buffers saved_features(features ? image.width : 0, features ? image.height : 0);
+    if (features)
+        read_features(in, saved_features);
+    if (!in) {
+        std::cerr << "Checkpoint " << path << " is truncated, ignoring it.\n";
+        return false;
+    }
+
+    if (features)
+        *features = std::move(saved_features);
+    image.pixels.swap(saved.pixels);
+    image.samples.swap(saved.samples);
+    image.luminance_sq.swap(saved.luminance_sq);
+    samples_taken = header.samples_taken;
+    return true;
+}
+
+// One process's share of a frame rendered across several: the accumulation buffers of
+// the whole image, of which only the pixels of its tiles have samples, and the range of
+// samples it took of them. merge.cpp adds partials of the same frame back together.
+//
+// Layout: "RTPR" | version | width | height | seed | samples per pixel of the frame
+//         | first sample | sample count | tile part | tile parts | render setup
+//         | the three buffers, as in a checkpoint
+struct partial_header {
+    char magic[4];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    uint32_t seed;
+    int32_t samples_per_pixel;
+    int32_t first_sample;
+    int32_t sample_count;
+    int32_t tile_part;
+    int32_t tile_parts;
+    render_setup setup;
+};
+
+const uint32_t partial_version = 2;
+
+bool save_partial(const std::string& path, const framebuffer& image, const partial_header& range) {
+    partial_header header = range;
+    std::memcpy(header.magic, "RTPR", 4);
+    header.version = partial_version;
+    header.width = image.width;
+    header.height = image.height;
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_accumulation(out, image);
+    if (!out) {
+        std::cerr << "Cannot write " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Reads a partial into a framebuffer of the size its header gives. Given the header of
+// another partial, fails unless both are of the same frame: size, seed, samples per
+// pixel and render setup.
+bool load_partial(const std::string& path, partial_header& header, framebuffer& image, const partial_header* frame = nullptr) {
+    std::ifstream in(path, std::ios::binary);
+    in.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (!in || std::memcmp(header.magic, "RTPR", 4) != 0 || header.version != partial_version
+        || header.width <= 0 || header.height <= 0) {
+        std::cerr << path << " is not a partial render.\n";
+        return false;
+    }
+
+    if (frame && (header.width != frame->width || header.height != frame->height || header.seed != frame->seed
+                  || header.samples_per_pixel != frame->samples_per_pixel || !same_setup(header.setup, frame->setup))) {
+        std::cerr << path << " is " << header.width << 'x' << header.height << ", seed " << header.seed << ", "
+                  << header.samples_per_pixel << " spp, " << describe(header.setup) << "; another frame than "
+                  << frame->width << 'x' << frame->height << ", seed " << frame->seed << ", "
+                  << frame->samples_per_pixel << " spp, " << describe(frame->setup) << ".\n";
+        return false;
+    }
+
+    image = framebuffer(header.width, header.height);
+    read_accumulation(in, image);
+    if (!in) {
+        std::cerr << path << " is truncated.\n";
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,183 @@
+#ifndef DENOISE_H
+#define DENOISE_H
+
+#include "rtweekend.h"
+#include "aov.h"
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <thread>
+#include <vector>
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al., "Edge-Avoiding A-Trous Wavelet
+// Transform for fast Global Illumination Filtering", HPG 2010), steered by the variance
+// of every pixel the way SVGF does it (Schied et al., "Spatiotemporal Variance-Guided
+// Filtering", HPG 2017), without the temporal part.
+//
+// The radiance is first divided by the first-hit albedo, so that the filter smooths
+// lighting and not surface color, and multiplied back at the end. Each iteration is
+// a 5x5 B3-spline kernel whose taps lie step = 2^k pixels apart, so three iterations
+// reach 29 pixels across with 25 taps each; more of them mostly blur soft lighting such
+// as the glow of an emitter on the floor. A tap counts less the further its normal,
+// relative depth and albedo are from the center's, and the further its luminance is,
+// in standard deviations of the center pixel's mean, from the center's luminance. The
+// variance is that of the pixel mean, from the squared luminance the framebuffer keeps,
+// and is filtered along with the radiance, so later iterations trust the color more.
+struct denoise_settings {
+    int iterations = 3;
+    double sigma_luminance = 4;   // standard deviations of the center pixel's mean
+    double sigma_normal = 64;     // exponent on the cosine between the normals
+    double sigma_depth = 0.02;    // relative depth difference per pixel of distance
+    double sigma_albedo = 0.1;    // distance between RGB albedos
+};
+
+// Runs body(j) for every row j, split into bands over the given number of threads.
+inline void for_each_row(int height, unsigned threads, const std::function<void(int)>& body) {
+    threads = std::max(1u, std::min<unsigned>(threads, static_cast<unsigned>(height)));
+    if (threads == 1) {
+        for (int j = 0; j < height; ++j)
+            body(j);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back([&, t] {
+            int begin = static_cast<int>(static_cast<long long>(height) * t / threads);
+            int end = static_cast<int>(static_cast<long long>(height) * (t + 1) / threads);
+            for (int j = begin; j < end; ++j)
+                body(j);
+        });
+    }
+    for (auto& thread : pool)
+        thread.join();
+}
+
+// The denoised image, with its filtered radiance as the single sample of every pixel
+// that had any. Pixels without samples stay empty and are never used as taps; pixels
+// with samples but no recorded features have nothing to steer the filter, so they keep
+// their mean unfiltered and are not used as taps either.
+framebuffer denoise(
+    const framebuffer& image, const feature_buffers& features, const denoise_settings& settings, unsigned threads
+) {
+    const int width = image.width;
+    const int height = image.height;
+    const size_t count = image.pixels.size();
+    const double albedo_floor = 0.01;
+
+    std::vector<surface_features> guide(count);
+    std::vector<color> albedo(count);
+    std::vector<color> irradiance(count);
+    std::vector<double> variance(count, 0.0);
+    std::vector<char> covered(count, 0);
+    for (size_t p = 0; p < count; ++p) {
+        auto n = image.samples[p];
+        if (n == 0 || features.samples[p] == 0)
+            continue;
+        covered[p] = 1;
+        guide[p] = features.resolve(p);
+        const auto& a = guide[p].albedo;
+        albedo[p] = color(std::max(a.x(), albedo_floor), std::max(a.y(), albedo_floor), std::max(a.z(), albedo_floor));
+
+        auto mean = image.pixels[p] / n;
+        irradiance[p] = color(mean.x() / albedo[p].x(), mean.y() / albedo[p].y(), mean.z() / albedo[p].z());
+        if (n > 1) {
+            auto y = luminance(mean);
+            auto sample_variance = std::max(0.0, (image.luminance_sq[p] - n * y * y) / (n - 1));
+            auto scale = luminance(albedo[p]);
+            variance[p] = sample_variance / n / (scale * scale);
+        }
+    }
+
+    const double kernel[3] = { 3.0 / 8.0, 1.0 / 4.0, 1.0 / 16.0 };
+    std::vector<color> next_irradiance(count);
+    std::vector<double> next_variance(count);
+    std::vector<double> blurred_variance(count);
+
+    for (int iteration = 0; iteration < settings.iterations; ++iteration) {
+        const int step = 1 << iteration;
+
+        // The luminance test uses a 3x3 blur of the variance, which is itself noisy.
+        for_each_row(height, threads, [&](int j) {
+            for (int i = 0; i < width; ++i) {
+                auto p = image.index(i, j);
+                double sum = 0, weight = 0;
+                for (int dy = -1; dy <= 1; ++dy) {
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int x = i + dx, y = j + dy;
+                        if (x < 0 || x >= width || y < 0 || y >= height)
+                            continue;
+                        auto q = image.index(x, y);
+                        if (!covered[q])
+                            continue;
+                        double w = kernel[1 + std::abs(dx)] * kernel[1 + std::abs(dy)];
+                        sum += w * variance[q];
+                        weight += w;
+                    }
+                }
+                blurred_variance[p] = weight > 0 ? sum / weight : 0;
+            }
+        });
+
+        for_each_row(height, threads, [&](int j) {
+            for (int i = 0; i < width; ++i) {
+                auto p = image.index(i, j);
+                if (!covered[p])
+                    continue;
+
+                const auto& center = guide[p];
+                auto center_luminance = luminance(irradiance[p]);
+                auto luminance_scale = settings.sigma_luminance * std::sqrt(blurred_variance[p]) + 1e-10;
+
+                color sum(0, 0, 0);
+                double sum_variance = 0;
+                double weight = 0;
+                for (int dy = -2; dy <= 2; ++dy) {
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        int x = i + dx * step, y = j + dy * step;
+                        if (x < 0 || x >= width || y < 0 || y >= height)
+                            continue;
+                        auto q = image.index(x, y);
+                        if (!covered[q])
+                            continue;
+
+                        double w = kernel[std::abs(dx)] * kernel[std::abs(dy)];
+                        if (q != p) {
+                            const auto& tap = guide[q];
+                            double distance = step * std::sqrt(static_cast<double>(dx * dx + dy * dy));
+                            double cosine = std::max(0.0, static_cast<double>(dot(center.normal, tap.normal)));
+                            double depth_error = std::fabs(center.depth - tap.depth)
+                                / (settings.sigma_depth * distance * std::max(center.depth, tap.depth) + 1e-10);
+                            double albedo_error = (center.albedo - tap.albedo).length_squared()
+                                / (settings.sigma_albedo * settings.sigma_albedo);
+                            double luminance_error = std::fabs(center_luminance - luminance(irradiance[q])) / luminance_scale;
+                            w *= std::pow(cosine, settings.sigma_normal)
+                                * std::exp(-depth_error - albedo_error - luminance_error);
+                        }
+                        sum += w * irradiance[q];
+                        sum_variance += w * w * variance[q];
+                        weight += w;
+                    }
+                }
+                next_irradiance[p] = sum / weight;
+                next_variance[p] = sum_variance / (weight * weight);
+            }
+        });
+
+        irradiance.swap(next_irradiance);
+        variance.swap(next_variance);
+    }
+
+    framebuffer result(width, height);
+    for (size_t p = 0; p < count; ++p) {
+        if (covered[p])
+            result.add_sample(p, irradiance[p] * albedo[p]);
+        else if (image.samples[p] > 0)
+            result.add_sample(p, image.pixels[p] / image.samples[p]);
+    }
+    return result;
+}
+
+#endif
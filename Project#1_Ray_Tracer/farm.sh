@@ -0,0 +1,44 @@
+#!/bin/sh
+# Renders one frame with N raytracer processes on this machine and merges their partial
+# renders (see merge.cpp). Every process takes every N-th tile; the remaining arguments
+# go to all of them. The same split runs across machines by starting
+#     ./raytracer --tiles i/N --partial part_i.rtpart ...
+# on each one and copying the partials back for ./merge.
+#
+# Usage: ./farm.sh N OUTPUT [raytracer arguments...]
+#        e.g. ./farm.sh 4 frame.png --builtin objects
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 N OUTPUT [raytracer arguments...]" >&2
+    exit 1
+fi
+parts=$1
+output=$2
+shift 2
+
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+
+# Each process gets an equal share of the cores.
+cores=$(nproc 2>/dev/null || echo "$parts")
+threads=$(( (cores + parts - 1) / parts ))
+
+i=0
+pids=
+while [ "$i" -lt "$parts" ]; do
+    ./raytracer --tiles "$i/$parts" --threads "$threads" --partial "$dir/part_$i.rtpart" "$@" 2>"$dir/part_$i.log" &
+    pids="$pids $!"
+    i=$((i + 1))
+done
+
+failed=0
+for pid in $pids; do
+    wait "$pid" || failed=1
+done
+if [ "$failed" -ne 0 ]; then
+    cat "$dir"/part_*.log >&2
+    exit 1
+fi
+
+./merge "$output" "$dir"/part_*.rtpart
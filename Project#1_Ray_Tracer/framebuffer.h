@@ -0,0 +1,171 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "rtweekend.h"
+#include "color.h"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAMEBUFFER_SSE2
+#endif
+
+static_assert(sizeof(color) == 3 * sizeof(double), "framebuffer walks color arrays as flat doubles");
+
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+// Shared accumulation target for the tile renderer. Pixel (i, j) follows the
+// camera convention used by main(): i grows to the right, j grows upwards.
+//
+// Besides the radiance sum, every pixel tracks how many samples went into it and the
+// sum of their squared luminance, which is all an adaptive sampler needs to estimate
+// the variance of the pixel mean.
+class framebuffer {
+public:
+    framebuffer(int w, int h)
+        : width(w), height(h), pixels(static_cast<size_t>(w) * h),
+          samples(pixels.size(), 0), luminance_sq(pixels.size(), 0.0) {}
+
+    size_t index(int i, int j) const { return static_cast<size_t>(j) * width + i; }
+
+    color& at(int i, int j) { return pixels[index(i, j)]; }
+    const color& at(int i, int j) const { return pixels[index(i, j)]; }
+
+    void add_sample(size_t pixel, const color& c) {
+        pixels[pixel] += c;
+        auto y = luminance(c);
+        luminance_sq[pixel] += y * y;
+        samples[pixel]++;
+    }
+
+    // Half-width of the 95% confidence interval of the pixel mean, converted to display
+    // (gamma 2.0) units so that dark and bright pixels are judged by what is visible.
+    double display_error(size_t pixel) const;
+
+    // Averages, gamma-corrects (gamma=2.0) and quantizes the whole image to 8-bit RGB,
+    // top row first. Matches write_color() value for value.
+    std::vector<unsigned char> resolve() const;
+
+    // Averaged linear radiance as 32-bit floats, top row first.
+    std::vector<float> resolve_hdr() const;
+
+    // Samples spent per pixel as an 8-bit heat map (black, blue, green, yellow, red as
+    // the count rises to max_samples), top row first.
+    std::vector<unsigned char> resolve_sample_heatmap(int max_samples) const;
+
+    long long total_samples() const {
+        long long total = 0;
+        for (auto n : samples)
+            total += n;
+        return total;
+    }
+
+public:
+    int width;
+    int height;
+    std::vector<color> pixels;         // sum of all samples taken for each pixel
+    std::vector<int> samples;          // number of samples taken for each pixel
+    std::vector<double> luminance_sq;  // sum of squared sample luminance
+};
+
+double framebuffer::display_error(size_t pixel) const {
+    auto n = samples[pixel];
+    if (n < 2)
+        return infinity;
+
+    auto mean = luminance(pixels[pixel]) / n;
+    auto variance = fmax(0.0, (luminance_sq[pixel] - n * mean * mean) / (n - 1));
+    auto error = 1.96 * sqrt(variance / n);
+
+    // d(sqrt(x)) = dx / (2 sqrt(x)); the floor keeps near-black pixels from dividing by zero.
+    return error / (2.0 * sqrt(fmax(mean, 1e-4)));
+}
+
+std::vector<unsigned char> framebuffer::resolve() const {
+    std::vector<unsigned char> rgb(pixels.size() * 3);
+    auto row_size = static_cast<size_t>(width) * 3;
+    std::vector<double> scale(row_size);
+
+    for (int j = 0; j < height; ++j) {
+        // The color array is plain doubles, so a row is processed as one flat span
+        // against a matching span of per-channel 1/samples factors.
+        const double* in = &pixels[index(0, j)].e[0];
+        unsigned char* out = &rgb[static_cast<size_t>(height - 1 - j) * row_size];
+        for (int i = 0; i < width; ++i) {
+            auto n = samples[index(i, j)];
+            scale[3 * i] = scale[3 * i + 1] = scale[3 * i + 2] = n > 0 ? 1.0 / n : 0.0;
+        }
+        size_t k = 0;
+
+#ifdef FRAMEBUFFER_SSE2
+        const __m128d lo = _mm_setzero_pd();
+        const __m128d hi = _mm_set1_pd(0.999);
+        const __m128d levels = _mm_set1_pd(256.0);
+        for (; k + 4 <= row_size; k += 4) {
+            __m128d a = _mm_sqrt_pd(_mm_mul_pd(_mm_loadu_pd(&scale[k]), _mm_loadu_pd(in + k)));
+            __m128d b = _mm_sqrt_pd(_mm_mul_pd(_mm_loadu_pd(&scale[k + 2]), _mm_loadu_pd(in + k + 2)));
+            a = _mm_mul_pd(levels, _mm_min_pd(_mm_max_pd(a, lo), hi));
+            b = _mm_mul_pd(levels, _mm_min_pd(_mm_max_pd(b, lo), hi));
+            __m128i q = _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b));
+            q = _mm_packs_epi32(q, q);
+            q = _mm_packus_epi16(q, q);
+            auto packed = static_cast<unsigned>(_mm_cvtsi128_si32(q));
+            out[k + 0] = static_cast<unsigned char>(packed);
+            out[k + 1] = static_cast<unsigned char>(packed >> 8);
+            out[k + 2] = static_cast<unsigned char>(packed >> 16);
+            out[k + 3] = static_cast<unsigned char>(packed >> 24);
+        }
+#endif
+
+        for (; k < row_size; ++k) {
+            auto value = sqrt(scale[k] * in[k]);
+            out[k] = static_cast<unsigned char>(256 * clamp(value == value ? value : 0.0, 0.0, 0.999));
+        }
+    }
+
+    return rgb;
+}
+
+std::vector<float> framebuffer::resolve_hdr() const {
+    std::vector<float> rgb(pixels.size() * 3);
+    auto row_size = static_cast<size_t>(width) * 3;
+
+    for (int j = 0; j < height; ++j) {
+        float* out = &rgb[static_cast<size_t>(height - 1 - j) * row_size];
+        for (int i = 0; i < width; ++i) {
+            auto n = samples[index(i, j)];
+            auto average = n > 0 ? at(i, j) / n : color(0, 0, 0);
+            for (int c = 0; c < 3; ++c)
+                out[3 * i + c] = static_cast<float>(average[c]);
+        }
+    }
+
+    return rgb;
+}
+
+std::vector<unsigned char> framebuffer::resolve_sample_heatmap(int max_samples) const {
+    static const color ramp[] = {
+        color(0, 0, 0), color(0, 0, 1), color(0, 1, 0), color(1, 1, 0), color(1, 0, 0) };
+    const int segments = 4;
+
+    std::vector<unsigned char> rgb(pixels.size() * 3);
+    for (int j = 0; j < height; ++j) {
+        for (int i = 0; i < width; ++i) {
+            auto x = clamp(double(samples[index(i, j)]) / max_samples, 0.0, 1.0) * segments;
+            int k = std::min(static_cast<int>(x), segments - 1);
+            auto heat = ramp[k] + (x - k) * (ramp[k + 1] - ramp[k]);
+
+            auto out = &rgb[(static_cast<size_t>(height - 1 - j) * width + i) * 3];
+            for (int c = 0; c < 3; ++c)
+                out[c] = static_cast<unsigned char>(255.999 * clamp(heat[c], 0.0, 1.0));
+        }
+    }
+
+    return rgb;
+}
+
+#endif
@@ -1,37 +1,120 @@
-#ifndef HITTABLE_H
-#define HITTABLE_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "ray.h"
-#include "aabb.h"
-#include "rtweekend.h"
-
-class material;
-
-struct hit_record {
-    point3 p;
-    vec3 normal;
-    shared_ptr<material> mat_ptr;
-    double t;
-    double u;
-    double v;
-    bool front_face;
-
-    inline void set_face_normal(const ray& r, const vec3& outward_normal) {
-        front_face = dot(r.direction(), outward_normal) < 0;
-        normal = front_face ? outward_normal : -outward_normal;
-    }
-};
-
-class hittable {
-public:
-    virtual bool hit(const ray& r, double t_min, double t_max, hit_record& rec) const = 0;
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
-};
-
+#ifndef HITTABLE_H
+#define HITTABLE_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "ray.h"
+#include "aabb.h"
+#include "packet.h"
+#include "rtweekend.h"
+#include "stats.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+// Bound on the relative rounding error of n chained floating-point operations (gamma_n
+// in Pharr, Jakob and Humphreys, "Physically Based Rendering", section 3.9).
+template <typename T>
+constexpr T rounding_error(int n) {
+    return n * (std::numeric_limits<T>::epsilon() / 2) / (1 - n * (std::numeric_limits<T>::epsilon() / 2));
+}
+
+template <typename T>
+inline T max_abs(const basic_vec3<T>& v) {
+    return std::fmax(std::fabs(v.x()), std::fmax(std::fabs(v.y()), std::fabs(v.z())));
+}
+
+template <typename T>
+struct basic_hit_record {
+    basic_vec3<T> p;
+    basic_vec3<T> normal;
+    uint32_t mat_id;   // index into the scene's material_table
+    T t;
+    T u;
+    T v;
+    T p_error;   // how far each coordinate of p may be off the surface (see spawn_ray)
+    T uv_scale;  // surface length per unit of u or v at p, the shorter of the two; 0 if
+                 // the surface has no (u, v) (for texture filtering)
+    bool front_face;
+
+    inline void set_face_normal(const basic_ray<T>& r, const basic_vec3<T>& outward_normal) {
+        front_face = dot(r.direction(), outward_normal) < 0;
+        normal = front_face ? outward_normal : -outward_normal;
+    }
+
+    // A ray leaving the surface at p in the given direction, to either side. With
+    // offset_origins the origin is pushed past p_error along the normal on that side,
+    // so the ray cannot find the surface it starts on again.
+    inline basic_ray<T> spawn_ray(const basic_vec3<T>& direction) const {
+        if (!precision_traits<T>::offset_origins)
+            return basic_ray<T>(p, direction);
+
+        auto n = dot(direction, normal) < 0 ? -normal : normal;
+        T distance = p_error * (std::fabs(n.x()) + std::fabs(n.y()) + std::fabs(n.z()));
+        auto origin = p + distance * n;
+
+        // Round away from the surface as well, so the offset survives the addition.
+        for (int a = 0; a < 3; ++a) {
+            if (n[a] > 0)
+                origin[a] = std::nextafter(origin[a], std::numeric_limits<T>::infinity());
+            else if (n[a] < 0)
+                origin[a] = std::nextafter(origin[a], -std::numeric_limits<T>::infinity());
+        }
+        return basic_ray<T>(origin, direction);
+    }
+};
+
+using hit_record = basic_hit_record<real>;
+
+// packet_width rays traced together, e.g. the primary rays of neighbouring pixels.
+// Each lane keeps the same state a scalar trace would: its ray, the closest hit so far
+// (t_max) and the record of that hit.
+struct ray_packet : packet_rays {
+    ray rays[packet_width];
+    hit_record rec[packet_width];
+
+    void set(int lane, const ray& r, real t_max_value) {
+        rays[lane] = r;
+        for (int a = 0; a < 3; ++a) {
+            orig[a][lane] = r.origin()[a];
+            dir[a][lane] = r.direction()[a];
+            inv_dir[a][lane] = r.inv_dir[a];
+        }
+        t_max[lane] = t_max_value;
+        active |= 1u << lane;
+    }
+};
+
+class hittable {
+public:
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const = 0;
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const = 0;
+
+    // Intersects every active lane of the packet and returns the mask of lanes that
+    // found a closer hit. Lanes end up exactly as hit() would have left them; this
+    // default simply traces them one at a time.
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const {
+        return finish_packet(packet, packet.active, t_min);
+    }
+
+protected:
+    // Runs the scalar hit() on the candidate lanes, e.g. those a packet kernel reported
+    // as hits, so both paths produce the same records.
+    unsigned finish_packet(ray_packet& packet, unsigned candidates, real t_min) const {
+        unsigned hits = 0;
+        for (int k = 0; k < packet_width; ++k) {
+            if ((candidates >> k & 1) && hit(packet.rays[k], t_min, packet.t_max[k], packet.rec[k])) {
+                packet.t_max[k] = packet.rec[k].t;
+                hits |= 1u << k;
+            }
+        }
+        return hits;
+    }
+};
+
 #endif
\ No newline at end of file
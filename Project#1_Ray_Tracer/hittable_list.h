@@ -1,71 +1,78 @@
-#ifndef HITTABLE_LIST_H
-#define HITTABLE_LIST_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "hittable.h"
-#include "aabb.h"
-#include <memory>
-#include <vector>
-
-using std::shared_ptr;
-using std::make_shared;
-
-class hittable_list : public hittable {
-    public:
-        hittable_list() {}
-        hittable_list(shared_ptr<hittable> object) { add(object); }
-
-        void clear() { objects.clear(); }
-        void add(shared_ptr<hittable> object) { objects.push_back(object); }
-
-        virtual bool hit(
-            const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-        virtual bool bounding_box(
-            double time0, double time1, aabb& output_box) const override;
-
-    public:
-        std::vector<shared_ptr<hittable>> objects;
-};
-
-bool hittable_list::bounding_box(double time0, double time1, aabb& output_box) const
-{
-    if (objects.empty())
-        return false;
-
-    aabb temp_box;
-    bool first_box = true;
-
-    for (const auto& object : objects)
-    {
-        if (!object->bounding_box(time0, time1, temp_box))
-            return false;
-        output_box = first_box ? temp_box : surrounding_box(output_box, temp_box);
-        first_box = false;
-    }
-
-    return true;
-}
-
-bool hittable_list::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    hit_record temp_rec;
-    bool hit_anything = false;
-    auto closest_so_far = t_max;
-
-    for (const auto& object : objects) {
-        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
-            hit_anything = true;
-            closest_so_far = temp_rec.t;
-            rec = temp_rec;
-        }
-    }
-
-    return hit_anything;
-}
-
+#ifndef HITTABLE_LIST_H
+#define HITTABLE_LIST_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "hittable.h"
+#include "aabb.h"
+#include <memory>
+#include <vector>
+
+using std::shared_ptr;
+using std::make_shared;
+
+class hittable_list : public hittable {
+    public:
+        hittable_list() {}
+        hittable_list(shared_ptr<hittable> object) { add(object); }
+
+        void clear() { objects.clear(); }
+        void add(shared_ptr<hittable> object) { objects.push_back(object); }
+
+        virtual bool hit(
+            const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+        virtual bool bounding_box(
+            double time0, double time1, aabb& output_box) const override;
+
+        virtual unsigned hit_packet(ray_packet& packet, real t_min) const override {
+            unsigned hits = 0;
+            for (const auto& object : objects)
+                hits |= object->hit_packet(packet, t_min);
+            return hits;
+        }
+
+    public:
+        std::vector<shared_ptr<hittable>> objects;
+};
+
+bool hittable_list::bounding_box(double time0, double time1, aabb& output_box) const
+{
+    if (objects.empty())
+        return false;
+
+    aabb temp_box;
+    bool first_box = true;
+
+    for (const auto& object : objects)
+    {
+        if (!object->bounding_box(time0, time1, temp_box))
+            return false;
+        output_box = first_box ? temp_box : surrounding_box(output_box, temp_box);
+        first_box = false;
+    }
+
+    return true;
+}
+
+bool hittable_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    hit_record temp_rec;
+    bool hit_anything = false;
+    auto closest_so_far = t_max;
+
+    for (const auto& object : objects) {
+        if (object->hit(r, t_min, closest_so_far, temp_rec)) {
+            hit_anything = true;
+            closest_so_far = temp_rec.t;
+            rec = temp_rec;
+        }
+    }
+
+    return hit_anything;
+}
+
 #endif
\ No newline at end of file
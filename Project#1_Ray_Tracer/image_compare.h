@@ -0,0 +1,89 @@
+#ifndef IMAGE_COMPARE_H
+#define IMAGE_COMPARE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Reads a three-channel .pfm, such as write_pfm() produces, into linear RGB floats, top
+// row first (the layout of framebuffer::resolve_hdr()).
+bool read_pfm(const std::string& path, int& width, int& height, std::vector<float>& rgb) {
+    std::ifstream in(path, std::ios::binary);
+    std::string magic;
+    double scale = 0;
+    if (!(in >> magic >> width >> height >> scale) || magic != "PF" || width <= 0 || height <= 0) {
+        std::cerr << "Cannot read " << path << " as a color PFM.\n";
+        return false;
+    }
+    in.get();   // the single whitespace character before the raster
+
+    auto row_size = static_cast<size_t>(width) * 3;
+    rgb.assign(row_size * height, 0.0f);
+    for (int y = height - 1; y >= 0; --y)
+        in.read(reinterpret_cast<char*>(&rgb[y * row_size]), row_size * sizeof(float));
+    if (!in) {
+        std::cerr << path << " is truncated.\n";
+        return false;
+    }
+
+    // A negative scale marks little-endian data.
+    uint16_t probe = 1;
+    bool little_endian = *reinterpret_cast<unsigned char*>(&probe) == 1;
+    if ((scale < 0) != little_endian) {
+        for (auto& value : rgb) {
+            unsigned char bytes[4];
+            std::memcpy(bytes, &value, 4);
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+            std::memcpy(&value, bytes, 4);
+        }
+    }
+    return true;
+}
+
+struct image_error {
+    double rmse = 0;        // root mean square difference over all channels
+    double mean_error = 0;  // mean absolute difference over all channels
+    double max_error = 0;   // largest absolute difference of a single channel
+    double psnr = 0;        // 20 log10(1 / rmse) in dB, infinite for identical images
+                            // and NaN when the rmse is not finite
+    size_t non_finite = 0;  // pixels with a NaN or infinite channel in either image
+};
+
+// Compares two linear RGB images of the same size, channel by channel. A non-finite
+// channel makes the rmse and mean error non-finite too, and is counted on its own since
+// std::max would drop a NaN from the maximum.
+image_error compare_images(const std::vector<float>& image, const std::vector<float>& reference) {
+    image_error error;
+    double sum = 0, sum_sq = 0;
+    size_t last_non_finite = std::numeric_limits<size_t>::max();
+    for (size_t i = 0; i < image.size(); ++i) {
+        double d = std::fabs(static_cast<double>(image[i]) - reference[i]);
+        sum += d;
+        sum_sq += d * d;
+        error.max_error = std::max(error.max_error, d);
+
+        // Counted once per pixel, however many of its channels are off.
+        if ((!std::isfinite(image[i]) || !std::isfinite(reference[i])) && i / 3 != last_non_finite) {
+            error.non_finite++;
+            last_non_finite = i / 3;
+        }
+    }
+
+    error.rmse = image.empty() ? 0.0 : std::sqrt(sum_sq / image.size());
+    error.mean_error = image.empty() ? 0.0 : sum / image.size();
+    if (!std::isfinite(error.rmse))
+        error.psnr = std::numeric_limits<double>::quiet_NaN();
+    else
+        error.psnr = error.rmse > 0 ? -20.0 * std::log10(error.rmse) : std::numeric_limits<double>::infinity();
+    return error;
+}
+
+#endif
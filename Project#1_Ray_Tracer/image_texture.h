@@ -0,0 +1,416 @@
+#ifndef IMAGE_TEXTURE_H
+#define IMAGE_TEXTURE_H
+
+#include "rtweekend.h"
+#include "texture.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// stb_image is vendored with the second project; every program here is a single
+// translation unit, so the implementation is compiled in with this header.
+#define STB_IMAGE_IMPLEMENTATION
+#include "../Project#2_Pacman3D/stb_image.h"
+
+// Image textures, stored and filtered the way a production texture system does it on a
+// small scale (see Pharr, Jakob and Humphreys, "Physically Based Rendering", 10.4).
+//
+// An image is decoded once, on its first lookup, into a mip pyramid of 8-bit texels kept
+// tile by tile (texture_tile_size texels square), so that a tile is one contiguous run of
+// bytes. The filter does not read those bytes: it reads linear floating-point tiles,
+// which take four times the memory, and only the tiles that lookups actually touch are
+// expanded. Expanded tiles live in the global texture_cache, which holds at most its
+// capacity in bytes and drops the least recently used tile when it is full. Each thread
+// keeps the last tiles it used in a small table of its own, so most lookups take no lock.
+//
+// Lookups pick their mip level from the footprint of a ray cone (texture::filtered), so
+// distant and indirectly seen surfaces read small, coarse levels and a large texture set
+// only expands the detail the image needs.
+//
+// Texels are decoded with the gamma 2 the renderer writes (color.h), so an image shows
+// its own colors. Coordinates repeat outside [0, 1]; v runs up the image. An image that
+// cannot be loaded reads as cyan. Spheres have no (u, v) and show the corner texel.
+
+const int texture_tile_shift = 5;
+const int texture_tile_size = 1 << texture_tile_shift;
+
+// One tile of one mip level, as linear RGB.
+struct texture_tile {
+    float texels[texture_tile_size * texture_tile_size * 3];
+};
+
+// The 8-bit mip pyramid of one image file.
+class mip_pyramid {
+public:
+    struct level {
+        int width, height;
+        int tiles_x, tiles_y;
+        size_t offset;   // of tile (0, 0) in bytes
+    };
+
+    explicit mip_pyramid(const std::string& path);
+
+    // A pyramid over RGB bytes already in memory, row by row from the top; name only
+    // labels it.
+    mip_pyramid(const std::string& name, const uint8_t* rgb, int width, int height);
+
+    mip_pyramid(const mip_pyramid&) = delete;
+    mip_pyramid& operator=(const mip_pyramid&) = delete;
+
+    // Decodes the file and builds the pyramid the first time it is called; false if the
+    // file could not be read.
+    bool load();
+
+    // Expands tile (tx, ty) of a level into linear RGB.
+    void expand(int l, int tx, int ty, texture_tile& out) const;
+
+public:
+    const std::string path;
+    const uint32_t id;   // unique per pyramid, part of the texture_cache keys
+
+    // Filled in by load().
+    std::vector<level> levels;
+    std::vector<uint8_t> bytes;
+
+private:
+    void build(const uint8_t* rgb, int width, int height);
+
+    std::once_flag loaded;
+    bool valid = false;
+};
+
+mip_pyramid::mip_pyramid(const std::string& path) : path(path), id([] {
+    static std::atomic<uint32_t> next{ 0 };
+    return next++;
+}()) {}
+
+mip_pyramid::mip_pyramid(const std::string& name, const uint8_t* rgb, int width, int height)
+    : mip_pyramid(name) {
+    std::call_once(loaded, [&] {
+        build(rgb, width, height);
+        valid = true;
+    });
+}
+
+bool mip_pyramid::load() {
+    std::call_once(loaded, [this] {
+        int width, height, components;
+        uint8_t* rgb = stbi_load(path.c_str(), &width, &height, &components, 3);
+        if (!rgb) {
+            std::cerr << "Cannot load texture " << path << ": " << stbi_failure_reason() << ".\n";
+            return;
+        }
+        build(rgb, width, height);
+        stbi_image_free(rgb);
+        valid = true;
+    });
+    return valid;
+}
+
+void mip_pyramid::build(const uint8_t* rgb, int width, int height) {
+    // Each level halves the one above, rounding up; a texel averages the 2x2 block
+    // above it in linear space, repeating the last row or column of an odd size.
+    std::vector<float> linear(static_cast<size_t>(width) * height * 3);
+    for (size_t i = 0; i < linear.size(); ++i)
+        linear[i] = (rgb[i] / 255.0f) * (rgb[i] / 255.0f);
+
+    std::vector<std::vector<float>> images;
+    std::vector<std::pair<int, int>> sizes;
+    images.push_back(std::move(linear));
+    sizes.emplace_back(width, height);
+    while (width > 1 || height > 1) {
+        int w = (width + 1) / 2, h = (height + 1) / 2;
+        const auto& above = images.back();
+        std::vector<float> next(static_cast<size_t>(w) * h * 3);
+        for (int y = 0; y < h; ++y) {
+            int y0 = 2 * y, y1 = std::min(2 * y + 1, height - 1);
+            for (int x = 0; x < w; ++x) {
+                int x0 = 2 * x, x1 = std::min(2 * x + 1, width - 1);
+                for (int c = 0; c < 3; ++c) {
+                    next[(static_cast<size_t>(y) * w + x) * 3 + c] = 0.25f
+                        * (above[(static_cast<size_t>(y0) * width + x0) * 3 + c] + above[(static_cast<size_t>(y0) * width + x1) * 3 + c]
+                         + above[(static_cast<size_t>(y1) * width + x0) * 3 + c] + above[(static_cast<size_t>(y1) * width + x1) * 3 + c]);
+                }
+            }
+        }
+        images.push_back(std::move(next));
+        sizes.emplace_back(w, h);
+        width = w;
+        height = h;
+    }
+
+    // Back to gamma-encoded bytes, tile by tile; texels past the edge of a level stay 0
+    // and are never read.
+    const size_t tile_bytes = texture_tile_size * texture_tile_size * 3;
+    size_t offset = 0;
+    for (const auto& s : sizes) {
+        level l;
+        l.width = s.first;
+        l.height = s.second;
+        l.tiles_x = (l.width + texture_tile_size - 1) / texture_tile_size;
+        l.tiles_y = (l.height + texture_tile_size - 1) / texture_tile_size;
+        l.offset = offset;
+        offset += tile_bytes * l.tiles_x * l.tiles_y;
+        levels.push_back(l);
+    }
+    bytes.assign(offset, 0);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const auto& l = levels[i];
+        const auto& image = images[i];
+        for (int y = 0; y < l.height; ++y) {
+            for (int x = 0; x < l.width; ++x) {
+                size_t tile = static_cast<size_t>(y >> texture_tile_shift) * l.tiles_x + (x >> texture_tile_shift);
+                size_t within = static_cast<size_t>(y & (texture_tile_size - 1)) * texture_tile_size + (x & (texture_tile_size - 1));
+                uint8_t* out = &bytes[l.offset + tile * tile_bytes + within * 3];
+                for (int c = 0; c < 3; ++c)
+                    out[c] = static_cast<uint8_t>(std::sqrt(image[(static_cast<size_t>(y) * l.width + x) * 3 + c]) * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+void mip_pyramid::expand(int l, int tx, int ty, texture_tile& out) const {
+    static const auto decode = [] {
+        std::vector<float> table(256);
+        for (int b = 0; b < 256; ++b)
+            table[b] = (b / 255.0f) * (b / 255.0f);
+        return table;
+    }();
+
+    const size_t count = texture_tile_size * texture_tile_size * 3;
+    const auto& lv = levels[l];
+    const uint8_t* in = &bytes[lv.offset + (static_cast<size_t>(ty) * lv.tiles_x + tx) * count];
+    for (size_t i = 0; i < count; ++i)
+        out.texels[i] = decode[in[i]];
+}
+
+struct texture_cache_stats {
+    uint64_t hits = 0;        // tiles found in the shared cache
+    uint64_t misses = 0;      // tiles expanded from a pyramid
+    uint64_t evictions = 0;
+    size_t bytes = 0;         // held now
+    size_t peak_bytes = 0;
+};
+
+// Expanded tiles of every image texture, and the pyramids they come from. Tiles are
+// shared between threads and never change once expanded; eviction only drops the
+// cache's reference, so a thread still holding one keeps it until it moves on. With the
+// per-thread tables, memory can exceed the capacity by thread_slots tiles per thread.
+class texture_cache {
+public:
+    static const int thread_slots = 64;
+
+    explicit texture_cache(size_t capacity_bytes) : capacity(capacity_bytes) {}
+
+    // The pyramid of an image file, shared by every texture that names the same path.
+    shared_ptr<mip_pyramid> image(const std::string& path);
+
+    // Tile (tx, ty) of a level of a loaded pyramid. The reference stays valid until the
+    // calling thread's next call.
+    const texture_tile& tile(const mip_pyramid& source, int level, int tx, int ty);
+
+    void set_capacity(size_t bytes);
+    size_t capacity_bytes() const;
+
+    texture_cache_stats statistics() const;
+
+private:
+    using tile_ptr = shared_ptr<const texture_tile>;
+
+    struct entry {
+        uint64_t key;
+        tile_ptr tile;
+    };
+
+    static uint64_t key_of(uint32_t id, int level, int tx, int ty) {
+        return (static_cast<uint64_t>(id) << 40) | (static_cast<uint64_t>(level) << 34)
+             | (static_cast<uint64_t>(ty) << 17) | static_cast<uint64_t>(tx);
+    }
+
+    tile_ptr fetch(const mip_pyramid& source, uint64_t key, int level, int tx, int ty);
+
+    void trim();   // evicts down to the capacity; the lock is held
+
+    mutable std::mutex lock;
+    size_t capacity;
+    std::list<entry> recent;   // most recently used first
+    std::unordered_map<uint64_t, std::list<entry>::iterator> index;
+    std::map<std::string, shared_ptr<mip_pyramid>> images;
+    texture_cache_stats counts;
+};
+
+shared_ptr<mip_pyramid> texture_cache::image(const std::string& path) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto& found = images[path];
+    if (!found)
+        found = make_shared<mip_pyramid>(path);
+    return found;
+}
+
+const texture_tile& texture_cache::tile(const mip_pyramid& source, int level, int tx, int ty) {
+    struct slot {
+        uint64_t key = ~uint64_t(0);
+        tile_ptr tile;
+    };
+    // Direct-mapped on a hash of the key; emptied if the thread turns to another cache.
+    thread_local slot table[thread_slots];
+    thread_local const texture_cache* owner = nullptr;
+    if (owner != this) {
+        for (auto& s : table)
+            s = slot();
+        owner = this;
+    }
+
+    auto key = key_of(source.id, level, tx, ty);
+    auto& s = table[(key * 0x9E3779B97F4A7C15ull) >> 58];
+    if (s.key != key) {
+        s.tile = fetch(source, key, level, tx, ty);
+        s.key = key;
+    }
+    return *s.tile;
+}
+
+texture_cache::tile_ptr texture_cache::fetch(const mip_pyramid& source, uint64_t key, int level, int tx, int ty) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = index.find(key);
+        if (found != index.end()) {
+            recent.splice(recent.begin(), recent, found->second);
+            ++counts.hits;
+            return found->second->tile;
+        }
+    }
+
+    // Expand outside the lock; if another thread got there first, its tile is used.
+    auto expanded = make_shared<texture_tile>();
+    source.expand(level, tx, ty, *expanded);
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto found = index.find(key);
+    if (found != index.end()) {
+        recent.splice(recent.begin(), recent, found->second);
+        ++counts.hits;
+        return found->second->tile;
+    }
+    recent.push_front({ key, expanded });
+    index[key] = recent.begin();
+    ++counts.misses;
+    counts.bytes += sizeof(texture_tile);
+    trim();
+    counts.peak_bytes = std::max(counts.peak_bytes, counts.bytes);
+    return expanded;
+}
+
+void texture_cache::trim() {
+    // The newest tile always stays, even if it alone is over the capacity.
+    while (counts.bytes > capacity && recent.size() > 1) {
+        index.erase(recent.back().key);
+        recent.pop_back();
+        counts.bytes -= sizeof(texture_tile);
+        ++counts.evictions;
+    }
+}
+
+void texture_cache::set_capacity(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    capacity = bytes;
+    trim();
+}
+
+size_t texture_cache::capacity_bytes() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return capacity;
+}
+
+texture_cache_stats texture_cache::statistics() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return counts;
+}
+
+// The cache every image_texture reads through; 64 MB unless set_capacity() says
+// otherwise (--texture-cache).
+inline texture_cache& texture_tiles() {
+    static texture_cache cache(size_t(64) << 20);
+    return cache;
+}
+
+class image_texture : public texture {
+public:
+    // scale repeats the image that many times across a unit of u and of v.
+    image_texture(shared_ptr<mip_pyramid> image, double scale = 1) : image(image), scale(scale) {}
+
+    image_texture(const std::string& path, double scale = 1)
+        : image_texture(texture_tiles().image(path), scale) {}
+
+    // Bilinear on the full-resolution image.
+    virtual color value(double u, double v, const point3& p) const override {
+        return filtered(u, v, p, 0);
+    }
+
+    // Trilinear: bilinear on the two levels whose texels are nearest the footprint
+    // across, blended by where it falls between them.
+    virtual color filtered(double u, double v, const point3& p, double width) const override;
+
+public:
+    shared_ptr<mip_pyramid> image;
+    double scale;
+
+private:
+    color bilinear(int level, double s, double t) const;
+};
+
+color image_texture::filtered(double u, double v, const point3& p, double width) const {
+    if (!image->load())
+        return color(0, 1, 1);
+
+    double s = u * scale, t = (1 - v) * scale;
+    if (!std::isfinite(s) || !std::isfinite(t))
+        s = t = 0;
+
+    const auto& levels = image->levels;
+    const int last = static_cast<int>(levels.size()) - 1;
+    double texels = width * scale * std::max(levels[0].width, levels[0].height);
+    double lod = texels > 1 ? std::log2(texels) : 0;
+    if (lod >= last)
+        return bilinear(last, s, t);
+
+    int fine = static_cast<int>(lod);
+    double blend = lod - fine;
+    if (blend == 0)
+        return bilinear(fine, s, t);
+    return (1 - blend) * bilinear(fine, s, t) + blend * bilinear(fine + 1, s, t);
+}
+
+color image_texture::bilinear(int level, double s, double t) const {
+    const auto& l = image->levels[level];
+    double x = s * l.width - 0.5, y = t * l.height - 0.5;
+    double fx = std::floor(x), fy = std::floor(y);
+    double ax = x - fx, ay = y - fy;
+
+    auto wrap = [](double i, int n) {
+        auto k = static_cast<long long>(std::fmod(i, static_cast<double>(n)));
+        return static_cast<int>(k < 0 ? k + n : k);
+    };
+    int x0 = wrap(fx, l.width), y0 = wrap(fy, l.height);
+    int x1 = x0 + 1 < l.width ? x0 + 1 : 0;
+    int y1 = y0 + 1 < l.height ? y0 + 1 : 0;
+
+    auto texel = [&](int xi, int yi) {
+        const auto& tile = texture_tiles().tile(*image, level, xi >> texture_tile_shift, yi >> texture_tile_shift);
+        const float* c = &tile.texels[((yi & (texture_tile_size - 1)) * texture_tile_size + (xi & (texture_tile_size - 1))) * 3];
+        return color(c[0], c[1], c[2]);
+    };
+    return (1 - ay) * ((1 - ax) * texel(x0, y0) + ax * texel(x1, y0))
+         + ay * ((1 - ax) * texel(x0, y1) + ax * texel(x1, y1));
+}
+
+#endif
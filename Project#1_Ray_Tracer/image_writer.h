@@ -0,0 +1,330 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Encoders for a resolved framebuffer. Each one assembles the complete file in memory
+// and hands it to the stream with a single write.
+//
+//     .ppm  binary P6, 8 bits per channel
+//     .png  8-bit RGB, deflate-compressed
+//     .pfm  linear 32-bit float RGB (HDR, no gamma or clamping)
+
+namespace image_detail {
+
+inline void put_u32_be(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+inline std::array<uint32_t, 256> make_crc_table() {
+    std::array<uint32_t, 256> table;
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k)
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+inline uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+    static const auto table = make_crc_table();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+inline uint32_t adler32(const unsigned char* data, size_t size) {
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // 5552 is the largest run that cannot overflow b before the modulo.
+        size_t run = size < 5552 ? size : 5552;
+        size -= run;
+        while (run--) {
+            a += *data++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// LSB-first bit packer used by deflate.
+class bit_writer {
+public:
+    explicit bit_writer(std::vector<unsigned char>& o) : out(o) {}
+
+    void put(uint32_t bits, int count) {
+        buffer |= static_cast<uint64_t>(bits) << filled;
+        filled += count;
+        while (filled >= 8) {
+            out.push_back(static_cast<unsigned char>(buffer));
+            buffer >>= 8;
+            filled -= 8;
+        }
+    }
+
+    // Huffman codes are defined MSB-first, so they go out bit-reversed.
+    void put_code(uint32_t code, int length) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < length; ++i)
+            reversed |= ((code >> i) & 1u) << (length - 1 - i);
+        put(reversed, length);
+    }
+
+    void flush() {
+        if (filled > 0)
+            out.push_back(static_cast<unsigned char>(buffer));
+        buffer = 0;
+        filled = 0;
+    }
+
+private:
+    std::vector<unsigned char>& out;
+    uint64_t buffer = 0;
+    int filled = 0;
+};
+
+inline void put_literal(bit_writer& bits, int symbol) {
+    // Fixed Huffman table from RFC 1951, section 3.2.6.
+    if (symbol < 144)
+        bits.put_code(0x30 + symbol, 8);
+    else if (symbol < 256)
+        bits.put_code(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        bits.put_code(symbol - 256, 7);
+    else
+        bits.put_code(0xc0 + symbol - 280, 8);
+}
+
+inline void put_match(bit_writer& bits, int length, int distance) {
+    static const int length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static const int length_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    static const int distance_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+    static const int distance_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+    int l = 28;
+    while (length_base[l] > length) --l;
+    put_literal(bits, 257 + l);
+    bits.put(length - length_base[l], length_extra[l]);
+
+    int d = 29;
+    while (distance_base[d] > distance) --d;
+    bits.put_code(d, 5);
+    bits.put(distance - distance_base[d], distance_extra[d]);
+}
+
+// zlib stream with a single fixed-Huffman deflate block and greedy LZ77 matching.
+// Rendered images are dominated by smooth gradients and flat backgrounds, which this
+// already compresses well without the cost of building dynamic code tables.
+inline std::vector<unsigned char> zlib_compress(const std::vector<unsigned char>& data) {
+    const int window = 32768;
+    const int hash_bits = 15;
+    const int max_match = 258;
+    const int max_chain = 16;
+
+    std::vector<unsigned char> out;
+    out.reserve(data.size() / 4 + 64);
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    bit_writer bits(out);
+    bits.put(1, 1); // final block
+    bits.put(1, 2); // fixed Huffman codes
+
+    std::vector<int> head(size_t(1) << hash_bits, -1);
+    std::vector<int> previous(data.size(), -1);
+    auto hash = [&](size_t i) {
+        uint32_t v = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16);
+        return (v * 2654435761u) >> (32 - hash_bits);
+    };
+    auto insert = [&](size_t i) {
+        if (i + 2 < data.size()) {
+            auto h = hash(i);
+            previous[i] = head[h];
+            head[h] = static_cast<int>(i);
+        }
+    };
+
+    size_t n = data.size();
+    size_t i = 0;
+    while (i < n) {
+        int best_length = 0;
+        int best_distance = 0;
+
+        if (i + 2 < n) {
+            int candidate = head[hash(i)];
+            int limit = static_cast<int>(std::min<size_t>(max_match, n - i));
+            for (int chain = 0; candidate >= 0 && chain < max_chain; ++chain) {
+                int distance = static_cast<int>(i) - candidate;
+                if (distance > window)
+                    break;
+                int length = 0;
+                while (length < limit && data[candidate + length] == data[i + length])
+                    ++length;
+                if (length > best_length) {
+                    best_length = length;
+                    best_distance = distance;
+                    if (length == limit)
+                        break;
+                }
+                candidate = previous[candidate];
+            }
+        }
+
+        if (best_length >= 3) {
+            put_match(bits, best_length, best_distance);
+            for (int k = 0; k < best_length; ++k)
+                insert(i + k);
+            i += best_length;
+        } else {
+            put_literal(bits, data[i]);
+            insert(i);
+            ++i;
+        }
+    }
+
+    put_literal(bits, 256); // end of block
+    bits.flush();
+    put_u32_be(out, adler32(data.data(), data.size()));
+    return out;
+}
+
+inline void put_png_chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data) {
+    put_u32_be(out, static_cast<uint32_t>(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32_be(out, crc32(&out[start], out.size() - start));
+}
+
+} // namespace image_detail
+
+void write_ppm(std::ostream& out, int width, int height, const std::vector<unsigned char>& rgb) {
+    std::string header = "P6\n" + std::to_string(width) + ' ' + std::to_string(height) + "\n255\n";
+
+    std::vector<char> file(header.begin(), header.end());
+    file.insert(file.end(), rgb.begin(), rgb.end());
+    out.write(file.data(), file.size());
+}
+
+void write_png(std::ostream& out, int width, int height, const std::vector<unsigned char>& rgb) {
+    using namespace image_detail;
+
+    auto row_size = static_cast<size_t>(width) * 3;
+
+    // Every scanline uses the "Up" filter: flat regions become runs of zeros.
+    std::vector<unsigned char> filtered;
+    filtered.reserve((row_size + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = &rgb[y * row_size];
+        filtered.push_back(2);
+        for (size_t k = 0; k < row_size; ++k)
+            filtered.push_back(static_cast<unsigned char>(row[k] - (y > 0 ? row[k - row_size] : 0)));
+    }
+
+    std::vector<unsigned char> header;
+    put_u32_be(header, static_cast<uint32_t>(width));
+    put_u32_be(header, static_cast<uint32_t>(height));
+    header.push_back(8); // bit depth
+    header.push_back(2); // truecolor
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    std::vector<unsigned char> file(signature, signature + 8);
+    put_png_chunk(file, "IHDR", header);
+    put_png_chunk(file, "IDAT", zlib_compress(filtered));
+    put_png_chunk(file, "IEND", {});
+
+    out.write(reinterpret_cast<const char*>(file.data()), file.size());
+}
+
+void write_pfm(std::ostream& out, int width, int height, const std::vector<float>& rgb) {
+    // PFM stores scanlines bottom-to-top; a negative scale marks little-endian data.
+    auto row_size = static_cast<size_t>(width) * 3;
+
+    uint16_t probe = 1;
+    bool little_endian = *reinterpret_cast<unsigned char*>(&probe) == 1;
+    std::string header = "PF\n" + std::to_string(width) + ' ' + std::to_string(height)
+        + (little_endian ? "\n-1.0\n" : "\n1.0\n");
+
+    std::vector<char> file(header.begin(), header.end());
+    file.resize(header.size() + rgb.size() * sizeof(float));
+    char* data = &file[header.size()];
+    for (int y = height - 1; y >= 0; --y) {
+        std::memcpy(data, &rgb[y * row_size], row_size * sizeof(float));
+        data += row_size * sizeof(float);
+    }
+    out.write(file.data(), file.size());
+}
+
+inline bool has_extension(const std::string& path, const char* extension) {
+    auto n = std::strlen(extension);
+    return path.size() >= n && path.compare(path.size() - n, n, extension) == 0;
+}
+
+// Picks the encoder from the file extension; anything unrecognised is written as P6.
+bool write_image(const std::string& path, const framebuffer& image) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing.\n";
+        return false;
+    }
+
+    if (has_extension(path, ".png"))
+        write_png(out, image.width, image.height, image.resolve());
+    else if (has_extension(path, ".pfm"))
+        write_pfm(out, image.width, image.height, image.resolve_hdr());
+    else
+        write_ppm(out, image.width, image.height, image.resolve());
+
+    return static_cast<bool>(out);
+}
+
+// Same as above for an already quantized 8-bit image such as a heat map.
+bool write_image(const std::string& path, int width, int height, const std::vector<unsigned char>& rgb) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot open " << path << " for writing.\n";
+        return false;
+    }
+
+    if (has_extension(path, ".png"))
+        write_png(out, width, height, rgb);
+    else if (has_extension(path, ".pfm"))
+    {
+        std::vector<float> values(rgb.size());
+        for (size_t k = 0; k < rgb.size(); ++k)
+            values[k] = rgb[k] / 255.0f;
+        write_pfm(out, width, height, values);
+    }
+    else
+        write_ppm(out, width, height, rgb);
+
+    return static_cast<bool>(out);
+}
+
+#endif
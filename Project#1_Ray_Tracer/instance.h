@@ -0,0 +1,205 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+#include <cmath>
+
+// An affine map p -> A p + t, stored as the rows of the 3x4 matrix [A | t]. Kept in
+// double whatever real is, so chains of rotations and scales do not drift.
+class transform {
+public:
+    transform() : m{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } } {}
+
+    static transform translate(const vec3& offset);
+    static transform scale(const vec3& factors);
+    static transform rotate(const vec3& axis, double degrees);   // right-handed, about the origin
+
+    // The map that applies *this after other.
+    transform operator*(const transform& other) const;
+
+    // Only defined for an invertible A, one whose determinant is a normal, nonzero number.
+    transform inverse() const;
+
+    double determinant() const;
+
+    point3 point(const point3& p) const {
+        return point3(row(0, p) + m[0][3], row(1, p) + m[1][3], row(2, p) + m[2][3]);
+    }
+
+    vec3 vector(const vec3& v) const {
+        return vec3(row(0, v), row(1, v), row(2, v));
+    }
+
+    // Maps a normal by the transposed matrix. Called on the inverse, this carries an
+    // object-space normal to world space.
+    vec3 transposed_vector(const vec3& n) const {
+        return vec3(m[0][0] * n[0] + m[1][0] * n[1] + m[2][0] * n[2],
+                    m[0][1] * n[0] + m[1][1] * n[1] + m[2][1] * n[2],
+                    m[0][2] * n[0] + m[1][2] * n[1] + m[2][2] * n[2]);
+    }
+
+public:
+    double m[3][4];
+
+private:
+    double row(int i, const vec3& v) const {
+        return m[i][0] * v[0] + m[i][1] * v[1] + m[i][2] * v[2];
+    }
+};
+
+transform transform::translate(const vec3& offset) {
+    transform t;
+    for (int i = 0; i < 3; ++i)
+        t.m[i][3] = offset[i];
+    return t;
+}
+
+transform transform::scale(const vec3& factors) {
+    transform t;
+    for (int i = 0; i < 3; ++i)
+        t.m[i][i] = factors[i];
+    return t;
+}
+
+transform transform::rotate(const vec3& axis, double degrees) {
+    // Rodrigues' rotation formula.
+    double length = axis.length();
+    double x = axis.x() / length, y = axis.y() / length, z = axis.z() / length;
+    double theta = degrees_to_radians(degrees);
+    double c = std::cos(theta), s = std::sin(theta), k = 1 - c;
+
+    transform t;
+    t.m[0][0] = c + x * x * k;     t.m[0][1] = x * y * k - z * s; t.m[0][2] = x * z * k + y * s;
+    t.m[1][0] = y * x * k + z * s; t.m[1][1] = c + y * y * k;     t.m[1][2] = y * z * k - x * s;
+    t.m[2][0] = z * x * k - y * s; t.m[2][1] = z * y * k + x * s; t.m[2][2] = c + z * z * k;
+    return t;
+}
+
+transform transform::operator*(const transform& other) const {
+    transform t;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            double sum = j == 3 ? m[i][3] : 0;
+            for (int k = 0; k < 3; ++k)
+                sum += m[i][k] * other.m[k][j];
+            t.m[i][j] = sum;
+        }
+    }
+    return t;
+}
+
+transform transform::inverse() const {
+    // Inverse of A by cofactors, then t' = -A^-1 t.
+    const auto& a = m;
+    double c00 = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+    double c01 = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+    double c02 = a[1][0] * a[2][1] - a[1][1] * a[2][0];
+    double r = 1 / (a[0][0] * c00 + a[0][1] * c01 + a[0][2] * c02);
+
+    transform t;
+    t.m[0][0] = c00 * r;
+    t.m[0][1] = (a[0][2] * a[2][1] - a[0][1] * a[2][2]) * r;
+    t.m[0][2] = (a[0][1] * a[1][2] - a[0][2] * a[1][1]) * r;
+    t.m[1][0] = c01 * r;
+    t.m[1][1] = (a[0][0] * a[2][2] - a[0][2] * a[2][0]) * r;
+    t.m[1][2] = (a[0][2] * a[1][0] - a[0][0] * a[1][2]) * r;
+    t.m[2][0] = c02 * r;
+    t.m[2][1] = (a[0][1] * a[2][0] - a[0][0] * a[2][1]) * r;
+    t.m[2][2] = (a[0][0] * a[1][1] - a[0][1] * a[1][0]) * r;
+    for (int i = 0; i < 3; ++i)
+        t.m[i][3] = -(t.m[i][0] * a[0][3] + t.m[i][1] * a[1][3] + t.m[i][2] * a[2][3]);
+    return t;
+}
+
+double transform::determinant() const {
+    const auto& a = m;
+    return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1])
+         - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0])
+         + a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+}
+
+// Places a shared object in the world through an affine transform. Many instances can
+// point at one object, e.g. a BVH over an asset, so memory grows with the number of
+// placements rather than with the geometry they repeat.
+//
+// The ray is carried into object space without renormalizing its direction, which
+// keeps t the same in both spaces; only the hit point and normal come back out.
+class instance : public hittable {
+public:
+    instance() {}
+    instance(shared_ptr<hittable> object, const transform& object_to_world);
+
+    virtual bool hit(const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+public:
+    shared_ptr<hittable> object;
+    transform to_world;
+    transform to_object;
+    double length_scale = 1;   // mean stretch of a length, the cube root of |det A|
+};
+
+instance::instance(shared_ptr<hittable> object, const transform& object_to_world)
+    : object(object), to_world(object_to_world), to_object(object_to_world.inverse())
+{
+    length_scale = std::cbrt(std::fabs(to_world.determinant()));
+}
+
+bool instance::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    ray local(to_object.point(r.origin()), to_object.vector(r.direction()));
+    if (!object->hit(local, t_min, t_max, rec))
+        return false;
+
+    // The object's p_error carries through the matrix; the product itself adds a few
+    // roundings relative to the size of its terms.
+    point3 p = rec.p;
+    rec.p = to_world.point(p);
+    real error = 0;
+    for (int i = 0; i < 3; ++i) {
+        const auto& row = to_world.m[i];
+        double spread = std::fabs(row[0]) + std::fabs(row[1]) + std::fabs(row[2]);
+        double magnitude = std::fabs(row[0] * p[0]) + std::fabs(row[1] * p[1]) + std::fabs(row[2] * p[2]) + std::fabs(row[3]);
+        error = std::fmax(error, real(spread * rec.p_error + rounding_error<real>(4) * magnitude));
+    }
+    rec.p_error = error;
+
+    // Any affine map keeps the sign of dot(direction, normal), so front_face and the
+    // side the normal is on stay as the object set them.
+    rec.normal = unit_vector(to_object.transposed_vector(rec.normal));
+    rec.uv_scale *= length_scale;
+    return true;
+}
+
+bool instance::bounding_box(double time0, double time1, aabb& output_box) const {
+    aabb box;
+    if (!object->bounding_box(time0, time1, box))
+        return false;
+
+    // The world box is the box around all eight transformed corners.
+    point3 lo(infinity, infinity, infinity);
+    point3 hi(-infinity, -infinity, -infinity);
+    for (int corner = 0; corner < 8; ++corner) {
+        point3 c((corner & 1 ? box.max() : box.min()).x(),
+                 (corner & 2 ? box.max() : box.min()).y(),
+                 (corner & 4 ? box.max() : box.min()).z());
+        point3 p = to_world.point(c);
+        for (int a = 0; a < 3; ++a) {
+            lo[a] = std::fmin(lo[a], p[a]);
+            hi[a] = std::fmax(hi[a], p[a]);
+        }
+    }
+
+    // Widen by the rounding of those products so the box still encloses the object.
+    for (int a = 0; a < 3; ++a) {
+        real pad = rounding_error<real>(4) * std::fmax(std::fabs(lo[a]), std::fabs(hi[a]));
+        lo[a] -= pad;
+        hi[a] += pad;
+    }
+    output_box = aabb(lo, hi);
+    return true;
+}
+
+#endif
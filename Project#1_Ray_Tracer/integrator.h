@@ -0,0 +1,188 @@
+#ifndef INTEGRATOR_H
+#define INTEGRATOR_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "lights.h"
+#include "material_table.h"
+#include "sampler.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The path tracers behind --integrator: the recursive ray_color() of the book, and the
+// iterative shade_path() with Russian roulette and optional next-event estimation.
+
+color ray_color(const ray& r, const color& background, const hittable& world, const material_table& materials, int depth);
+
+// Everything ray_color() does once the ray has been intersected with the world. The
+// packet renderer intersects primary rays itself and picks up from here.
+color shade_hit(
+    const ray& r, bool hit, const hit_record& rec, const color& background, const hittable& world,
+    const material_table& materials, int depth
+) {
+    // If the ray hits nothing, return the background color.
+    if (!hit)
+        return background;
+
+    ray scattered;
+    color attenuation;
+    color emitted = materials.emitted(rec.mat_id, rec.u, rec.v, rec.p);
+
+    if (!materials.scatter(rec.mat_id, r, rec, attenuation, scattered))
+        return emitted;
+
+    if (depth > 1)
+        count_stat(stat_counter::secondary_rays);
+    return emitted + attenuation * ray_color(scattered, background, world, materials, depth - 1);
+}
+
+color ray_color(const ray& r, const color& background, const hittable& world, const material_table& materials, int depth) {
+    hit_record rec;
+
+    // If we've exceeded the ray bounce limit, no more light is gathered.
+    if (depth <= 0)
+        return color(0, 0, 0);
+
+    bool hit = world.hit(r, ray_t_min, infinity, rec);
+    return shade_hit(r, hit, rec, background, world, materials, depth);
+}
+
+// Power heuristic weight (Veach) for a sample drawn with density pdf_a that another
+// strategy could have drawn with density pdf_b.
+inline double power_heuristic(double pdf_a, double pdf_b) {
+    auto a = pdf_a * pdf_a;
+    auto b = pdf_b * pdf_b;
+    return a + b > 0 ? a / (a + b) : 0;
+}
+
+// Next-event estimate at a lambertian hit with the given albedo: light reaching rec.p
+// along one ray aimed at a light, already multiplied by the surface's BRDF and cosine. The lambertian scatter
+// direction is cosine-distributed (density cos / pi), so whatever the shadow ray finds
+// could also have been found by the scattered ray; the power heuristic splits the
+// light between the two so that neither counts it twice.
+color sample_direct(
+    const hit_record& rec, const color& albedo, const hittable& world, const material_table& materials,
+    const light_list& lights
+) {
+    vec3 direction;
+    if (!lights.sample(rec.p, direction))
+        return color(0, 0, 0);
+
+    double cosine = dot(rec.normal, unit_vector(direction));
+    if (cosine <= 0)
+        return color(0, 0, 0);
+
+    // An occluder in front of the light simply comes back as a hit without emission.
+    ray shadow = rec.spawn_ray(direction);
+    hit_record light_rec;
+    count_stat(stat_counter::shadow_rays);
+    if (!world.hit(shadow, ray_t_min, infinity, light_rec))
+        return color(0, 0, 0);
+
+    color emitted = materials.emitted(light_rec.mat_id, light_rec.u, light_rec.v, light_rec.p);
+    if (emitted.x() <= 0 && emitted.y() <= 0 && emitted.z() <= 0)
+        return color(0, 0, 0);
+
+    // A degenerate light hit (a ray grazing a rectangle's plane) can leave the pdf NaN or
+    // infinite; shade_path() gives such a light to the scattered ray alone.
+    double light_pdf = lights.pdf(shadow.origin(), shadow.direction());
+    if (!(light_pdf > 0) || !std::isfinite(light_pdf))
+        return color(0, 0, 0);
+
+    double scatter_pdf = cosine / pi;
+    double weight = power_heuristic(light_pdf, scatter_pdf) * scatter_pdf / light_pdf;
+    return weight * albedo * emitted;
+}
+
+// Iterative form of shade_hit(): follows the path one bounce at a time, carrying the
+// product of the attenuations so far (the throughput) instead of a stack frame per
+// bounce. From roulette_depth bounces on, a path whose throughput has dropped below 1
+// survives each further bounce with probability equal to its brightest channel, and
+// survivors are scaled up by the inverse, which keeps the estimate unbiased. Paths
+// that lose nothing on the way, such as those inside glass, are never cut short, since
+// that only trades their time for fireflies. max_depth still caps the path length.
+//
+// With lights, every lambertian bounce also adds a next-event estimate (sample_direct),
+// and a light its scattered ray then hits is weighted by the matching power heuristic.
+// Other materials keep finding lights only through their scattered rays.
+//
+// With a pixel_spread, the angle a camera ray's pixel subtends, the path also carries a
+// ray cone for texture filtering (Akenine-Moller et al., "Texture Level of Detail
+// Strategies for Real-Time Ray Tracing", Ray Tracing Gems, 2019). Its width grows by the
+// spread over every segment; a mirror or glass bounce keeps the spread, ignoring the
+// curvature of the surface, a fuzzy metal widens it by the fuzz and a diffuse bounce
+// opens it to diffuse_spread, so textures seen indirectly are read at coarse levels.
+color shade_path(
+    ray r, bool hit, hit_record rec, const color& background, const hittable& world,
+    const material_table& materials, int max_depth, int roulette_depth, const light_list* lights = nullptr,
+    double pixel_spread = 0
+) {
+    // Each bounce starts on its own block of sampler dimensions after the two of the
+    // camera ray, enough for the most any material and light sample take.
+    const unsigned bounce_dimensions = 8;
+    const double diffuse_spread = 0.1;   // radians
+
+    color radiance(0, 0, 0);
+    color throughput(1, 1, 1);
+    double scatter_pdf = 0;   // density of r if it left a lambertian bounce that sampled a light
+    int vertices = 0;         // surface hits so far, for the path-length statistics
+    double cone_width = 0;
+    double cone_spread = pixel_spread;
+
+    for (int bounce = 1; ; ++bounce) {
+        if (!hit) {
+            radiance += throughput * background;
+            break;
+        }
+        vertices = bounce;
+
+        current_sampler().set_dimension(2 + bounce_dimensions * (bounce - 1));
+        if (cone_spread > 0)
+            cone_width += cone_spread * rec.t * r.direction().length();
+
+        ray scattered;
+        color attenuation;
+        color emitted = materials.emitted(rec.mat_id, rec.u, rec.v, rec.p);
+        if (scatter_pdf > 0 && (emitted.x() > 0 || emitted.y() > 0 || emitted.z() > 0)) {
+            double light_pdf = lights->pdf(r.origin(), r.direction());
+            if (std::isfinite(light_pdf))
+                emitted = power_heuristic(scatter_pdf, light_pdf) * emitted;
+        }
+        radiance += throughput * emitted;
+        if (bounce >= max_depth || !materials.scatter(rec.mat_id, r, rec, attenuation, scattered, cone_width))
+            break;
+
+        auto type = materials.type[rec.mat_id];
+        scatter_pdf = 0;
+        if (lights && !lights->empty() && type == material_type::lambertian) {
+            // A lambertian's attenuation is its albedo at the hit.
+            radiance += throughput * sample_direct(rec, attenuation, world, materials, *lights);
+            scatter_pdf = dot(rec.normal, unit_vector(scattered.direction())) / pi;
+        }
+        throughput = throughput * attenuation;
+        if (cone_spread > 0) {
+            if (type == material_type::metal)
+                cone_spread += materials.fuzz[rec.mat_id];
+            else if (type != material_type::dielectric)
+                cone_spread = std::max(cone_spread, diffuse_spread);
+        }
+
+        auto survive = std::max(throughput.x(), std::max(throughput.y(), throughput.z()));
+        if (bounce >= roulette_depth && survive < 1) {
+            if (sample_1d() >= survive)
+                break;
+            throughput /= survive;
+        }
+
+        r = scattered;
+        count_stat(stat_counter::secondary_rays);
+        hit = world.hit(r, ray_t_min, infinity, rec);
+    }
+
+    count_path(vertices);
+    return radiance;
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "rtweekend.h"
+#include "material_table.h"
+#include "primitive.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Builds u and v so that u, v and the unit vector w are an orthonormal basis, without
+// a branch on which axis w is closest to (Duff et al., "Building an Orthonormal Basis,
+// Revisited", JCGT 2017).
+inline void orthonormal_basis(const vec3& w, vec3& u, vec3& v) {
+    real sign = std::copysign(real(1), w.z());
+    real a = -1 / (sign + w.z());
+    real b = w.x() * w.y() * a;
+    u = vec3(1 + sign * w.x() * w.x() * a, sign * b, -sign * w.x());
+    v = vec3(b, sign + w.y() * w.y() * a, -w.y());
+}
+
+// The scene's emitters, collected once the world is built, for next-event estimation:
+// a diffuse bounce sends one ray straight at a light instead of waiting for its
+// scattered ray to find one. Spheres are sampled by the cone of directions they
+// subtend from the shading point, rects uniformly by area, and a box contributes its
+// six faces as rects. Every light is equally likely to be picked.
+class light_list {
+public:
+    light_list() {}
+
+    // Adds a sphere, aarect or box whose material is a diffuse_light. Returns false for
+    // any other object.
+    bool add(const hittable& object, const material_table& materials);
+    bool add(const primitive& p, const material_table& materials);
+
+    void add(const primitive& p);
+
+    size_t size() const { return lights.size(); }
+    bool empty() const { return lights.empty(); }
+
+    // Picks a light and a point on it as seen from p. Returns false if the chosen light
+    // cannot be sampled from p, e.g. from inside a sphere.
+    bool sample(const point3& p, vec3& direction) const;
+
+    // Solid-angle density of sample() producing this direction from p, summed over all
+    // lights the direction passes through, whether or not something blocks them.
+    double pdf(const point3& p, const vec3& direction) const;
+
+public:
+    std::vector<primitive> lights;   // spheres and rects only
+
+private:
+    static double sphere_pdf(const sphere_shape& s, const point3& p, const vec3& direction);
+    static double rect_pdf(const primitive& light, const point3& p, const vec3& direction);
+};
+
+bool light_list::add(const hittable& object, const material_table& materials) {
+    primitive p;
+    return primitive::from(object, p) && add(p, materials);
+}
+
+bool light_list::add(const primitive& p, const material_table& materials) {
+    if (p.type == primitive_type::triangle || materials.type[p.mat_id] != material_type::diffuse_light)
+        return false;
+    add(p);
+    return true;
+}
+
+void light_list::add(const primitive& p) {
+    if (p.type != primitive_type::box) {
+        lights.push_back(p);
+        return;
+    }
+
+    // The six faces of the box, each sampled as a rect.
+    const real* p0 = p.shape.box.min;
+    const real* p1 = p.shape.box.max;
+    lights.push_back(primitive::make_rect(primitive_type::xy_rect, p0[0], p1[0], p0[1], p1[1], p1[2], p.mat_id));
+    lights.push_back(primitive::make_rect(primitive_type::xy_rect, p0[0], p1[0], p0[1], p1[1], p0[2], p.mat_id));
+    lights.push_back(primitive::make_rect(primitive_type::xz_rect, p0[0], p1[0], p0[2], p1[2], p1[1], p.mat_id));
+    lights.push_back(primitive::make_rect(primitive_type::xz_rect, p0[0], p1[0], p0[2], p1[2], p0[1], p.mat_id));
+    lights.push_back(primitive::make_rect(primitive_type::yz_rect, p0[1], p1[1], p0[2], p1[2], p1[0], p.mat_id));
+    lights.push_back(primitive::make_rect(primitive_type::yz_rect, p0[1], p1[1], p0[2], p1[2], p0[0], p.mat_id));
+}
+
+bool light_list::sample(const point3& p, vec3& direction) const {
+    if (lights.empty())
+        return false;
+
+    auto index = std::min(lights.size() - 1, static_cast<size_t>(sample_1d() * lights.size()));
+    double u, v;
+    sample_2d(u, v);
+    const auto& light = lights[index];
+    const auto& s = light.shape;
+
+    if (light.type == primitive_type::sphere) {
+        vec3 to_center = to_point(s.sphere.center) - p;
+        auto distance_squared = to_center.length_squared();
+        auto radius_squared = s.sphere.radius * s.sphere.radius;
+        if (distance_squared <= radius_squared)
+            return false;
+
+        // Uniform over the cone; 1 - cos is kept in a form that does not cancel for
+        // small, distant spheres.
+        double sin2_max = radius_squared / distance_squared;
+        double cos_max = std::sqrt(1 - sin2_max);
+        double one_minus_cos = u * sin2_max / (1 + cos_max);
+        double sin_theta = std::sqrt(std::max(0.0, one_minus_cos * (2 - one_minus_cos)));
+        double phi = 2 * pi * v;
+
+        vec3 w = unit_vector(to_center);
+        vec3 u, v;
+        orthonormal_basis(w, u, v);
+        direction = real(std::cos(phi) * sin_theta) * u + real(std::sin(phi) * sin_theta) * v
+                  + real(1 - one_minus_cos) * w;
+        return true;
+    }
+
+    real a = s.rect.a0 + real(u) * (s.rect.a1 - s.rect.a0);
+    real b = s.rect.b0 + real(v) * (s.rect.b1 - s.rect.b0);
+    point3 q;
+    switch (light.type) {
+    case primitive_type::xy_rect: q = point3(a, b, s.rect.k); break;
+    case primitive_type::xz_rect: q = point3(a, s.rect.k, b); break;
+    case primitive_type::yz_rect: q = point3(s.rect.k, a, b); break;
+    default: return false;
+    }
+    direction = q - p;
+    return true;
+}
+
+double light_list::pdf(const point3& p, const vec3& direction) const {
+    double sum = 0;
+    for (const auto& light : lights) {
+        if (light.type == primitive_type::sphere)
+            sum += sphere_pdf(light.shape.sphere, p, direction);
+        else
+            sum += rect_pdf(light, p, direction);
+    }
+    return sum / lights.size();
+}
+
+double light_list::sphere_pdf(const sphere_shape& s, const point3& p, const vec3& direction) {
+    vec3 to_center = to_point(s.center) - p;
+    double distance_squared = to_center.length_squared();
+    double sin2_max = double(s.radius) * s.radius / distance_squared;
+    if (sin2_max >= 1)
+        return 0;
+
+    double cos_max = std::sqrt(1 - sin2_max);
+    double cosine = dot(direction, to_center) / (direction.length() * std::sqrt(distance_squared));
+    if (cosine < cos_max)
+        return 0;
+    return 1 / (2 * pi * sin2_max / (1 + cos_max));
+}
+
+double light_list::rect_pdf(const primitive& light, const point3& p, const vec3& direction) {
+    hit_record rec;
+    if (!intersect_primitive(light, ray(p, direction), ray_t_min, infinity, rec) || !std::isfinite(rec.t))
+        return 0;
+
+    int axis = light.type == primitive_type::xy_rect ? 2 : light.type == primitive_type::xz_rect ? 1 : 0;
+    const auto& r = light.shape.rect;
+    double area = double(r.a1 - r.a0) * (r.b1 - r.b0);
+    double length_squared = direction.length_squared();
+    double distance_squared = double(rec.t) * rec.t * length_squared;
+    double cosine = std::fabs(direction[axis]) / std::sqrt(length_squared);
+    if (cosine <= 0)
+        return 0;
+    return distance_squared / (cosine * area);
+}
+
+#endif
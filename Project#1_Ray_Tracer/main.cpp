@@ -4,15 +4,37 @@
 #include "hittable_list.h"
 #include "sphere.h"
 #include <iostream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 #include "camera.h"
 #include "material.h"
+#include "material_table.h"
 #include "box.h"
+#include "bvh.h"
+#include "checkpoint.h"
+#include "denoise.h"
+#include "framebuffer.h"
+#include "image_compare.h"
+#include "image_texture.h"
+#include "image_writer.h"
+#include "instance.h"
+#include "integrator.h"
+#include "lights.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scenes.h"
 
 //return (1.0 - t) * color(255, 212, 23) + t * color(135, 23, 255); background 
 
 //Before Emissive Materials
 /*
-color ray_color(const ray& r, const hittable& world, int depth) {
+color ray_color(const ray& r, const hittable& world, const material_table& materials, int depth) {
     hit_record rec;
 
     // If we've exceeded the ray bounce limit, no more light is gathered.
@@ -22,8 +44,8 @@ color ray_color(const ray& r, const hittable& world, int depth) {
     if (world.hit(r, 0.001, infinity, rec)) {
         ray scattered;
         color attenuation;
-        if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-            return attenuation * ray_color(scattered, world, depth - 1);
+        if (materials.scatter(rec.mat_id, r, rec, attenuation, scattered))
+            return attenuation * ray_color(scattered, world, materials, depth - 1);
         return color(0, 0, 0);
     }
 
@@ -33,198 +55,222 @@ color ray_color(const ray& r, const hittable& world, int depth) {
 }
 */
 
-color ray_color(const ray& r, const color& background, const hittable& world, int depth) {
-    hit_record rec;
-
-    // If we've exceeded the ray bounce limit, no more light is gathered.
-    if (depth <= 0)
-        return color(0, 0, 0);
-
-    // If the ray hits nothing, return the background color.
-    if (!world.hit(r, 0.001, infinity, rec))
-        return background;
-
-    ray scattered;
-    color attenuation;
-    color emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+int main(int argc, char* argv[]) {
+
+    const int roulette_depth = 3;
+
+    // Command line: [output.png|.pfm|.ppm] [--pass-spp N] [--checkpoint FILE]
+    //               [--checkpoint-every PASSES] [--preview-every PASSES]
+    //               [--adaptive THRESHOLD] [--min-spp N] [--spp-map FILE]
+    //               [--packets auto|avx2|sse2|scalar|off] [--reference FILE.pfm]
+    //               [--integrator nee|roulette|recursive]
+    //               [--sampler random|stratified|sobol|blue-noise]
+    //               [--scene FILE.scene|FILE.rtscene] [--save-scene FILE]
+    //               [--builtin mickey|objects] [--stats FILE.json]
+    //               [--samples FIRST:COUNT] [--tiles PART/PARTS] [--partial FILE]
+    //               [--threads N] [--denoise] [--aovs PREFIX] [--texture-cache MB]
+    // A progressive render takes samples_per_pixel in passes of --pass-spp samples. With
+    // --checkpoint the accumulation buffer is saved every few passes and picked up again
+    // when the same command is restarted.
+    // --adaptive stops sampling a pixel once its 95% confidence interval is below the
+    // threshold (in display units, e.g. 0.01), after at least --min-spp samples;
+    // samples_per_pixel becomes the maximum. --spp-map writes a heat map of samples used.
+    // --packets picks the instruction set for tracing primary rays in 4-ray packets
+    // (default: the best one the CPU supports); "off" traces every ray on its own. The
+    // image is the same either way.
+    // --reference reports the render time and the error against a .pfm rendered
+    // earlier, e.g. by the double-precision build when this one uses RT_FLOAT32.
+    // --integrator picks the iterative path tracer with Russian roulette, either with
+    // next-event estimation toward the scene's lights (nee, the default) or without
+    // (roulette), or the original recursive ray_color(), which always runs to max_depth.
+    // --sampler picks where the pixel jitter and the random choices along each path get
+    // their numbers: independent random numbers, jittered strata, Owen-scrambled Sobol
+    // points (default), or a Sobol sequence dithered across pixels with blue noise.
+    // --scene renders a scene file instead of the built-in scene, with its own image
+    // size, samples, camera and background (see scene.h). --save-scene writes the scene
+    // out and exits: text for authoring, or .rtscene for the binary form that loads by
+    // mapping the file. --builtin picks one of the built-in scenes instead (default
+    // mickey).
+    // --stats writes the render statistics of stats.h as JSON: rays by kind, tests per
+    // primitive type, BVH nodes visited, path lengths, and the time per worker and per
+    // tile. The counters only exist in builds with RT_STATS defined.
+    // --samples takes only samples [FIRST, FIRST + COUNT) of every pixel and --tiles only
+    // every PARTS-th tile from PART on, so that several processes or machines can share
+    // one frame. --partial writes what was rendered as a partial accumulation file (see
+    // checkpoint.h) for merge.cpp to combine; the image is then only written when an
+    // output file is named. farm.sh runs such a split on one machine. --threads sets the
+    // number of render workers (default: one per core).
+    // --denoise also records the albedo, normal and depth of every camera ray's first
+    // hit and filters the finished image with them (see denoise.h), which lets a render
+    // at 8-16 spp stand in for one at 100; the filter's time is reported on its own.
+    // --aovs writes those buffers as PREFIX_albedo, PREFIX_normal and PREFIX_depth, in
+    // the output's format (.pfm if there is none).
+    // --texture-cache caps the memory of expanded image texture tiles (default 64 MB; see
+    // image_texture.h); the cache's use is reported after the render.
+    std::string output_path;
+    std::string checkpoint_path;
+    std::string spp_map_path;
+    int pass_spp = 0;   // all samples in one pass
+    int checkpoint_every = 1;
+    int preview_every = 0;
+    adaptive_settings adaptive;
+    std::string packets = "auto";
+    std::string reference_path;
+    std::string integrator = "nee";
+    std::string sampler_name = "sobol";
+    std::string scene_path;
+    std::string save_scene_path;
+    std::string builtin_name = "mickey";
+    std::string stats_path;
+    int first_sample = 0;
+    int sample_count = -1;   // through samples_per_pixel
+    int tile_part = 0;
+    int tile_parts = 1;
+    std::string partial_path;
+    unsigned threads = 0;
+    bool denoising = false;
+    std::string aov_prefix;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (arg == "--pass-spp" && has_value)
+            pass_spp = std::max(1, std::atoi(argv[++a]));
+        else if (arg == "--checkpoint" && has_value)
+            checkpoint_path = argv[++a];
+        else if (arg == "--checkpoint-every" && has_value)
+            checkpoint_every = std::max(1, std::atoi(argv[++a]));
+        else if (arg == "--preview-every" && has_value)
+            preview_every = std::max(0, std::atoi(argv[++a]));
+        else if (arg == "--adaptive" && has_value)
+            adaptive.threshold = std::atof(argv[++a]);
+        else if (arg == "--min-spp" && has_value)
+            adaptive.min_samples = std::max(2, std::atoi(argv[++a]));
+        else if (arg == "--spp-map" && has_value)
+            spp_map_path = argv[++a];
+        else if (arg == "--packets" && has_value)
+            packets = argv[++a];
+        else if (arg == "--reference" && has_value)
+            reference_path = argv[++a];
+        else if (arg == "--integrator" && has_value)
+            integrator = argv[++a];
+        else if (arg == "--sampler" && has_value)
+            sampler_name = argv[++a];
+        else if (arg == "--scene" && has_value)
+            scene_path = argv[++a];
+        else if (arg == "--save-scene" && has_value)
+            save_scene_path = argv[++a];
+        else if (arg == "--builtin" && has_value)
+            builtin_name = argv[++a];
+        else if (arg == "--stats" && has_value)
+            stats_path = argv[++a];
+        else if (arg == "--samples" && has_value) {
+            if (std::sscanf(argv[++a], "%d:%d", &first_sample, &sample_count) != 2 || first_sample < 0 || sample_count < 0) {
+                std::cerr << "--samples takes FIRST:COUNT, not " << argv[a] << ".\n";
+                return 1;
+            }
+        }
+        else if (arg == "--tiles" && has_value) {
+            if (std::sscanf(argv[++a], "%d/%d", &tile_part, &tile_parts) != 2 || tile_parts < 1 || tile_part < 0 || tile_part >= tile_parts) {
+                std::cerr << "--tiles takes PART/PARTS with 0 <= PART < PARTS, not " << argv[a] << ".\n";
+                return 1;
+            }
+        }
+        else if (arg == "--partial" && has_value)
+            partial_path = argv[++a];
+        else if (arg == "--threads" && has_value)
+            threads = static_cast<unsigned>(std::max(0, std::atoi(argv[++a])));
+        else if (arg == "--denoise")
+            denoising = true;
+        else if (arg == "--aovs" && has_value)
+            aov_prefix = argv[++a];
+        else if (arg == "--texture-cache" && has_value)
+            texture_tiles().set_capacity(static_cast<size_t>(std::max(0.0, std::atof(argv[++a])) * 1048576));
+        else if (arg.compare(0, 2, "--") == 0) {
+            // Includes a known option given as the last argument, without its value.
+            std::cerr << "Unknown argument " << arg << (has_value ? "" : ", or it is missing its value") << ".\n";
+            return 1;
+        }
+        else
+            output_path = arg;
+    }
 
-    if (!rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-        return emitted;
+    // Scene: the file named by --scene, else a built-in one
+    scene_description scene;
+    if (!scene_path.empty()) {
+        if (!scene.load(scene_path))
+            return 1;
+        std::cerr << "Scene: " << scene_path << '\n';
+    }
+    else {
+        const builtin_scene* builtin = nullptr;
+        for (const auto& candidate : builtin_scenes) {
+            if (builtin_name == candidate.name)
+                builtin = &candidate;
+        }
+        if (!builtin) {
+            std::cerr << "There is no built-in scene called " << builtin_name << ".\n";
+            return 1;
+        }
 
-    return emitted + attenuation * ray_color(scattered, background, world, depth - 1);
-}
+        hittable_list world;
+        material_table builtin_materials;
+        builtin->build(world, builtin_materials, scene.settings);
+        if (!scene.capture(world, builtin_materials))
+            return 1;
+    }
 
-int main() {
+    if (!save_scene_path.empty())
+        return scene.save(save_scene_path) ? 0 : 1;
 
     // Image
-    //const auto aspect_ratio = 4.0 / 3.0;
-    //const int image_width = 800;
-    const auto aspect_ratio = 16.0 / 9.0;
-    const int image_width = 1920;
+    const auto& settings = scene.settings;
+    const auto aspect_ratio = settings.aspect_ratio;
+    const int image_width = settings.image_width;
     const int image_height = static_cast<int>(image_width / aspect_ratio);
-    const int samples_per_pixel = 100;
-    const int max_depth = 50;
-
-    //Blackout
-    //color background(0, 0, 0);
-    
-    //Navy Room
-    color background(0.0, 0.0, 0.4);
-
-    // World
-    hittable_list world;
-
-    // Materials
-    auto material_ground = make_shared<lambertian>(color(0.0, 0.0, 0.6));
-
-    //Metal
-    auto metal_gold = make_shared<metal>(color(1.0, 0.95, 0.0),0.15);
-    auto metal_green = make_shared<metal>(color(0.37, 1.0, 0.37),0.075);
-
-    //Lambert
-    auto material_orange = make_shared<lambertian>(color(0.7, 0.3, 0.3));
-    auto material_aqua = make_shared<lambertian>(color(0.2, 1.0, 1.0));
-    auto material_pink = make_shared<lambertian>(color(1.0, 0.6, 1.0));
-    auto material_lambert = make_shared<lambertian>(color(1.0, 1.0, 0.4));
-
-    //Glass
-    auto material_glass = make_shared<dielectric>(2.5);
-
-    //Diffuse Light
-    auto light_green = make_shared<diffuse_light>(color(0.4, 0.9, 0.1));
-    auto light_moon = make_shared<diffuse_light>(color(1.0, 1.0, 0.4));
-    auto light_orange = make_shared<diffuse_light>(color(0.7, 0.3, 0.3));
-    auto light_pink = make_shared<diffuse_light>(color(1.0, 0.6, 1.0));
-
-
-    /*
-    MAIN OBJECTS
-
-    //Ground
-    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
-    
-    //1
-    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, material_orange));
-    
-    //Glass 1
-    world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, material_glass));
-    
-    //Hollow Glass 1
-    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), -0.175, material_glass));
-
-    //Orange Light 1
-    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, light_orange));
-    
-    //2
-    world.add(make_shared<sphere>(point3(-0.6, 0.2, -1.0), 0.05, metal_gold));
-    
-    //3
-    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, metal_green));
-
-    //Green Light 3
-    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, light_green));
-    
-    //4
-    world.add(make_shared<sphere>(point3(0.5, 0.4, -1.0), 0.1, metal_gold));
-    
-    //5
-    //world.add(make_shared<sphere>(point3(0.95, 0.1, -1.0), 0.25, material_lambert));
-
-    //Orange Light 5
-    world.add(make_shared<sphere>(point3(0.95, 0.1, -1.0), 0.25, light_orange));
-
-    //Blue Cube Lambert
-    //world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), material_aqua));
-    
-    //Glass Cube
-    //world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), material_glass));
-
-    //Yellow Light Cube
-    world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), light_moon));
-    
-    //Pink Rectangle Prism Lambert
-    //world.add(make_shared<box>(point3(-0.15, -0.45, -0.15), point3(0.0, 0.0, 0.0), material_pink));
-
-    //Pink Light Rectangle Prism
-    world.add(make_shared<box>(point3(-0.15, -0.45, -0.15), point3(0.0, 0.0, 0.0), light_pink));
-
-    //Metal Green
-    world.add(make_shared<sphere>(point3(-0.4, -0.16, 0.18), 0.15, metal_green));
-    */
+    const int samples_per_pixel = settings.samples_per_pixel;
+    const int max_depth = settings.max_depth;
+    const unsigned seed = settings.seed;
+    const color background = settings.background;
+    if (pass_spp <= 0)
+        pass_spp = samples_per_pixel;
+
+    // Materials, referenced by the primitives through their table IDs
+    material_table materials;
+    scene.build_materials(materials);
+
+    // Emitters for next-event estimation: the world's own spheres and rects (see scene.h
+    // for those it leaves out)
+    light_list lights;
+    for (size_t i = 0; i < scene.primitive_count(); ++i)
+        lights.add(scene.primitives()[i], materials);
+
+    // Acceleration structure over the primitives, built in place from the scene, and
+    // the instances of its objects, which share one BVH per object
+    std::vector<shared_ptr<hittable>> instances;
+    scene.build_instances(instances);
+    if (scene.primitive_count() == 0 && instances.empty()) {
+        std::cerr << "The scene has no objects.\n";
+        return 1;
+    }
+    bvh_node world_bvh(scene.primitives(), scene.primitive_count(), instances);
+    auto stats = world_bvh.statistics();
+    std::cerr << "BVH: " << stats.node_count << " nodes (" << stats.leaf_count << " leaves), depth "
+              << stats.max_depth << ", SAH cost " << stats.sah_cost
+              << " (flat list: " << scene.primitive_count() + instances.size() << ")\n";
+    if (!instances.empty())
+        std::cerr << "Instances: " << instances.size() << " of " << scene.objects.size() + scene.meshes.size() << " objects\n";
+    if (!scene.meshes.empty()) {
+        size_t triangles = 0;
+        for (const auto& m : scene.meshes)
+            triangles += m.mesh->size();
+        std::cerr << "Meshes: " << scene.meshes.size() << ", " << triangles << " triangles\n";
+    }
 
-    //LET'S GET CREATIVE - MICKEY MOUSE
-    
-    //Ground
-    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
-    
-    //Head
-    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, light_moon));
-
-    //Right Ear
-    world.add(make_shared<sphere>(point3(0.5, 0.4, -1.0), 0.2, metal_gold));
-
-    //Left Ear
-    world.add(make_shared<sphere>(point3(-0.5, 0.4, -1.0), 0.2, metal_gold));
-
-    //Nose
-    world.add(make_shared<sphere>(point3(0.02, -0.125, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.01, -0.125, -0.6), 0.0425, metal_gold));
-    world.add(make_shared<sphere>(point3(0.00, -0.125, -0.6), 0.045, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.01, -0.125, -0.6), 0.0425, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.02, -0.125, -0.6), 0.04, metal_gold));
-
-    //Left Eye
-    world.add(make_shared<sphere>(point3(-0.125, 0.1, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.09, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.08, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.07, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.06, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.05, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.04, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.03, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.02, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.01, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, 0.00, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, -0.01, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, -0.02, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, -0.03, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(-0.125, -0.04, -0.6), 0.04, metal_gold));
-
-    //Right Eye
-    world.add(make_shared<sphere>(point3(0.125, 0.1, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.09, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.08, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.07, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.06, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.05, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.04, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.03, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.02, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.01, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, 0.00, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, -0.01, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, -0.02, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, -0.03, -0.6), 0.04, metal_gold));
-    world.add(make_shared<sphere>(point3(0.125, -0.04, -0.6), 0.04, metal_gold));
-
-    //Front Camera
-    //camera cam(point3(0, 0, 2), point3(0, 0.0, -1), vec3(0, 1, 0), 45, aspect_ratio);
-    
-    //Angle #1
-    //camera cam(point3(-1, 0, 2), point3(0, 0.5, -1), vec3(0, 1, 0), 40, aspect_ratio);
-
-    //Angle #2
-    camera cam(point3(-4.85, -0.45, 1.5), point3(1.25, 1.25, -1.5), vec3(0, 1, 0), 35, aspect_ratio);
-
-    // Camera
-    //Task1 Angle1
-    //camera cam(point3(-1, 0, 2), point3(0, 0.5, -1), vec3(0, 1, 0), 60, aspect_ratio);
-    
-    //Task1 Angle2
-    //camera cam(point3(-4.85, -0.45, 1.5), point3(1.25, 1.25, -1.5), vec3(0, 1, 0), 30, aspect_ratio);
+    camera cam(settings.lookfrom, settings.lookat, settings.vup, settings.vfov, aspect_ratio);
 
     // Render
-    std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
+    //std::cout << "P3\n" << image_width << ' ' << image_height << "\n255\n";
 
     //NO ANTI-ALIASING
     /*
@@ -241,6 +287,7 @@ int main() {
     */
 
     //RANDOM SUPERSAMPLING ANTI-ALIASING
+    /*
     for (int j = image_height - 1; j >= 0; --j) {
         std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
         for (int i = 0; i < image_width; ++i) {
@@ -250,11 +297,216 @@ int main() {
                 auto v = (j + random_double()) / (image_height - 1);
                 ray r = cam.get_ray(u, v);
                 //pixel_color += ray_color(r, world, max_depth);
-                pixel_color += ray_color(r, background, world, max_depth);
+                pixel_color += ray_color(r, background, world, materials, max_depth);
             }
             write_color(std::cout, pixel_color, samples_per_pixel);
         }
     }
+    */
+
+    //RANDOM SUPERSAMPLING ANTI-ALIASING - TILED, ONE WORKER PER CORE
+    framebuffer image(image_width, image_height);
+    tile_renderer renderer(32, threads);
+    renderer.adaptive = adaptive;
+    renderer.tile_part = tile_part;
+    renderer.tile_parts = tile_parts;
+    feature_buffers features(image_width, image_height);
+    if (denoising || !aov_prefix.empty())
+        renderer.features = &features;
+    renderer.sampling.samples_per_pixel = samples_per_pixel;
+    if (sampler_name == "random")
+        renderer.sampling.type = sampler_type::random;
+    else if (sampler_name == "stratified")
+        renderer.sampling.type = sampler_type::stratified;
+    else if (sampler_name == "blue-noise")
+        renderer.sampling.type = sampler_type::blue_noise;
+    else {
+        renderer.sampling.type = sampler_type::sobol;
+        sampler_name = "sobol";
+    }
+    std::cerr << "Sampler: " << sampler_name << '\n';
+
+    auto primary_ray = [&](int i, int j) {
+        double du, dv;
+        sample_2d(du, dv);
+        auto u = (i + du) / (image_width - 1);
+        auto v = (j + dv) / (image_height - 1);
+        return cam.get_ray(u, v);
+    };
+
+    if (integrator != "nee" && integrator != "recursive")
+        integrator = "roulette";
+    bool roulette = integrator != "recursive";
+    const light_list* direct_lights = integrator == "nee" ? &lights : nullptr;
+    if (direct_lights)
+        std::cerr << "Integrator: iterative, Russian roulette, next-event estimation (" << lights.size() << " lights)\n";
+    else
+        std::cerr << "Integrator: " << (roulette ? "iterative, Russian roulette" : "recursive, fixed depth") << '\n';
+
+    // Texture lookups filter over ray cones starting at the width of a pixel.
+    const double pixel_spread = cam.pixel_spread(image_height);
+
+    auto shade = [&](const ray& r, bool hit, const hit_record& rec) {
+        if (renderer.features)
+            record_first_hit(r, hit, rec, background, world_bvh, materials, pixel_spread);
+        if (roulette)
+            return shade_path(r, hit, rec, background, world_bvh, materials, max_depth, roulette_depth, direct_lights, pixel_spread);
+        return shade_hit(r, hit, rec, background, world_bvh, materials, max_depth);
+    };
+
+    auto sample_color = [&](int i, int j) {
+        auto r = primary_ray(i, j);
+        hit_record rec;
+        bool hit = world_bvh.hit(r, ray_t_min, infinity, rec);
+        return shade(r, hit, rec);
+    };
+
+    // Primary rays are traced in packets, every bounce after the first one ray at a time.
+    packet_tracer tracer;
+    tracer.primary = primary_ray;
+    tracer.shade = shade;
+    tracer.world = &world_bvh;
+
+    bool use_packets = packets != "off";
+    if (packets == "avx2")
+        use_packet_isa(packet_isa::avx2);
+    else if (packets == "sse2")
+        use_packet_isa(packet_isa::sse2);
+    else if (packets == "scalar")
+        use_packet_isa(packet_isa::scalar);
+    if (use_packets)
+        std::cerr << "Primary ray packets: " << packet_simd().name << '\n';
+    std::cerr << "Precision: " << (sizeof(real) == sizeof(float) ? "float32" : "float64") << '\n';
+
+    // The samples this process takes; all of them unless --samples says otherwise.
+    const int sample_end = sample_count < 0 ? samples_per_pixel : std::min(samples_per_pixel, first_sample + sample_count);
+    if (first_sample > 0 || sample_end < samples_per_pixel || tile_parts > 1)
+        std::cerr << "Share of the frame: samples " << first_sample << " to " << sample_end << ", tiles "
+                  << tile_part << '/' << tile_parts << '\n';
+
+    checkpoint_header share = {};
+    share.seed = seed;
+    share.samples_per_pixel = samples_per_pixel;
+    share.first_sample = first_sample;
+    share.sample_end = sample_end;
+    share.tile_part = tile_part;
+    share.tile_parts = tile_parts;
+    if (!checkpoint_path.empty() || !partial_path.empty())
+        share.setup = make_render_setup(scene.fingerprint(), sampler_name, integrator);
+
+    auto render_start = std::chrono::steady_clock::now();
+    int samples_taken = first_sample;
+    if (!checkpoint_path.empty() && load_checkpoint(checkpoint_path, image, share, samples_taken, renderer.features))
+        std::cerr << "Resuming from " << checkpoint_path << " at " << samples_taken << " spp\n";
+
+    for (int pass = 1; samples_taken < sample_end; ++pass) {
+        int pass_samples = std::min(pass_spp, sample_end - samples_taken);
+        if (use_packets)
+            renderer.render(image, seed, samples_taken, pass_samples, tracer);
+        else
+            renderer.render(image, seed, samples_taken, pass_samples, sample_color);
+        samples_taken += pass_samples;
+
+        bool last_pass = samples_taken == sample_end;
+        std::cerr << "\rPass " << pass << ": " << samples_taken << '/' << samples_per_pixel << " spp\n";
+
+        if (!checkpoint_path.empty() && (last_pass || pass % checkpoint_every == 0))
+            save_checkpoint(checkpoint_path, image, share, samples_taken, renderer.features);
+        if (!last_pass && preview_every > 0 && pass % preview_every == 0 && !output_path.empty())
+            write_image(output_path, image);
+    }
+
+    if (adaptive.threshold > 0) {
+        auto uniform = static_cast<double>(samples_per_pixel) * image_width * image_height;
+        std::cerr << "Adaptive sampling: " << image.total_samples() << " samples, "
+                  << 100.0 * image.total_samples() / uniform << "% of uniform\n";
+    }
+    if (!spp_map_path.empty())
+        write_image(spp_map_path, image_width, image_height, image.resolve_sample_heatmap(samples_per_pixel));
+
+    auto textures = texture_tiles().statistics();
+    if (textures.misses > 0) {
+        std::cerr << "Texture cache: " << textures.peak_bytes / 1048576.0 << " MB peak of "
+                  << texture_tiles().capacity_bytes() / 1048576.0 << " MB, " << textures.hits << " hits, "
+                  << textures.misses << " misses, " << textures.evictions << " evictions\n";
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - render_start;
+    if (!partial_path.empty()) {
+        partial_header range = {};
+        range.seed = seed;
+        range.samples_per_pixel = samples_per_pixel;
+        range.first_sample = first_sample;
+        range.sample_count = std::max(0, sample_end - first_sample);
+        range.tile_part = tile_part;
+        range.tile_parts = tile_parts;
+        range.setup = share.setup;
+        if (!save_partial(partial_path, image, range))
+            return 1;
+        std::cerr << "Partial render in " << partial_path << " after " << elapsed.count() << " s\n";
+    }
+
+    if (!stats_path.empty()) {
+        if (!stats_enabled)
+            std::cerr << "No statistics for " << stats_path << ": this build does not define RT_STATS.\n";
+        else if (!render_statistics().write_json(stats_path, elapsed.count()))
+            return 1;
+        else {
+            auto stats = render_statistics().total();
+            std::cerr << "Rays: " << stats.rays() << " (" << stats[stat_counter::primary_rays] << " primary, "
+                      << stats[stat_counter::secondary_rays] << " secondary, " << stats[stat_counter::shadow_rays] << " shadow), "
+                      << stats.rays() / elapsed.count() / 1e6 << " Mrays/s; statistics in " << stats_path << '\n';
+        }
+    }
+
+    if (!aov_prefix.empty()) {
+        std::string extension = ".pfm";
+        auto dot = output_path.rfind('.');
+        if (dot != std::string::npos && output_path.find_first_of("/\\", dot) == std::string::npos)
+            extension = output_path.substr(dot);
+        if (!write_image(aov_prefix + "_albedo" + extension, features.albedo_image())
+            || !write_image(aov_prefix + "_normal" + extension, features.normal_image())
+            || !write_image(aov_prefix + "_depth" + extension, features.depth_image()))
+            return 1;
+    }
+
+    if (denoising) {
+        auto denoise_start = std::chrono::steady_clock::now();
+        image = denoise(image, features, denoise_settings(), renderer.thread_count);
+        std::chrono::duration<double> denoise_time = std::chrono::steady_clock::now() - denoise_start;
+        std::cerr << "Denoised in " << denoise_time.count() << " s (render " << elapsed.count() << " s)\n";
+    }
+
+    if (!reference_path.empty()) {
+        int reference_width, reference_height;
+        std::vector<float> reference;
+        if (!read_pfm(reference_path, reference_width, reference_height, reference))
+            return 1;
+        if (reference_width != image_width || reference_height != image_height) {
+            std::cerr << reference_path << " is " << reference_width << 'x' << reference_height << ", not "
+                      << image_width << 'x' << image_height << ".\n";
+            return 1;
+        }
+        auto error = compare_images(image.resolve_hdr(), reference);
+        std::cerr << "Render time " << elapsed.count() << " s; against " << reference_path << ": RMSE "
+                  << error.rmse << ", max " << error.max_error;
+        if (error.non_finite > 0)
+            std::cerr << ", " << error.non_finite << " non-finite pixels\n";
+        else
+            std::cerr << ", PSNR " << error.psnr << " dB\n";
+    }
+
+    // Output: .png, .pfm (HDR) or binary .ppm named on the command line, else P6 on stdout
+    if (!output_path.empty()) {
+        if (!write_image(output_path, image))
+            return 1;
+    }
+    else if (partial_path.empty()) {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        write_ppm(std::cout, image_width, image_height, image.resolve());
+    }
 
     //GRID SUPERSAMPLING ANTI-ALIASING
     /*
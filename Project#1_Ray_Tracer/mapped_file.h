@@ -0,0 +1,115 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A whole file mapped read-only into memory. Loaders read their records straight out
+// of data() instead of copying them, and the pages only come in as they are touched.
+class mapped_file {
+public:
+    mapped_file() {}
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+
+bool mapped_file::open(const std::string& path) {
+    close();
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER file_size;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        std::cerr << "Cannot open " << path << ".\n";
+        close();
+        return false;
+    }
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    bytes = mapping ? static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!bytes) {
+        std::cerr << "Cannot map " << path << ".\n";
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(file_size.QuadPart);
+    return true;
+}
+
+void mapped_file::close() {
+    if (bytes)
+        UnmapViewOfFile(bytes);
+    if (mapping)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    bytes = nullptr;
+    length = 0;
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool mapped_file::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        std::cerr << "Cannot open " << path << ".\n";
+        if (fd >= 0)
+            ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file alive on its own.
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        std::cerr << "Cannot map " << path << ".\n";
+        return false;
+    }
+    bytes = static_cast<const char*>(view);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+void mapped_file::close() {
+    if (bytes)
+        munmap(const_cast<char*>(bytes), length);
+    bytes = nullptr;
+    length = 0;
+}
+
+#endif
+
+#endif
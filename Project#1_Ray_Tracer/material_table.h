@@ -0,0 +1,136 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include "rtweekend.h"
+#include "material.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Kinds of material the table can evaluate without a virtual call. Anything else is
+// kept as an object and goes through material::scatter/emitted.
+enum class material_type : uint8_t { lambertian, metal, dielectric, diffuse_light, other };
+
+// Scene-owned materials addressed by 32-bit IDs. hit_record carries only the ID, so
+// copying a record never touches a reference count. Parameters live in one array
+// per field, indexed by ID; fields a type does not use are left at their defaults.
+class material_table {
+public:
+    material_table() {}
+
+    // Returns the ID to hand to the primitives that use this material.
+    uint32_t add(shared_ptr<material> m);
+
+    size_t size() const { return type.size(); }
+
+    // cone_width is the width of the ray cone that found rec, for textures to filter
+    // over (see texture_footprint); 0 reads them unfiltered.
+    bool scatter(
+        uint32_t id, const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered,
+        double cone_width = 0
+    ) const;
+
+    color emitted(uint32_t id, double u, double v, const point3& p) const;
+
+    // The albedo of a lambertian or metal at a hit, from its texture if it has one.
+    color albedo_at(uint32_t id, const ray& r_in, const hit_record& rec, double cone_width = 0) const;
+
+public:
+    std::vector<material_type> type;
+    std::vector<color> albedo;               // lambertian, metal
+    std::vector<shared_ptr<texture>> albedo_map;   // lambertian; null for a uniform albedo
+    std::vector<double> fuzz;                // metal
+    std::vector<double> ir;                  // dielectric
+    std::vector<shared_ptr<texture>> emit;   // diffuse_light
+    std::vector<shared_ptr<material>> objects;
+};
+
+uint32_t material_table::add(shared_ptr<material> m) {
+    auto id = static_cast<uint32_t>(type.size());
+    material_type t = material_type::other;
+    color a;
+    double f = 0;
+    double index = 1;
+    shared_ptr<texture> e;
+    shared_ptr<texture> map;
+
+    if (auto l = dynamic_cast<const lambertian*>(m.get())) {
+        t = material_type::lambertian;
+        a = l->albedo;
+        map = l->albedo_map;
+    }
+    else if (auto me = dynamic_cast<const metal*>(m.get())) {
+        t = material_type::metal;
+        a = me->albedo;
+        f = me->fuzz;
+    }
+    else if (auto d = dynamic_cast<const dielectric*>(m.get())) {
+        t = material_type::dielectric;
+        index = d->ir;
+    }
+    else if (auto dl = dynamic_cast<const diffuse_light*>(m.get())) {
+        t = material_type::diffuse_light;
+        e = dl->emit;
+    }
+
+    type.push_back(t);
+    albedo.push_back(a);
+    albedo_map.push_back(map);
+    fuzz.push_back(f);
+    ir.push_back(index);
+    emit.push_back(e);
+    objects.push_back(m);
+    return id;
+}
+
+// Width in (u, v) of a ray cone cone_width across where it meets the surface: the
+// cone's cross-section, stretched by how obliquely it lands (up to 20 times, about 87
+// degrees) and measured in units of the surface's parameterization.
+inline double texture_footprint(const ray& r, const hit_record& rec, double cone_width) {
+    if (cone_width <= 0 || rec.uv_scale <= 0)
+        return 0;
+    double cosine = std::fabs(dot(unit_vector(r.direction()), rec.normal));
+    return cone_width / (std::max(cosine, 0.05) * rec.uv_scale);
+}
+
+bool material_table::scatter(
+    uint32_t id, const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered, double cone_width
+) const {
+    switch (type[id]) {
+    case material_type::lambertian:
+        return lambertian::scatter_with(albedo_at(id, r_in, rec, cone_width), rec, attenuation, scattered);
+    case material_type::metal:
+        return metal::scatter_with(albedo[id], fuzz[id], r_in, rec, attenuation, scattered);
+    case material_type::dielectric:
+        return dielectric::scatter_with(ir[id], r_in, rec, attenuation, scattered);
+    case material_type::diffuse_light:
+        return false;
+    case material_type::other:
+        break;
+    }
+    return objects[id]->scatter(r_in, rec, attenuation, scattered);
+}
+
+color material_table::emitted(uint32_t id, double u, double v, const point3& p) const {
+    switch (type[id]) {
+    case material_type::lambertian:
+    case material_type::metal:
+    case material_type::dielectric:
+        return color(0, 0, 0);
+    case material_type::diffuse_light:
+        return emit[id]->value(u, v, p);
+    case material_type::other:
+        break;
+    }
+    return objects[id]->emitted(u, v, p);
+}
+
+color material_table::albedo_at(uint32_t id, const ray& r_in, const hit_record& rec, double cone_width) const {
+    if (!albedo_map[id])
+        return albedo[id];
+    return albedo_map[id]->filtered(rec.u, rec.v, rec.p, texture_footprint(r_in, rec, cone_width));
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Combines the partial renders written by several raytracer processes (--partial, see
+// checkpoint.h) into one image. Each partial holds the sums and sample counts of the
+// tiles and samples its process took, so merging is a plain per-pixel sum, and the
+// merged image is the one a single process would have produced. Built on Linux with
+//
+//     make merge            (g++ -std=c++17 -O2 merge.cpp -o merge)
+//
+// Command line: OUTPUT PARTIAL... [--allow-incomplete]
+// The partials must come from the same frame: size, seed and samples per pixel have to
+// agree, and no two of them may have taken the same samples of the same tiles. Pixels
+// that no partial covered are reported, and fail the merge unless --allow-incomplete
+// is given (for a look at a farm that is still running).
+
+#include "rtweekend.h"
+
+#include "checkpoint.h"
+#include "framebuffer.h"
+#include "image_writer.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Whether two partials may have rendered some sample of some pixel twice. Tile splits
+// of the same frame interleave the same tile list, so parts of one split never share
+// a tile; splits into a different number of parts are assumed to overlap.
+bool overlaps(const partial_header& a, const partial_header& b) {
+    bool samples_overlap = a.first_sample < b.first_sample + b.sample_count
+        && b.first_sample < a.first_sample + a.sample_count;
+    bool tiles_overlap = a.tile_parts != b.tile_parts || a.tile_part == b.tile_part;
+    return samples_overlap && tiles_overlap;
+}
+
+int main(int argc, char* argv[]) {
+    std::string output_path;
+    std::vector<std::string> partial_paths;
+    bool allow_incomplete = false;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        if (arg == "--allow-incomplete")
+            allow_incomplete = true;
+        else if (output_path.empty())
+            output_path = arg;
+        else
+            partial_paths.push_back(arg);
+    }
+    if (output_path.empty() || partial_paths.empty()) {
+        std::cerr << "Usage: merge OUTPUT PARTIAL... [--allow-incomplete]\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<partial_header> headers;
+    framebuffer merged(0, 0);
+    for (const auto& path : partial_paths) {
+        partial_header header;
+        framebuffer part(0, 0);
+        if (!load_partial(path, header, part, headers.empty() ? nullptr : &headers.front()))
+            return 1;
+
+        if (headers.empty())
+            merged = framebuffer(header.width, header.height);
+        for (size_t i = 0; i < headers.size(); ++i) {
+            if (overlaps(headers[i], header)) {
+                std::cerr << path << " overlaps " << partial_paths[i] << ".\n";
+                return 1;
+            }
+        }
+        headers.push_back(header);
+
+        for (size_t p = 0; p < merged.pixels.size(); ++p) {
+            merged.pixels[p] += part.pixels[p];
+            merged.samples[p] += part.samples[p];
+            merged.luminance_sq[p] += part.luminance_sq[p];
+        }
+    }
+
+    size_t missing = 0;
+    for (auto n : merged.samples)
+        if (n == 0)
+            ++missing;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cerr << "Merged " << headers.size() << " partials of " << merged.width << 'x' << merged.height
+              << " in " << elapsed.count() << " s, " << merged.total_samples() << " samples\n";
+    if (missing) {
+        std::cerr << missing << " pixels have no samples.\n";
+        if (!allow_incomplete)
+            return 1;
+    }
+
+    return write_image(output_path, merged) ? 0 : 1;
+}
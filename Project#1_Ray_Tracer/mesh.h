@@ -0,0 +1,346 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// An indexed triangle mesh behind one hittable, e.g. a model loaded with load_obj().
+// Faces index shared positions, normals and texture coordinates, so a model costs one
+// copy of each vertex however many faces meet there.
+//
+// The mesh keeps a hierarchy of its own instead of going into the scene's bvh_node as
+// single triangles: a flat array of nodes, traversed with a small stack, near child
+// first, and leaves of up to max_leaf_size triangles whose corners are copied out into
+// structure-of-arrays lanes, so packet_kernels::triangle_block tests four triangles per
+// call. The test is watertight (see triangle_ray), so no ray slips through the shared
+// edge of two faces.
+//
+// Call build() once the faces are in and before the first hit().
+class triangle_mesh : public hittable {
+public:
+    static const uint32_t no_index = 0xffffffff;
+
+    // Indices into positions, normals and uvs; the normals and uvs of a face are
+    // no_index when the model has none for it.
+    struct face {
+        uint32_t position[3];
+        uint32_t normal[3];
+        uint32_t uv[3];
+        uint32_t mat_id;
+    };
+
+    struct build_stats {
+        int node_count = 0;
+        int leaf_count = 0;
+        int max_depth = 0;
+    };
+
+    triangle_mesh() {}
+
+    uint32_t add_position(const point3& p) { positions.push_back(p); return static_cast<uint32_t>(positions.size() - 1); }
+    uint32_t add_normal(const vec3& n) { normals.push_back(n); return static_cast<uint32_t>(normals.size() - 1); }
+    uint32_t add_uv(real u, real v) { uvs.push_back(u); uvs.push_back(v); return static_cast<uint32_t>(uvs.size() / 2 - 1); }
+    void add_face(const face& f) { faces.push_back(f); }
+
+    size_t size() const { return faces.size(); }
+
+    build_stats build();
+
+    virtual bool hit(
+        const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+public:
+    std::vector<point3> positions;
+    std::vector<vec3> normals;
+    std::vector<real> uvs;   // u, v pairs
+    std::vector<face> faces;
+
+    static const int bin_count = 12;
+    static const int max_leaf_size = 2 * triangle_block_size;
+    static const int max_tree_depth = 64;   // the traversal stack
+    static constexpr double traversal_cost = 1.0;
+    static constexpr double block_cost = 2.0;   // one triangle_block call, in node visits
+
+private:
+    // Interior nodes have their first child right after them and the second at offset;
+    // leaves hold count lanes from offset on, count a multiple of triangle_block_size.
+    struct node {
+        aabb box;
+        uint32_t offset;
+        uint32_t count;   // 0 for interior nodes
+        uint32_t axis;    // split axis, for choosing the near child
+    };
+
+    struct build_item {
+        aabb box;
+        point3 centroid;
+        uint32_t face;
+    };
+
+    void build_node(std::vector<build_item>& items, size_t start, size_t end, int depth, build_stats& stats);
+    void add_leaf(const std::vector<build_item>& items, size_t start, size_t end);
+
+    static double leaf_cost(size_t count) {
+        return block_cost * ((count + triangle_block_size - 1) / triangle_block_size);
+    }
+
+private:
+    std::vector<node> nodes;
+    std::vector<real> corner[3][3];     // [vertex][axis], one entry per lane
+    std::vector<uint32_t> lane_face;
+};
+
+triangle_mesh::build_stats triangle_mesh::build() {
+    build_stats stats;
+    nodes.clear();
+    lane_face.clear();
+    for (auto& vertex : corner)
+        for (auto& axis : vertex)
+            axis.clear();
+    if (faces.empty())
+        return stats;
+
+    std::vector<build_item> items(faces.size());
+    for (size_t i = 0; i < faces.size(); ++i) {
+        const auto& f = faces[i];
+        point3 a = positions[f.position[0]], b = positions[f.position[1]], c = positions[f.position[2]];
+        auto& item = items[i];
+        item.box = aabb(
+            point3(fmin(a.x(), fmin(b.x(), c.x())), fmin(a.y(), fmin(b.y(), c.y())), fmin(a.z(), fmin(b.z(), c.z()))),
+            point3(fmax(a.x(), fmax(b.x(), c.x())), fmax(a.y(), fmax(b.y(), c.y())), fmax(a.z(), fmax(b.z(), c.z()))));
+        item.centroid = 0.5 * (item.box.min() + item.box.max());
+        item.face = static_cast<uint32_t>(i);
+    }
+
+    nodes.reserve(2 * faces.size() / triangle_block_size + 1);
+    build_node(items, 0, items.size(), 1, stats);
+    return stats;
+}
+
+void triangle_mesh::build_node(std::vector<build_item>& items, size_t start, size_t end, int depth, build_stats& stats) {
+    size_t span = end - start;
+    auto index = nodes.size();
+    nodes.push_back(node());
+    stats.node_count++;
+    stats.max_depth = std::max(stats.max_depth, depth);
+
+    aabb box = items[start].box;
+    aabb centroid_box(items[start].centroid, items[start].centroid);
+    for (size_t i = start + 1; i < end; ++i) {
+        box = surrounding_box(box, items[i].box);
+        centroid_box = surrounding_box(centroid_box, aabb(items[i].centroid, items[i].centroid));
+    }
+    nodes[index].box = box;
+
+    auto make_leaf = [&]() {
+        stats.leaf_count++;
+        nodes[index].offset = static_cast<uint32_t>(lane_face.size());
+        add_leaf(items, start, end);
+        nodes[index].count = static_cast<uint32_t>(lane_face.size() - nodes[index].offset);
+    };
+
+    // The same binned SAH sweep as bvh_node, costed in triangle blocks.
+    double best_cost = infinity;
+    int best_axis = -1;
+    int best_split = 0;
+    for (int axis = 0; axis < 3 && span > 1; ++axis) {
+        double lo = centroid_box.min()[axis];
+        double extent = centroid_box.max()[axis] - lo;
+        if (extent <= 0)
+            continue;
+
+        aabb bin_box[bin_count];
+        int bin_size[bin_count] = {};
+        for (size_t i = start; i < end; ++i) {
+            int b = std::min(bin_count - 1, static_cast<int>(bin_count * (items[i].centroid[axis] - lo) / extent));
+            bin_box[b] = bin_size[b] ? surrounding_box(bin_box[b], items[i].box) : items[i].box;
+            bin_size[b]++;
+        }
+
+        double right_area[bin_count];
+        int right_count[bin_count];
+        aabb sweep;
+        int count = 0;
+        for (int b = bin_count - 1; b > 0; --b) {
+            if (bin_size[b])
+                sweep = count ? surrounding_box(sweep, bin_box[b]) : bin_box[b];
+            count += bin_size[b];
+            right_area[b] = count ? sweep.surface_area() : 0;
+            right_count[b] = count;
+        }
+
+        count = 0;
+        for (int b = 0; b < bin_count - 1; ++b) {
+            if (bin_size[b])
+                sweep = count ? surrounding_box(sweep, bin_box[b]) : bin_box[b];
+            count += bin_size[b];
+            if (count == 0 || right_count[b + 1] == 0)
+                continue;
+
+            double cost = leaf_cost(count) * sweep.surface_area() + leaf_cost(right_count[b + 1]) * right_area[b + 1];
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    // Past max_tree_depth the traversal stack would overflow, so whatever is left
+    // becomes one leaf; SAH splits of real models stay far from it.
+    bool fits = span <= static_cast<size_t>(max_leaf_size);
+    double split_cost = traversal_cost + best_cost / box.surface_area();
+    if (depth >= max_tree_depth || (fits && (best_axis < 0 || leaf_cost(span) <= split_cost))) {
+        make_leaf();
+        return;
+    }
+
+    size_t mid;
+    if (best_axis < 0) {
+        // All centroids coincide; split by count.
+        best_axis = 0;
+        mid = start + span / 2;
+    }
+    else {
+        double lo = centroid_box.min()[best_axis];
+        double extent = centroid_box.max()[best_axis] - lo;
+        auto middle = std::partition(items.begin() + start, items.begin() + end,
+            [&](const build_item& item) {
+                int b = std::min(bin_count - 1, static_cast<int>(bin_count * (item.centroid[best_axis] - lo) / extent));
+                return b <= best_split;
+            });
+        mid = static_cast<size_t>(middle - items.begin());
+    }
+
+    build_node(items, start, mid, depth + 1, stats);
+    nodes[index].offset = static_cast<uint32_t>(nodes.size());
+    nodes[index].count = 0;
+    nodes[index].axis = static_cast<uint32_t>(best_axis);
+    build_node(items, mid, end, depth + 1, stats);
+}
+
+void triangle_mesh::add_leaf(const std::vector<build_item>& items, size_t start, size_t end) {
+    // The last triangle fills up the final block; a repeat can only hit where the
+    // original does, so the padding never changes a hit.
+    size_t lanes = (end - start + triangle_block_size - 1) / triangle_block_size * triangle_block_size;
+    for (size_t k = 0; k < lanes; ++k) {
+        auto id = items[std::min(start + k, end - 1)].face;
+        lane_face.push_back(id);
+        for (int vertex = 0; vertex < 3; ++vertex) {
+            const auto& p = positions[faces[id].position[vertex]];
+            for (int a = 0; a < 3; ++a)
+                corner[vertex][a].push_back(p[a]);
+        }
+    }
+}
+
+bool triangle_mesh::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    if (nodes.empty())
+        return false;
+
+    const triangle_lanes lanes = { {
+        { corner[0][0].data(), corner[0][1].data(), corner[0][2].data() },
+        { corner[1][0].data(), corner[1][1].data(), corner[1][2].data() },
+        { corner[2][0].data(), corner[2][1].data(), corner[2][2].data() },
+    } };
+    const auto origin = r.origin();
+    const auto direction = r.direction();
+    const triangle_ray sheared(origin.e, direction.e);
+    const auto& kernels = packet_simd();
+
+    uint32_t closest = no_index;
+    real closest_t = t_max, closest_u = 0, closest_v = 0;
+    real t[triangle_block_size], u[triangle_block_size], v[triangle_block_size];
+
+    uint32_t stack[max_tree_depth];
+    int top = 0;
+    uint32_t current = 0;
+    for (;;) {
+        const auto& n = nodes[current];
+        count_stat(stat_counter::bvh_nodes);
+        if (n.box.hit_conservative(r, t_min, closest_t)) {
+            if (n.count == 0) {
+                uint32_t near_child = current + 1, far_child = n.offset;
+                if (r.sign[n.axis])
+                    std::swap(near_child, far_child);
+                stack[top++] = far_child;
+                current = near_child;
+                continue;
+            }
+
+            count_stat(stat_counter::triangle_tests, n.count);
+            for (uint32_t first = n.offset; first < n.offset + n.count; first += triangle_block_size) {
+                unsigned mask = kernels.triangle_block(lanes, first, sheared, t_min, closest_t, t, u, v);
+                for (int k = 0; mask; ++k, mask >>= 1) {
+                    if ((mask & 1) && t[k] <= closest_t) {
+                        closest_t = t[k];
+                        closest_u = u[k];
+                        closest_v = v[k];
+                        closest = first + k;
+                    }
+                }
+            }
+        }
+        if (top == 0)
+            break;
+        current = stack[--top];
+    }
+
+    if (closest == no_index)
+        return false;
+
+    // Barycentric weights of the three corners.
+    const auto& f = faces[lane_face[closest]];
+    real b0 = 1 - closest_u - closest_v, b1 = closest_u, b2 = closest_v;
+    point3 p0 = positions[f.position[0]], p1 = positions[f.position[1]], p2 = positions[f.position[2]];
+
+    rec.t = closest_t;
+    rec.p = b0 * p0 + b1 * p1 + b2 * p2;
+    rec.p_error = rounding_error<real>(7) * (max_abs(b0 * p0) + max_abs(b1 * p1) + max_abs(b2 * p2));
+    rec.set_face_normal(r, unit_vector(cross(p1 - p0, p2 - p0)));
+    if (f.normal[0] != no_index) {
+        // Smooth shading; front_face and the side stay the geometric ones.
+        vec3 shading = unit_vector(b0 * normals[f.normal[0]] + b1 * normals[f.normal[1]] + b2 * normals[f.normal[2]]);
+        rec.normal = dot(shading, rec.normal) < 0 ? -shading : shading;
+    }
+    if (f.uv[0] != no_index) {
+        const real* uv0 = &uvs[2 * f.uv[0]];
+        const real* uv1 = &uvs[2 * f.uv[1]];
+        const real* uv2 = &uvs[2 * f.uv[2]];
+        rec.u = b0 * uv0[0] + b1 * uv1[0] + b2 * uv2[0];
+        rec.v = b0 * uv0[1] + b1 * uv1[1] + b2 * uv2[1];
+
+        // dp/du and dp/dv from the two edges and their (u, v) spans (PBRT, section 3.6.2).
+        real du1 = uv1[0] - uv0[0], dv1 = uv1[1] - uv0[1];
+        real du2 = uv2[0] - uv0[0], dv2 = uv2[1] - uv0[1];
+        real det = du1 * dv2 - dv1 * du2;
+        rec.uv_scale = 0;
+        if (det != 0) {
+            vec3 dpdu = (dv2 * (p1 - p0) - dv1 * (p2 - p0)) / det;
+            vec3 dpdv = (du1 * (p2 - p0) - du2 * (p1 - p0)) / det;
+            rec.uv_scale = std::sqrt(std::fmin(dpdu.length_squared(), dpdv.length_squared()));
+        }
+    }
+    else {
+        rec.u = closest_u;
+        rec.v = closest_v;
+        rec.uv_scale = std::sqrt(std::fmin((p1 - p0).length_squared(), (p2 - p0).length_squared()));
+    }
+    rec.mat_id = f.mat_id;
+    return true;
+}
+
+bool triangle_mesh::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (nodes.empty())
+        return false;
+    output_box = nodes[0].box;
+    return true;
+}
+
+#endif
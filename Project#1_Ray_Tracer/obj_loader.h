@@ -0,0 +1,276 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rtweekend.h"
+#include "mesh.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Wavefront OBJ import. Handles what modelling packages write for static geometry:
+// v, vn and vt, faces in the v, v/vt, v//vn and v/vt/vn forms with negative (relative)
+// indices, polygons (split into a fan of triangles), usemtl and mtllib. Groups,
+// smoothing groups and free-form geometry are skipped.
+//
+// Materials come from the MTL files as a diffuse color (Kd) or image (map_Kd, which
+// takes its place) and an emission (Ke); the rest of the Phong description, and any
+// options of map_Kd, are ignored. A material a face uses but no MTL file defines is a
+// mid gray.
+struct obj_material {
+    std::string name;
+    color diffuse = color(0.5, 0.5, 0.5);
+    std::string diffuse_map;   // path of the image, empty if none
+    color emission = color(0, 0, 0);
+};
+
+namespace obj_detail {
+
+// The whole file at once; parsing then walks the buffer without any stream overhead.
+inline bool read_file(const std::string& path, std::string& text) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << path << ".\n";
+        return false;
+    }
+    text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+inline std::string directory_of(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+inline const char* skip_blanks(const char* s) {
+    while (*s == ' ' || *s == '\t')
+        ++s;
+    return s;
+}
+
+// The rest of the line as one name, without trailing blanks.
+inline std::string rest_of_line(const char* s) {
+    s = skip_blanks(s);
+    const char* end = s;
+    while (*end && *end != '\n' && *end != '\r')
+        ++end;
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t'))
+        --end;
+    return std::string(s, end);
+}
+
+inline int read_reals(const char* s, double* out, int count) {
+    int n = 0;
+    for (; n < count; ++n) {
+        char* end;
+        out[n] = std::strtod(s, &end);
+        if (end == s)
+            break;
+        s = end;
+    }
+    return n;
+}
+
+inline bool load_mtl(const std::string& path, std::vector<obj_material>& materials) {
+    std::string text;
+    if (!read_file(path, text))
+        return false;
+
+    obj_material* current = nullptr;
+    for (const char* line = text.c_str(); *line; ) {
+        const char* s = skip_blanks(line);
+        const char* next = std::strchr(s, '\n');
+        next = next ? next + 1 : s + std::strlen(s);
+
+        double c[3];
+        if (std::strncmp(s, "newmtl", 6) == 0) {
+            materials.push_back(obj_material());
+            current = &materials.back();
+            current->name = rest_of_line(s + 6);
+        }
+        else if (current && std::strncmp(s, "Kd", 2) == 0 && read_reals(s + 2, c, 3) == 3) {
+            current->diffuse = color(c[0], c[1], c[2]);
+        }
+        else if (current && std::strncmp(s, "Ke", 2) == 0 && read_reals(s + 2, c, 3) == 3) {
+            current->emission = color(c[0], c[1], c[2]);
+        }
+        else if (current && std::strncmp(s, "map_Kd", 6) == 0) {
+            // The file name is the last word; options come before it.
+            auto words = rest_of_line(s + 6);
+            auto start = words.find_last_of(" \t");
+            auto name = start == std::string::npos ? words : words.substr(start + 1);
+            if (!name.empty())
+                current->diffuse_map = directory_of(path) + name;
+        }
+        line = next;
+    }
+    return true;
+}
+
+} // namespace obj_detail
+
+// Appends the model in the OBJ file to the mesh and builds the mesh's hierarchy. Face
+// material IDs index the returned materials, in order of first use.
+bool load_obj(const std::string& path, triangle_mesh& mesh, std::vector<obj_material>& materials) {
+    using namespace obj_detail;
+
+    std::string text;
+    if (!read_file(path, text))
+        return false;
+
+    std::vector<obj_material> library;
+    std::map<std::string, uint32_t> used;   // material name to ID
+    uint32_t current_material = triangle_mesh::no_index;
+    auto use_material = [&](const std::string& name) {
+        auto found = used.find(name);
+        if (found != used.end())
+            return found->second;
+        obj_material m;
+        m.name = name.empty() ? "default" : name;
+        for (const auto& defined : library) {
+            if (defined.name == name)
+                m = defined;
+        }
+        auto id = static_cast<uint32_t>(materials.size());
+        materials.push_back(m);
+        used[name] = id;
+        return id;
+    };
+
+    // Indices are relative to this file, which may be appended to a mesh with
+    // vertices already in it.
+    const auto position_base = static_cast<uint32_t>(mesh.positions.size());
+    const auto normal_base = static_cast<uint32_t>(mesh.normals.size());
+    const auto uv_base = static_cast<uint32_t>(mesh.uvs.size() / 2);
+    uint32_t positions = 0, normals = 0, uvs = 0;
+
+    // OBJ indices start at 1; negative ones count back from the last vertex read.
+    auto resolve = [](long index, uint32_t count, uint32_t base, uint32_t& out) {
+        if (index > 0 && static_cast<unsigned long>(index) <= count)
+            out = base + static_cast<uint32_t>(index - 1);
+        else if (index < 0 && static_cast<unsigned long>(-index) <= count)
+            out = base + count - static_cast<uint32_t>(-index);
+        else
+            return false;
+        return true;
+    };
+
+    int line_number = 0;
+    std::vector<triangle_mesh::face> polygon;
+    for (const char* line = text.c_str(); *line; ) {
+        ++line_number;
+        const char* s = skip_blanks(line);
+        const char* next = std::strchr(s, '\n');
+        next = next ? next + 1 : s + std::strlen(s);
+        auto fail = [&](const char* message) {
+            std::cerr << path << ':' << line_number << ": " << message << '\n';
+            return false;
+        };
+
+        double c[3];
+        if (s[0] == 'v' && (s[1] == ' ' || s[1] == '\t')) {
+            if (read_reals(s + 1, c, 3) != 3)
+                return fail("v needs X Y Z");
+            mesh.add_position(point3(c[0], c[1], c[2]));
+            ++positions;
+        }
+        else if (s[0] == 'v' && s[1] == 'n') {
+            if (read_reals(s + 2, c, 3) != 3)
+                return fail("vn needs X Y Z");
+            mesh.add_normal(vec3(c[0], c[1], c[2]));
+            ++normals;
+        }
+        else if (s[0] == 'v' && s[1] == 't') {
+            if (read_reals(s + 2, c, 2) != 2)
+                return fail("vt needs U V");
+            mesh.add_uv(c[0], c[1]);
+            ++uvs;
+        }
+        else if (s[0] == 'f' && (s[1] == ' ' || s[1] == '\t')) {
+            // Each corner goes into slot 0 of a face record; the fan is built below.
+            polygon.clear();
+            const char* p = s + 1;
+            for (;;) {
+                p = skip_blanks(p);
+                if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#')
+                    break;
+
+                triangle_mesh::face corner = {};
+                corner.normal[0] = corner.uv[0] = triangle_mesh::no_index;
+                char* end;
+                long index = std::strtol(p, &end, 10);
+                if (end == p || !resolve(index, positions, position_base, corner.position[0]))
+                    return fail("face with a bad vertex index");
+                p = end;
+                if (*p == '/') {
+                    ++p;
+                    if (*p != '/') {
+                        index = std::strtol(p, &end, 10);
+                        if (end == p || !resolve(index, uvs, uv_base, corner.uv[0]))
+                            return fail("face with a bad texture coordinate index");
+                        p = end;
+                    }
+                    if (*p == '/') {
+                        ++p;
+                        index = std::strtol(p, &end, 10);
+                        if (end == p || !resolve(index, normals, normal_base, corner.normal[0]))
+                            return fail("face with a bad normal index");
+                        p = end;
+                    }
+                }
+                polygon.push_back(corner);
+            }
+            if (polygon.size() < 3)
+                return fail("face with fewer than three vertices");
+
+            if (current_material == triangle_mesh::no_index)
+                current_material = use_material("");
+            for (size_t k = 1; k + 1 < polygon.size(); ++k) {
+                const triangle_mesh::face* corners[3] = { &polygon[0], &polygon[k], &polygon[k + 1] };
+                triangle_mesh::face f;
+                for (int i = 0; i < 3; ++i) {
+                    f.position[i] = corners[i]->position[0];
+                    f.normal[i] = corners[i]->normal[0];
+                    f.uv[i] = corners[i]->uv[0];
+                }
+                // A face without a normal or a texture coordinate at every corner has
+                // none at all.
+                if (f.normal[0] == triangle_mesh::no_index || f.normal[1] == triangle_mesh::no_index
+                    || f.normal[2] == triangle_mesh::no_index)
+                    f.normal[0] = f.normal[1] = f.normal[2] = triangle_mesh::no_index;
+                if (f.uv[0] == triangle_mesh::no_index || f.uv[1] == triangle_mesh::no_index
+                    || f.uv[2] == triangle_mesh::no_index)
+                    f.uv[0] = f.uv[1] = f.uv[2] = triangle_mesh::no_index;
+                f.mat_id = current_material;
+                mesh.add_face(f);
+            }
+        }
+        else if (std::strncmp(s, "usemtl", 6) == 0) {
+            current_material = use_material(rest_of_line(s + 6));
+        }
+        else if (std::strncmp(s, "mtllib", 6) == 0) {
+            // Names are relative to the OBJ file. A missing library leaves its
+            // materials gray rather than failing the model.
+            std::istringstream names(rest_of_line(s + 6));
+            std::string name;
+            while (names >> name)
+                load_mtl(directory_of(path) + name, library);
+        }
+        line = next;
+    }
+
+    if (mesh.size() == 0) {
+        std::cerr << path << " has no faces.\n";
+        return false;
+    }
+    mesh.build();
+    return true;
+}
+
+#endif
@@ -0,0 +1,882 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include "precision.h"
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PACKET_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PACKET_TARGET_AVX2
+#else
+#define PACKET_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+// Lane kernels for tracing packet_width coherent rays at once, and for testing one ray
+// against a block of sphere_block_size spheres or triangle_block_size triangles stored
+// as structure-of-arrays.
+//
+// The kernels only decide which lanes hit a primitive; the hit record of a lane that
+// does is filled in by scalar code. They evaluate exactly the same expressions as the
+// scalar hit() functions, in the same order and the same precision (real), so a lane is
+// reported as a hit if and only if the scalar test succeeds. That holds as long as the
+// compiler does not contract the scalar code into FMAs (the default for MSVC
+// /fp:precise and for GCC/Clang in ISO C++ mode).
+//
+// Three implementations share one interface and are picked at run time:
+//
+//     scalar   one lane after another, any platform
+//     sse2     two lanes per instruction, every x86-64 CPU
+//     avx2     all four lanes per instruction, when the CPU supports it
+//
+// In single precision (RT_FLOAT32) a whole packet fits in one SSE register, so sse2
+// already handles four lanes per instruction and avx2 only widens the sphere blocks,
+// to all eight spheres at once; a triangle block is one SSE register as well.
+
+const int packet_width = 4;
+
+// Structure-of-arrays view of the rays in a packet.
+struct packet_rays {
+    alignas(32) real orig[3][packet_width] = {};
+    alignas(32) real dir[3][packet_width] = {};
+    alignas(32) real inv_dir[3][packet_width] = {};   // the rays' cached reciprocals
+    alignas(32) real t_max[packet_width] = {};   // closest hit found so far in each lane
+    unsigned active = 0;                          // bit k is set when lane k carries a ray
+};
+
+// An axis-aligned rectangle at orig[axis] == k, spanning [a0,a1] along axis a and
+// [b0,b1] along axis b.
+struct packet_rect {
+    int axis, a, b;
+    real k, a0, a1, b0, b1;
+};
+
+const int sphere_block_size = 8;
+
+// Sphere centers and radii as separate arrays, padded to a multiple of sphere_block_size.
+struct sphere_lanes {
+    const real* center[3];
+    const real* radius;
+};
+
+const int triangle_block_size = 4;
+
+// Triangle vertices as separate arrays, vertex[corner][axis][i], padded to a multiple
+// of triangle_block_size.
+struct triangle_lanes {
+    const real* vertex[3][3];
+};
+
+// A ray set up for the watertight triangle test of Woop, Benthin and Wald ("Watertight
+// Ray/Triangle Intersection", JCGT 2013): kz is the axis along which the direction is
+// largest, and the shear (sx, sy, sz) carries the ray onto the +z axis in the frame
+// (kx, ky, kz). Edges are then tested in 2D against the origin, so a ray through an
+// edge or vertex shared by two triangles hits at least one of them.
+struct triangle_ray {
+    int kx, ky, kz;
+    real sx, sy, sz;
+    real orig[3];
+
+    triangle_ray(const real o[3], const real d[3]) {
+        kz = std::fabs(d[0]) > std::fabs(d[1]) ? (std::fabs(d[0]) > std::fabs(d[2]) ? 0 : 2)
+                                               : (std::fabs(d[1]) > std::fabs(d[2]) ? 1 : 2);
+        kx = kz == 2 ? 0 : kz + 1;
+        ky = kx == 2 ? 0 : kx + 1;
+        if (d[kz] < 0) {
+            int swap = kx;
+            kx = ky;
+            ky = swap;
+        }
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1 / d[kz];
+        for (int a = 0; a < 3; ++a)
+            orig[a] = o[a];
+    }
+};
+
+struct packet_kernels {
+    const char* name;
+    unsigned (*sphere)(const packet_rays& p, const real center[3], real radius, real t_min);
+    unsigned (*rect)(const packet_rays& p, const packet_rect& rect, real t_min);
+    unsigned (*slab)(const packet_rays& p, const real lo[3], const real hi[3], real t_min);
+
+    // Tests one ray against spheres [first, first + sphere_block_size). Returns the mask
+    // of spheres with a root in [t_min, t_max] and stores that root (the near one when
+    // it is in range, as sphere::hit picks it) in roots.
+    unsigned (*sphere_block)(
+        const sphere_lanes& s, size_t first, const real orig[3], const real dir[3],
+        real t_min, real t_max, real* roots);
+
+    // Tests one ray against triangles [first, first + triangle_block_size). Returns the
+    // mask of triangles hit with t in [t_min, t_max] and stores t and the barycentric
+    // weights u, v of the second and third vertex of each.
+    unsigned (*triangle_block)(
+        const triangle_lanes& tris, size_t first, const triangle_ray& r,
+        real t_min, real t_max, real* t, real* u, real* v);
+};
+
+enum class packet_isa { scalar, sse2, avx2 };
+
+namespace packet_scalar {
+
+inline unsigned sphere(const packet_rays& p, const real center[3], real radius, real t_min) {
+    unsigned mask = 0;
+    for (int k = 0; k < packet_width; ++k) {
+        if (!(p.active >> k & 1))
+            continue;
+        real ox = p.orig[0][k] - center[0];
+        real oy = p.orig[1][k] - center[1];
+        real oz = p.orig[2][k] - center[2];
+        real dx = p.dir[0][k], dy = p.dir[1][k], dz = p.dir[2][k];
+
+        real a = dx * dx + dy * dy + dz * dz;
+        real half_b = ox * dx + oy * dy + oz * dz;
+        real c = (ox * ox + oy * oy + oz * oz) - radius * radius;
+        real discriminant = half_b * half_b - a * c;
+        if (discriminant < 0)
+            continue;
+
+        real sqrtd = std::sqrt(discriminant);
+        real near_root = (-half_b - sqrtd) / a;
+        real far_root = (-half_b + sqrtd) / a;
+        bool near_out = near_root < t_min || p.t_max[k] < near_root;
+        bool far_out = far_root < t_min || p.t_max[k] < far_root;
+        if (!(near_out && far_out))
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+inline unsigned rect(const packet_rays& p, const packet_rect& r, real t_min) {
+    unsigned mask = 0;
+    for (int k = 0; k < packet_width; ++k) {
+        if (!(p.active >> k & 1))
+            continue;
+        real t = (r.k - p.orig[r.axis][k]) / p.dir[r.axis][k];
+        real x = p.orig[r.a][k] + t * p.dir[r.a][k];
+        real y = p.orig[r.b][k] + t * p.dir[r.b][k];
+        if (t >= t_min && t <= p.t_max[k] && !(x < r.a0 || x > r.a1 || y < r.b0 || y > r.b1))
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+inline unsigned slab(const packet_rays& p, const real lo[3], const real hi[3], real t_min) {
+    // aabb::hit, lane by lane.
+    unsigned mask = 0;
+    for (int k = 0; k < packet_width; ++k) {
+        if (!(p.active >> k & 1))
+            continue;
+        real t0_max = t_min, t1_min = p.t_max[k];
+        for (int a = 0; a < 3; ++a) {
+            bool negative = p.inv_dir[a][k] < 0;
+            real near_t = ((negative ? hi : lo)[a] - p.orig[a][k]) * p.inv_dir[a][k];
+            real far_t = ((negative ? lo : hi)[a] - p.orig[a][k]) * p.inv_dir[a][k];
+            t0_max = near_t > t0_max ? near_t : t0_max;
+            t1_min = far_t < t1_min ? far_t : t1_min;
+        }
+        if (t0_max <= t1_min)
+            mask |= 1u << k;
+    }
+    return mask;
+}
+
+inline unsigned sphere_block(
+    const sphere_lanes& s, size_t first, const real orig[3], const real dir[3],
+    real t_min, real t_max, real* roots
+) {
+    real a = dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2];
+    unsigned mask = 0;
+    for (int k = 0; k < sphere_block_size; ++k) {
+        size_t i = first + k;
+        real ox = orig[0] - s.center[0][i];
+        real oy = orig[1] - s.center[1][i];
+        real oz = orig[2] - s.center[2][i];
+
+        real half_b = ox * dir[0] + oy * dir[1] + oz * dir[2];
+        real c = (ox * ox + oy * oy + oz * oz) - s.radius[i] * s.radius[i];
+        real discriminant = half_b * half_b - a * c;
+        if (discriminant < 0)
+            continue;
+
+        real sqrtd = std::sqrt(discriminant);
+        real root = (-half_b - sqrtd) / a;
+        if (root < t_min || t_max < root) {
+            root = (-half_b + sqrtd) / a;
+            if (root < t_min || t_max < root)
+                continue;
+        }
+        roots[k] = root;
+        mask |= 1u << k;
+    }
+    return mask;
+}
+
+inline unsigned triangle_block(
+    const triangle_lanes& tris, size_t first, const triangle_ray& r,
+    real t_min, real t_max, real* t, real* u, real* v
+) {
+    unsigned mask = 0;
+    for (int k = 0; k < triangle_block_size; ++k) {
+        size_t i = first + k;
+        // The vertices relative to the origin, sheared so that the ray runs along z.
+        real az = tris.vertex[0][r.kz][i] - r.orig[r.kz];
+        real bz = tris.vertex[1][r.kz][i] - r.orig[r.kz];
+        real cz = tris.vertex[2][r.kz][i] - r.orig[r.kz];
+        real ax = (tris.vertex[0][r.kx][i] - r.orig[r.kx]) - r.sx * az;
+        real ay = (tris.vertex[0][r.ky][i] - r.orig[r.ky]) - r.sy * az;
+        real bx = (tris.vertex[1][r.kx][i] - r.orig[r.kx]) - r.sx * bz;
+        real by = (tris.vertex[1][r.ky][i] - r.orig[r.ky]) - r.sy * bz;
+        real cx = (tris.vertex[2][r.kx][i] - r.orig[r.kx]) - r.sx * cz;
+        real cy = (tris.vertex[2][r.ky][i] - r.orig[r.ky]) - r.sy * cz;
+
+        real e0 = cx * by - cy * bx;
+        real e1 = ax * cy - ay * cx;
+        real e2 = bx * ay - by * ax;
+#ifdef RT_FLOAT32
+        // An edge function of exactly zero may just have lost its sign to rounding; the
+        // products of two floats are exact in double.
+        if (e0 == 0 || e1 == 0 || e2 == 0) {
+            e0 = static_cast<real>(double(cx) * by - double(cy) * bx);
+            e1 = static_cast<real>(double(ax) * cy - double(ay) * cx);
+            e2 = static_cast<real>(double(bx) * ay - double(by) * ax);
+        }
+#endif
+        if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+            continue;
+        real det = e0 + e1 + e2;
+        if (det == 0)
+            continue;
+
+        real scaled_t = e0 * (r.sz * az) + e1 * (r.sz * bz) + e2 * (r.sz * cz);
+        real inv_det = 1 / det;
+        real hit_t = scaled_t * inv_det;
+        if (hit_t < t_min || hit_t > t_max)
+            continue;
+        t[k] = hit_t;
+        u[k] = e1 * inv_det;
+        v[k] = e2 * inv_det;
+        mask |= 1u << k;
+    }
+    return mask;
+}
+
+} // namespace packet_scalar
+
+#ifdef PACKET_X86
+#ifndef RT_FLOAT32
+
+namespace packet_sse2 {
+
+inline unsigned sphere(const packet_rays& p, const double center[3], double radius, double t_min) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d lo = _mm_set1_pd(t_min);
+    const __m128d r2 = _mm_set1_pd(radius * radius);
+
+    unsigned mask = 0;
+    for (int h = 0; h < packet_width; h += 2) {
+        __m128d ox = _mm_sub_pd(_mm_load_pd(&p.orig[0][h]), _mm_set1_pd(center[0]));
+        __m128d oy = _mm_sub_pd(_mm_load_pd(&p.orig[1][h]), _mm_set1_pd(center[1]));
+        __m128d oz = _mm_sub_pd(_mm_load_pd(&p.orig[2][h]), _mm_set1_pd(center[2]));
+        __m128d dx = _mm_load_pd(&p.dir[0][h]);
+        __m128d dy = _mm_load_pd(&p.dir[1][h]);
+        __m128d dz = _mm_load_pd(&p.dir[2][h]);
+        __m128d hi = _mm_load_pd(&p.t_max[h]);
+
+        __m128d a = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+        __m128d half_b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ox, dx), _mm_mul_pd(oy, dy)), _mm_mul_pd(oz, dz));
+        __m128d c = _mm_sub_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(ox, ox), _mm_mul_pd(oy, oy)), _mm_mul_pd(oz, oz)), r2);
+        __m128d discriminant = _mm_sub_pd(_mm_mul_pd(half_b, half_b), _mm_mul_pd(a, c));
+
+        __m128d sqrtd = _mm_sqrt_pd(discriminant);
+        __m128d neg_b = _mm_xor_pd(half_b, sign);
+        __m128d near_root = _mm_div_pd(_mm_sub_pd(neg_b, sqrtd), a);
+        __m128d far_root = _mm_div_pd(_mm_add_pd(neg_b, sqrtd), a);
+        __m128d near_out = _mm_or_pd(_mm_cmplt_pd(near_root, lo), _mm_cmplt_pd(hi, near_root));
+        __m128d far_out = _mm_or_pd(_mm_cmplt_pd(far_root, lo), _mm_cmplt_pd(hi, far_root));
+        __m128d miss = _mm_or_pd(_mm_cmplt_pd(discriminant, zero), _mm_and_pd(near_out, far_out));
+
+        mask |= static_cast<unsigned>(~_mm_movemask_pd(miss) & 3) << h;
+    }
+    return mask & p.active;
+}
+
+inline unsigned rect(const packet_rays& p, const packet_rect& r, double t_min) {
+    const __m128d lo = _mm_set1_pd(t_min);
+
+    unsigned mask = 0;
+    for (int h = 0; h < packet_width; h += 2) {
+        __m128d hi = _mm_load_pd(&p.t_max[h]);
+        __m128d t = _mm_div_pd(
+            _mm_sub_pd(_mm_set1_pd(r.k), _mm_load_pd(&p.orig[r.axis][h])), _mm_load_pd(&p.dir[r.axis][h]));
+        __m128d x = _mm_add_pd(_mm_load_pd(&p.orig[r.a][h]), _mm_mul_pd(t, _mm_load_pd(&p.dir[r.a][h])));
+        __m128d y = _mm_add_pd(_mm_load_pd(&p.orig[r.b][h]), _mm_mul_pd(t, _mm_load_pd(&p.dir[r.b][h])));
+
+        // Unordered compares, so that a NaN t (a ray in the rectangle's plane) misses.
+        __m128d miss = _mm_or_pd(_mm_cmpnge_pd(t, lo), _mm_cmpnle_pd(t, hi));
+        miss = _mm_or_pd(miss, _mm_or_pd(_mm_cmplt_pd(x, _mm_set1_pd(r.a0)), _mm_cmpgt_pd(x, _mm_set1_pd(r.a1))));
+        miss = _mm_or_pd(miss, _mm_or_pd(_mm_cmplt_pd(y, _mm_set1_pd(r.b0)), _mm_cmpgt_pd(y, _mm_set1_pd(r.b1))));
+
+        mask |= static_cast<unsigned>(~_mm_movemask_pd(miss) & 3) << h;
+    }
+    return mask & p.active;
+}
+
+inline unsigned slab(const packet_rays& p, const double lo[3], const double hi[3], double t_min) {
+    // maxpd/minpd return their second operand unless the first is strictly beyond it,
+    // NaN included, exactly like the ?: in aabb::hit.
+    const __m128d zero = _mm_setzero_pd();
+    unsigned mask = 0;
+    for (int h = 0; h < packet_width; h += 2) {
+        __m128d t0_max = _mm_set1_pd(t_min);
+        __m128d t1_min = _mm_load_pd(&p.t_max[h]);
+        for (int a = 0; a < 3; ++a) {
+            __m128d o = _mm_load_pd(&p.orig[a][h]);
+            __m128d inv = _mm_load_pd(&p.inv_dir[a][h]);
+            __m128d negative = _mm_cmplt_pd(inv, zero);
+            __m128d bound_lo = _mm_set1_pd(lo[a]);
+            __m128d bound_hi = _mm_set1_pd(hi[a]);
+            __m128d near_bound = _mm_or_pd(_mm_and_pd(negative, bound_hi), _mm_andnot_pd(negative, bound_lo));
+            __m128d far_bound = _mm_or_pd(_mm_and_pd(negative, bound_lo), _mm_andnot_pd(negative, bound_hi));
+            t0_max = _mm_max_pd(_mm_mul_pd(_mm_sub_pd(near_bound, o), inv), t0_max);
+            t1_min = _mm_min_pd(_mm_mul_pd(_mm_sub_pd(far_bound, o), inv), t1_min);
+        }
+        mask |= static_cast<unsigned>(_mm_movemask_pd(_mm_cmple_pd(t0_max, t1_min)) & 3) << h;
+    }
+    return mask & p.active;
+}
+
+inline unsigned sphere_block(
+    const sphere_lanes& s, size_t first, const double orig[3], const double dir[3],
+    double t_min, double t_max, double* roots
+) {
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d lo = _mm_set1_pd(t_min);
+    const __m128d hi = _mm_set1_pd(t_max);
+    const __m128d dx = _mm_set1_pd(dir[0]);
+    const __m128d dy = _mm_set1_pd(dir[1]);
+    const __m128d dz = _mm_set1_pd(dir[2]);
+    const __m128d a = _mm_set1_pd(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+    unsigned mask = 0;
+    for (int h = 0; h < sphere_block_size; h += 2) {
+        size_t i = first + h;
+        __m128d ox = _mm_sub_pd(_mm_set1_pd(orig[0]), _mm_loadu_pd(s.center[0] + i));
+        __m128d oy = _mm_sub_pd(_mm_set1_pd(orig[1]), _mm_loadu_pd(s.center[1] + i));
+        __m128d oz = _mm_sub_pd(_mm_set1_pd(orig[2]), _mm_loadu_pd(s.center[2] + i));
+        __m128d r = _mm_loadu_pd(s.radius + i);
+
+        __m128d half_b = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ox, dx), _mm_mul_pd(oy, dy)), _mm_mul_pd(oz, dz));
+        __m128d c = _mm_sub_pd(
+            _mm_add_pd(_mm_add_pd(_mm_mul_pd(ox, ox), _mm_mul_pd(oy, oy)), _mm_mul_pd(oz, oz)), _mm_mul_pd(r, r));
+        __m128d discriminant = _mm_sub_pd(_mm_mul_pd(half_b, half_b), _mm_mul_pd(a, c));
+        __m128d no_root = _mm_cmplt_pd(discriminant, _mm_setzero_pd());
+        if (_mm_movemask_pd(no_root) == 3)
+            continue;   // the usual case: the ray passes both spheres, skip sqrt and divides
+
+        __m128d sqrtd = _mm_sqrt_pd(discriminant);
+        __m128d neg_b = _mm_xor_pd(half_b, sign);
+        __m128d near_root = _mm_div_pd(_mm_sub_pd(neg_b, sqrtd), a);
+        __m128d far_root = _mm_div_pd(_mm_add_pd(neg_b, sqrtd), a);
+        __m128d near_out = _mm_or_pd(_mm_cmplt_pd(near_root, lo), _mm_cmplt_pd(hi, near_root));
+        __m128d far_out = _mm_or_pd(_mm_cmplt_pd(far_root, lo), _mm_cmplt_pd(hi, far_root));
+        __m128d miss = _mm_or_pd(no_root, _mm_and_pd(near_out, far_out));
+
+        _mm_storeu_pd(roots + h, _mm_or_pd(_mm_and_pd(near_out, far_root), _mm_andnot_pd(near_out, near_root)));
+        mask |= static_cast<unsigned>(~_mm_movemask_pd(miss) & 3) << h;
+    }
+    return mask;
+}
+
+inline unsigned triangle_block(
+    const triangle_lanes& tris, size_t first, const triangle_ray& r,
+    double t_min, double t_max, double* t, double* u, double* v
+) {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d sx = _mm_set1_pd(r.sx);
+    const __m128d sy = _mm_set1_pd(r.sy);
+    const __m128d sz = _mm_set1_pd(r.sz);
+    const __m128d ox = _mm_set1_pd(r.orig[r.kx]);
+    const __m128d oy = _mm_set1_pd(r.orig[r.ky]);
+    const __m128d oz = _mm_set1_pd(r.orig[r.kz]);
+
+    unsigned mask = 0;
+    for (int h = 0; h < triangle_block_size; h += 2) {
+        size_t i = first + h;
+        __m128d az = _mm_sub_pd(_mm_loadu_pd(tris.vertex[0][r.kz] + i), oz);
+        __m128d bz = _mm_sub_pd(_mm_loadu_pd(tris.vertex[1][r.kz] + i), oz);
+        __m128d cz = _mm_sub_pd(_mm_loadu_pd(tris.vertex[2][r.kz] + i), oz);
+        __m128d ax = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[0][r.kx] + i), ox), _mm_mul_pd(sx, az));
+        __m128d ay = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[0][r.ky] + i), oy), _mm_mul_pd(sy, az));
+        __m128d bx = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[1][r.kx] + i), ox), _mm_mul_pd(sx, bz));
+        __m128d by = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[1][r.ky] + i), oy), _mm_mul_pd(sy, bz));
+        __m128d cx = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[2][r.kx] + i), ox), _mm_mul_pd(sx, cz));
+        __m128d cy = _mm_sub_pd(_mm_sub_pd(_mm_loadu_pd(tris.vertex[2][r.ky] + i), oy), _mm_mul_pd(sy, cz));
+
+        __m128d e0 = _mm_sub_pd(_mm_mul_pd(cx, by), _mm_mul_pd(cy, bx));
+        __m128d e1 = _mm_sub_pd(_mm_mul_pd(ax, cy), _mm_mul_pd(ay, cx));
+        __m128d e2 = _mm_sub_pd(_mm_mul_pd(bx, ay), _mm_mul_pd(by, ax));
+        __m128d any_negative = _mm_or_pd(_mm_or_pd(_mm_cmplt_pd(e0, zero), _mm_cmplt_pd(e1, zero)), _mm_cmplt_pd(e2, zero));
+        __m128d any_positive = _mm_or_pd(_mm_or_pd(_mm_cmpgt_pd(e0, zero), _mm_cmpgt_pd(e1, zero)), _mm_cmpgt_pd(e2, zero));
+        __m128d miss = _mm_and_pd(any_negative, any_positive);
+        if (_mm_movemask_pd(miss) == 3)
+            continue;   // the usual case: the ray passes beside both triangles
+
+        __m128d det = _mm_add_pd(_mm_add_pd(e0, e1), e2);
+        __m128d scaled_t = _mm_add_pd(_mm_add_pd(
+            _mm_mul_pd(e0, _mm_mul_pd(sz, az)), _mm_mul_pd(e1, _mm_mul_pd(sz, bz))), _mm_mul_pd(e2, _mm_mul_pd(sz, cz)));
+        __m128d inv_det = _mm_div_pd(_mm_set1_pd(1.0), det);
+        __m128d hit_t = _mm_mul_pd(scaled_t, inv_det);
+        miss = _mm_or_pd(miss, _mm_cmpeq_pd(det, zero));
+        miss = _mm_or_pd(miss, _mm_or_pd(_mm_cmplt_pd(hit_t, _mm_set1_pd(t_min)), _mm_cmpgt_pd(hit_t, _mm_set1_pd(t_max))));
+
+        _mm_storeu_pd(t + h, hit_t);
+        _mm_storeu_pd(u + h, _mm_mul_pd(e1, inv_det));
+        _mm_storeu_pd(v + h, _mm_mul_pd(e2, inv_det));
+        mask |= static_cast<unsigned>(~_mm_movemask_pd(miss) & 3) << h;
+    }
+    return mask;
+}
+
+} // namespace packet_sse2
+
+namespace packet_avx2 {
+
+PACKET_TARGET_AVX2 inline unsigned sphere(
+    const packet_rays& p, const double center[3], double radius, double t_min
+) {
+    __m256d ox = _mm256_sub_pd(_mm256_load_pd(p.orig[0]), _mm256_set1_pd(center[0]));
+    __m256d oy = _mm256_sub_pd(_mm256_load_pd(p.orig[1]), _mm256_set1_pd(center[1]));
+    __m256d oz = _mm256_sub_pd(_mm256_load_pd(p.orig[2]), _mm256_set1_pd(center[2]));
+    __m256d dx = _mm256_load_pd(p.dir[0]);
+    __m256d dy = _mm256_load_pd(p.dir[1]);
+    __m256d dz = _mm256_load_pd(p.dir[2]);
+    __m256d lo = _mm256_set1_pd(t_min);
+    __m256d hi = _mm256_load_pd(p.t_max);
+
+    __m256d a = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+    __m256d half_b = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ox, dx), _mm256_mul_pd(oy, dy)), _mm256_mul_pd(oz, dz));
+    __m256d c = _mm256_sub_pd(
+        _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ox, ox), _mm256_mul_pd(oy, oy)), _mm256_mul_pd(oz, oz)),
+        _mm256_set1_pd(radius * radius));
+    __m256d discriminant = _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(a, c));
+
+    __m256d sqrtd = _mm256_sqrt_pd(discriminant);
+    __m256d neg_b = _mm256_xor_pd(half_b, _mm256_set1_pd(-0.0));
+    __m256d near_root = _mm256_div_pd(_mm256_sub_pd(neg_b, sqrtd), a);
+    __m256d far_root = _mm256_div_pd(_mm256_add_pd(neg_b, sqrtd), a);
+    __m256d near_out = _mm256_or_pd(_mm256_cmp_pd(near_root, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, near_root, _CMP_LT_OQ));
+    __m256d far_out = _mm256_or_pd(_mm256_cmp_pd(far_root, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, far_root, _CMP_LT_OQ));
+    __m256d miss = _mm256_or_pd(
+        _mm256_cmp_pd(discriminant, _mm256_setzero_pd(), _CMP_LT_OQ), _mm256_and_pd(near_out, far_out));
+
+    return static_cast<unsigned>(~_mm256_movemask_pd(miss)) & p.active;
+}
+
+PACKET_TARGET_AVX2 inline unsigned rect(const packet_rays& p, const packet_rect& r, double t_min) {
+    __m256d hi = _mm256_load_pd(p.t_max);
+    __m256d t = _mm256_div_pd(
+        _mm256_sub_pd(_mm256_set1_pd(r.k), _mm256_load_pd(p.orig[r.axis])), _mm256_load_pd(p.dir[r.axis]));
+    __m256d x = _mm256_add_pd(_mm256_load_pd(p.orig[r.a]), _mm256_mul_pd(t, _mm256_load_pd(p.dir[r.a])));
+    __m256d y = _mm256_add_pd(_mm256_load_pd(p.orig[r.b]), _mm256_mul_pd(t, _mm256_load_pd(p.dir[r.b])));
+
+    __m256d miss = _mm256_or_pd(_mm256_cmp_pd(t, _mm256_set1_pd(t_min), _CMP_NGE_UQ), _mm256_cmp_pd(t, hi, _CMP_NLE_UQ));
+    miss = _mm256_or_pd(miss, _mm256_or_pd(
+        _mm256_cmp_pd(x, _mm256_set1_pd(r.a0), _CMP_LT_OQ), _mm256_cmp_pd(x, _mm256_set1_pd(r.a1), _CMP_GT_OQ)));
+    miss = _mm256_or_pd(miss, _mm256_or_pd(
+        _mm256_cmp_pd(y, _mm256_set1_pd(r.b0), _CMP_LT_OQ), _mm256_cmp_pd(y, _mm256_set1_pd(r.b1), _CMP_GT_OQ)));
+
+    return static_cast<unsigned>(~_mm256_movemask_pd(miss)) & p.active;
+}
+
+PACKET_TARGET_AVX2 inline unsigned slab(const packet_rays& p, const double lo[3], const double hi[3], double t_min) {
+    __m256d t0_max = _mm256_set1_pd(t_min);
+    __m256d t1_min = _mm256_load_pd(p.t_max);
+    for (int a = 0; a < 3; ++a) {
+        __m256d o = _mm256_load_pd(p.orig[a]);
+        __m256d inv = _mm256_load_pd(p.inv_dir[a]);
+        __m256d negative = _mm256_cmp_pd(inv, _mm256_setzero_pd(), _CMP_LT_OQ);
+        __m256d bound_lo = _mm256_set1_pd(lo[a]);
+        __m256d bound_hi = _mm256_set1_pd(hi[a]);
+        __m256d near_bound = _mm256_blendv_pd(bound_lo, bound_hi, negative);
+        __m256d far_bound = _mm256_blendv_pd(bound_hi, bound_lo, negative);
+        t0_max = _mm256_max_pd(_mm256_mul_pd(_mm256_sub_pd(near_bound, o), inv), t0_max);
+        t1_min = _mm256_min_pd(_mm256_mul_pd(_mm256_sub_pd(far_bound, o), inv), t1_min);
+    }
+    return static_cast<unsigned>(_mm256_movemask_pd(_mm256_cmp_pd(t0_max, t1_min, _CMP_LE_OQ))) & p.active;
+}
+
+PACKET_TARGET_AVX2 inline unsigned sphere_block(
+    const sphere_lanes& s, size_t first, const double orig[3], const double dir[3],
+    double t_min, double t_max, double* roots
+) {
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d lo = _mm256_set1_pd(t_min);
+    const __m256d hi = _mm256_set1_pd(t_max);
+    const __m256d dx = _mm256_set1_pd(dir[0]);
+    const __m256d dy = _mm256_set1_pd(dir[1]);
+    const __m256d dz = _mm256_set1_pd(dir[2]);
+    const __m256d a = _mm256_set1_pd(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+    unsigned mask = 0;
+    for (int h = 0; h < sphere_block_size; h += 4) {
+        size_t i = first + h;
+        __m256d ox = _mm256_sub_pd(_mm256_set1_pd(orig[0]), _mm256_loadu_pd(s.center[0] + i));
+        __m256d oy = _mm256_sub_pd(_mm256_set1_pd(orig[1]), _mm256_loadu_pd(s.center[1] + i));
+        __m256d oz = _mm256_sub_pd(_mm256_set1_pd(orig[2]), _mm256_loadu_pd(s.center[2] + i));
+        __m256d r = _mm256_loadu_pd(s.radius + i);
+
+        __m256d half_b = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ox, dx), _mm256_mul_pd(oy, dy)), _mm256_mul_pd(oz, dz));
+        __m256d c = _mm256_sub_pd(
+            _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ox, ox), _mm256_mul_pd(oy, oy)), _mm256_mul_pd(oz, oz)),
+            _mm256_mul_pd(r, r));
+        __m256d discriminant = _mm256_sub_pd(_mm256_mul_pd(half_b, half_b), _mm256_mul_pd(a, c));
+        __m256d no_root = _mm256_cmp_pd(discriminant, _mm256_setzero_pd(), _CMP_LT_OQ);
+        if (_mm256_movemask_pd(no_root) == 15)
+            continue;
+
+        __m256d sqrtd = _mm256_sqrt_pd(discriminant);
+        __m256d neg_b = _mm256_xor_pd(half_b, sign);
+        __m256d near_root = _mm256_div_pd(_mm256_sub_pd(neg_b, sqrtd), a);
+        __m256d far_root = _mm256_div_pd(_mm256_add_pd(neg_b, sqrtd), a);
+        __m256d near_out = _mm256_or_pd(_mm256_cmp_pd(near_root, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, near_root, _CMP_LT_OQ));
+        __m256d far_out = _mm256_or_pd(_mm256_cmp_pd(far_root, lo, _CMP_LT_OQ), _mm256_cmp_pd(hi, far_root, _CMP_LT_OQ));
+        __m256d miss = _mm256_or_pd(no_root, _mm256_and_pd(near_out, far_out));
+
+        _mm256_storeu_pd(roots + h, _mm256_blendv_pd(near_root, far_root, near_out));
+        mask |= static_cast<unsigned>(~_mm256_movemask_pd(miss) & 15) << h;
+    }
+    return mask;
+}
+
+PACKET_TARGET_AVX2 inline unsigned triangle_block(
+    const triangle_lanes& tris, size_t first, const triangle_ray& r,
+    double t_min, double t_max, double* t, double* u, double* v
+) {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d sx = _mm256_set1_pd(r.sx);
+    const __m256d sy = _mm256_set1_pd(r.sy);
+    const __m256d sz = _mm256_set1_pd(r.sz);
+    const __m256d ox = _mm256_set1_pd(r.orig[r.kx]);
+    const __m256d oy = _mm256_set1_pd(r.orig[r.ky]);
+    const __m256d oz = _mm256_set1_pd(r.orig[r.kz]);
+
+    __m256d az = _mm256_sub_pd(_mm256_loadu_pd(tris.vertex[0][r.kz] + first), oz);
+    __m256d bz = _mm256_sub_pd(_mm256_loadu_pd(tris.vertex[1][r.kz] + first), oz);
+    __m256d cz = _mm256_sub_pd(_mm256_loadu_pd(tris.vertex[2][r.kz] + first), oz);
+    __m256d ax = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[0][r.kx] + first), ox), _mm256_mul_pd(sx, az));
+    __m256d ay = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[0][r.ky] + first), oy), _mm256_mul_pd(sy, az));
+    __m256d bx = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[1][r.kx] + first), ox), _mm256_mul_pd(sx, bz));
+    __m256d by = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[1][r.ky] + first), oy), _mm256_mul_pd(sy, bz));
+    __m256d cx = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[2][r.kx] + first), ox), _mm256_mul_pd(sx, cz));
+    __m256d cy = _mm256_sub_pd(_mm256_sub_pd(_mm256_loadu_pd(tris.vertex[2][r.ky] + first), oy), _mm256_mul_pd(sy, cz));
+
+    __m256d e0 = _mm256_sub_pd(_mm256_mul_pd(cx, by), _mm256_mul_pd(cy, bx));
+    __m256d e1 = _mm256_sub_pd(_mm256_mul_pd(ax, cy), _mm256_mul_pd(ay, cx));
+    __m256d e2 = _mm256_sub_pd(_mm256_mul_pd(bx, ay), _mm256_mul_pd(by, ax));
+    __m256d any_negative = _mm256_or_pd(_mm256_or_pd(
+        _mm256_cmp_pd(e0, zero, _CMP_LT_OQ), _mm256_cmp_pd(e1, zero, _CMP_LT_OQ)), _mm256_cmp_pd(e2, zero, _CMP_LT_OQ));
+    __m256d any_positive = _mm256_or_pd(_mm256_or_pd(
+        _mm256_cmp_pd(e0, zero, _CMP_GT_OQ), _mm256_cmp_pd(e1, zero, _CMP_GT_OQ)), _mm256_cmp_pd(e2, zero, _CMP_GT_OQ));
+    __m256d miss = _mm256_and_pd(any_negative, any_positive);
+    if (_mm256_movemask_pd(miss) == 15)
+        return 0;
+
+    __m256d det = _mm256_add_pd(_mm256_add_pd(e0, e1), e2);
+    __m256d scaled_t = _mm256_add_pd(_mm256_add_pd(
+        _mm256_mul_pd(e0, _mm256_mul_pd(sz, az)), _mm256_mul_pd(e1, _mm256_mul_pd(sz, bz))), _mm256_mul_pd(e2, _mm256_mul_pd(sz, cz)));
+    __m256d inv_det = _mm256_div_pd(_mm256_set1_pd(1.0), det);
+    __m256d hit_t = _mm256_mul_pd(scaled_t, inv_det);
+    miss = _mm256_or_pd(miss, _mm256_cmp_pd(det, zero, _CMP_EQ_OQ));
+    miss = _mm256_or_pd(miss, _mm256_or_pd(
+        _mm256_cmp_pd(hit_t, _mm256_set1_pd(t_min), _CMP_LT_OQ), _mm256_cmp_pd(hit_t, _mm256_set1_pd(t_max), _CMP_GT_OQ)));
+
+    _mm256_storeu_pd(t, hit_t);
+    _mm256_storeu_pd(u, _mm256_mul_pd(e1, inv_det));
+    _mm256_storeu_pd(v, _mm256_mul_pd(e2, inv_det));
+    return static_cast<unsigned>(~_mm256_movemask_pd(miss)) & 15;
+}
+
+} // namespace packet_avx2
+
+#else // RT_FLOAT32
+
+namespace packet_sse2 {
+
+inline unsigned sphere(const packet_rays& p, const real center[3], real radius, real t_min) {
+    __m128 ox = _mm_sub_ps(_mm_load_ps(p.orig[0]), _mm_set1_ps(center[0]));
+    __m128 oy = _mm_sub_ps(_mm_load_ps(p.orig[1]), _mm_set1_ps(center[1]));
+    __m128 oz = _mm_sub_ps(_mm_load_ps(p.orig[2]), _mm_set1_ps(center[2]));
+    __m128 dx = _mm_load_ps(p.dir[0]);
+    __m128 dy = _mm_load_ps(p.dir[1]);
+    __m128 dz = _mm_load_ps(p.dir[2]);
+    __m128 lo = _mm_set1_ps(t_min);
+    __m128 hi = _mm_load_ps(p.t_max);
+
+    __m128 a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, dx), _mm_mul_ps(oy, dy)), _mm_mul_ps(oz, dz));
+    __m128 c = _mm_sub_ps(
+        _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)),
+        _mm_set1_ps(radius * radius));
+    __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+
+    __m128 sqrtd = _mm_sqrt_ps(discriminant);
+    __m128 neg_b = _mm_xor_ps(half_b, _mm_set1_ps(-0.0f));
+    __m128 near_root = _mm_div_ps(_mm_sub_ps(neg_b, sqrtd), a);
+    __m128 far_root = _mm_div_ps(_mm_add_ps(neg_b, sqrtd), a);
+    __m128 near_out = _mm_or_ps(_mm_cmplt_ps(near_root, lo), _mm_cmplt_ps(hi, near_root));
+    __m128 far_out = _mm_or_ps(_mm_cmplt_ps(far_root, lo), _mm_cmplt_ps(hi, far_root));
+    __m128 miss = _mm_or_ps(_mm_cmplt_ps(discriminant, _mm_setzero_ps()), _mm_and_ps(near_out, far_out));
+
+    return static_cast<unsigned>(~_mm_movemask_ps(miss)) & p.active;
+}
+
+inline unsigned rect(const packet_rays& p, const packet_rect& r, real t_min) {
+    __m128 hi = _mm_load_ps(p.t_max);
+    __m128 t = _mm_div_ps(_mm_sub_ps(_mm_set1_ps(r.k), _mm_load_ps(p.orig[r.axis])), _mm_load_ps(p.dir[r.axis]));
+    __m128 x = _mm_add_ps(_mm_load_ps(p.orig[r.a]), _mm_mul_ps(t, _mm_load_ps(p.dir[r.a])));
+    __m128 y = _mm_add_ps(_mm_load_ps(p.orig[r.b]), _mm_mul_ps(t, _mm_load_ps(p.dir[r.b])));
+
+    __m128 miss = _mm_or_ps(_mm_cmpnge_ps(t, _mm_set1_ps(t_min)), _mm_cmpnle_ps(t, hi));
+    miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(x, _mm_set1_ps(r.a0)), _mm_cmpgt_ps(x, _mm_set1_ps(r.a1))));
+    miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(y, _mm_set1_ps(r.b0)), _mm_cmpgt_ps(y, _mm_set1_ps(r.b1))));
+
+    return static_cast<unsigned>(~_mm_movemask_ps(miss)) & p.active;
+}
+
+inline unsigned slab(const packet_rays& p, const real lo[3], const real hi[3], real t_min) {
+    // maxps/minps return their second operand unless the first is strictly beyond it,
+    // NaN included, exactly like the ?: in aabb::hit.
+    const __m128 zero = _mm_setzero_ps();
+    __m128 t0_max = _mm_set1_ps(t_min);
+    __m128 t1_min = _mm_load_ps(p.t_max);
+    for (int a = 0; a < 3; ++a) {
+        __m128 o = _mm_load_ps(p.orig[a]);
+        __m128 inv = _mm_load_ps(p.inv_dir[a]);
+        __m128 negative = _mm_cmplt_ps(inv, zero);
+        __m128 bound_lo = _mm_set1_ps(lo[a]);
+        __m128 bound_hi = _mm_set1_ps(hi[a]);
+        __m128 near_bound = _mm_or_ps(_mm_and_ps(negative, bound_hi), _mm_andnot_ps(negative, bound_lo));
+        __m128 far_bound = _mm_or_ps(_mm_and_ps(negative, bound_lo), _mm_andnot_ps(negative, bound_hi));
+        t0_max = _mm_max_ps(_mm_mul_ps(_mm_sub_ps(near_bound, o), inv), t0_max);
+        t1_min = _mm_min_ps(_mm_mul_ps(_mm_sub_ps(far_bound, o), inv), t1_min);
+    }
+    return static_cast<unsigned>(_mm_movemask_ps(_mm_cmple_ps(t0_max, t1_min))) & p.active;
+}
+
+inline unsigned sphere_block(
+    const sphere_lanes& s, size_t first, const real orig[3], const real dir[3],
+    real t_min, real t_max, real* roots
+) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 lo = _mm_set1_ps(t_min);
+    const __m128 hi = _mm_set1_ps(t_max);
+    const __m128 dx = _mm_set1_ps(dir[0]);
+    const __m128 dy = _mm_set1_ps(dir[1]);
+    const __m128 dz = _mm_set1_ps(dir[2]);
+    const __m128 a = _mm_set1_ps(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+    unsigned mask = 0;
+    for (int h = 0; h < sphere_block_size; h += 4) {
+        size_t i = first + h;
+        __m128 ox = _mm_sub_ps(_mm_set1_ps(orig[0]), _mm_loadu_ps(s.center[0] + i));
+        __m128 oy = _mm_sub_ps(_mm_set1_ps(orig[1]), _mm_loadu_ps(s.center[1] + i));
+        __m128 oz = _mm_sub_ps(_mm_set1_ps(orig[2]), _mm_loadu_ps(s.center[2] + i));
+        __m128 r = _mm_loadu_ps(s.radius + i);
+
+        __m128 half_b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, dx), _mm_mul_ps(oy, dy)), _mm_mul_ps(oz, dz));
+        __m128 c = _mm_sub_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)), _mm_mul_ps(r, r));
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(half_b, half_b), _mm_mul_ps(a, c));
+        __m128 no_root = _mm_cmplt_ps(discriminant, _mm_setzero_ps());
+        if (_mm_movemask_ps(no_root) == 15)
+            continue;
+
+        __m128 sqrtd = _mm_sqrt_ps(discriminant);
+        __m128 neg_b = _mm_xor_ps(half_b, sign);
+        __m128 near_root = _mm_div_ps(_mm_sub_ps(neg_b, sqrtd), a);
+        __m128 far_root = _mm_div_ps(_mm_add_ps(neg_b, sqrtd), a);
+        __m128 near_out = _mm_or_ps(_mm_cmplt_ps(near_root, lo), _mm_cmplt_ps(hi, near_root));
+        __m128 far_out = _mm_or_ps(_mm_cmplt_ps(far_root, lo), _mm_cmplt_ps(hi, far_root));
+        __m128 miss = _mm_or_ps(no_root, _mm_and_ps(near_out, far_out));
+
+        _mm_storeu_ps(roots + h, _mm_or_ps(_mm_and_ps(near_out, far_root), _mm_andnot_ps(near_out, near_root)));
+        mask |= static_cast<unsigned>(~_mm_movemask_ps(miss) & 15) << h;
+    }
+    return mask;
+}
+
+inline unsigned triangle_block(
+    const triangle_lanes& tris, size_t first, const triangle_ray& r,
+    real t_min, real t_max, real* t, real* u, real* v
+) {
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sx = _mm_set1_ps(r.sx);
+    const __m128 sy = _mm_set1_ps(r.sy);
+    const __m128 sz = _mm_set1_ps(r.sz);
+    const __m128 ox = _mm_set1_ps(r.orig[r.kx]);
+    const __m128 oy = _mm_set1_ps(r.orig[r.ky]);
+    const __m128 oz = _mm_set1_ps(r.orig[r.kz]);
+
+    __m128 az = _mm_sub_ps(_mm_loadu_ps(tris.vertex[0][r.kz] + first), oz);
+    __m128 bz = _mm_sub_ps(_mm_loadu_ps(tris.vertex[1][r.kz] + first), oz);
+    __m128 cz = _mm_sub_ps(_mm_loadu_ps(tris.vertex[2][r.kz] + first), oz);
+    __m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[0][r.kx] + first), ox), _mm_mul_ps(sx, az));
+    __m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[0][r.ky] + first), oy), _mm_mul_ps(sy, az));
+    __m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[1][r.kx] + first), ox), _mm_mul_ps(sx, bz));
+    __m128 by = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[1][r.ky] + first), oy), _mm_mul_ps(sy, bz));
+    __m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[2][r.kx] + first), ox), _mm_mul_ps(sx, cz));
+    __m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(tris.vertex[2][r.ky] + first), oy), _mm_mul_ps(sy, cz));
+
+    __m128 e0 = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+    __m128 e1 = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+    __m128 e2 = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+    __m128 on_edge = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(e0, zero), _mm_cmpeq_ps(e1, zero)), _mm_cmpeq_ps(e2, zero));
+    if (_mm_movemask_ps(on_edge))
+        return packet_scalar::triangle_block(tris, first, r, t_min, t_max, t, u, v);   // redone in double
+
+    __m128 any_negative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(e0, zero), _mm_cmplt_ps(e1, zero)), _mm_cmplt_ps(e2, zero));
+    __m128 any_positive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(e0, zero), _mm_cmpgt_ps(e1, zero)), _mm_cmpgt_ps(e2, zero));
+    __m128 miss = _mm_and_ps(any_negative, any_positive);
+    if (_mm_movemask_ps(miss) == 15)
+        return 0;
+
+    __m128 det = _mm_add_ps(_mm_add_ps(e0, e1), e2);
+    __m128 scaled_t = _mm_add_ps(_mm_add_ps(
+        _mm_mul_ps(e0, _mm_mul_ps(sz, az)), _mm_mul_ps(e1, _mm_mul_ps(sz, bz))), _mm_mul_ps(e2, _mm_mul_ps(sz, cz)));
+    __m128 inv_det = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    __m128 hit_t = _mm_mul_ps(scaled_t, inv_det);
+    miss = _mm_or_ps(miss, _mm_cmpeq_ps(det, zero));
+    miss = _mm_or_ps(miss, _mm_or_ps(_mm_cmplt_ps(hit_t, _mm_set1_ps(t_min)), _mm_cmpgt_ps(hit_t, _mm_set1_ps(t_max))));
+
+    _mm_storeu_ps(t, hit_t);
+    _mm_storeu_ps(u, _mm_mul_ps(e1, inv_det));
+    _mm_storeu_ps(v, _mm_mul_ps(e2, inv_det));
+    return static_cast<unsigned>(~_mm_movemask_ps(miss)) & 15;
+}
+
+} // namespace packet_sse2
+
+namespace packet_avx2 {
+
+// A packet is one SSE register already.
+using packet_sse2::sphere;
+using packet_sse2::rect;
+using packet_sse2::slab;
+using packet_sse2::triangle_block;
+
+PACKET_TARGET_AVX2 inline unsigned sphere_block(
+    const sphere_lanes& s, size_t first, const real orig[3], const real dir[3],
+    real t_min, real t_max, real* roots
+) {
+    const __m256 lo = _mm256_set1_ps(t_min);
+    const __m256 hi = _mm256_set1_ps(t_max);
+    const __m256 a = _mm256_set1_ps(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+
+    __m256 ox = _mm256_sub_ps(_mm256_set1_ps(orig[0]), _mm256_loadu_ps(s.center[0] + first));
+    __m256 oy = _mm256_sub_ps(_mm256_set1_ps(orig[1]), _mm256_loadu_ps(s.center[1] + first));
+    __m256 oz = _mm256_sub_ps(_mm256_set1_ps(orig[2]), _mm256_loadu_ps(s.center[2] + first));
+    __m256 r = _mm256_loadu_ps(s.radius + first);
+
+    __m256 half_b = _mm256_add_ps(_mm256_add_ps(
+        _mm256_mul_ps(ox, _mm256_set1_ps(dir[0])), _mm256_mul_ps(oy, _mm256_set1_ps(dir[1]))),
+        _mm256_mul_ps(oz, _mm256_set1_ps(dir[2])));
+    __m256 c = _mm256_sub_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy)), _mm256_mul_ps(oz, oz)),
+        _mm256_mul_ps(r, r));
+    __m256 discriminant = _mm256_sub_ps(_mm256_mul_ps(half_b, half_b), _mm256_mul_ps(a, c));
+    __m256 no_root = _mm256_cmp_ps(discriminant, _mm256_setzero_ps(), _CMP_LT_OQ);
+    if (_mm256_movemask_ps(no_root) == 255)
+        return 0;
+
+    __m256 sqrtd = _mm256_sqrt_ps(discriminant);
+    __m256 neg_b = _mm256_xor_ps(half_b, _mm256_set1_ps(-0.0f));
+    __m256 near_root = _mm256_div_ps(_mm256_sub_ps(neg_b, sqrtd), a);
+    __m256 far_root = _mm256_div_ps(_mm256_add_ps(neg_b, sqrtd), a);
+    __m256 near_out = _mm256_or_ps(_mm256_cmp_ps(near_root, lo, _CMP_LT_OQ), _mm256_cmp_ps(hi, near_root, _CMP_LT_OQ));
+    __m256 far_out = _mm256_or_ps(_mm256_cmp_ps(far_root, lo, _CMP_LT_OQ), _mm256_cmp_ps(hi, far_root, _CMP_LT_OQ));
+    __m256 miss = _mm256_or_ps(no_root, _mm256_and_ps(near_out, far_out));
+
+    _mm256_storeu_ps(roots, _mm256_blendv_ps(near_root, far_root, near_out));
+    return static_cast<unsigned>(~_mm256_movemask_ps(miss)) & 255;
+}
+
+} // namespace packet_avx2
+
+#endif // RT_FLOAT32
+#endif // PACKET_X86
+
+inline bool packet_isa_supported(packet_isa isa) {
+    switch (isa) {
+    case packet_isa::scalar:
+        return true;
+#ifdef PACKET_X86
+    case packet_isa::sse2:
+        return true;
+    case packet_isa::avx2: {
+#ifdef _MSC_VER
+        // AVX2 needs both the instructions (CPUID leaf 7) and the OS saving the
+        // 256-bit registers on context switches (OSXSAVE + XCR0).
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        if (!(info[2] & (1 << 27)) || !(info[2] & (1 << 28)) || (_xgetbv(0) & 6) != 6)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+// Kernels for the requested instruction set, or for the best supported one below it.
+inline const packet_kernels& packet_kernels_for(packet_isa isa) {
+    static const packet_kernels scalar = {
+        "scalar", packet_scalar::sphere, packet_scalar::rect, packet_scalar::slab, packet_scalar::sphere_block,
+        packet_scalar::triangle_block };
+#ifdef PACKET_X86
+    static const packet_kernels sse2 = {
+        "sse2", packet_sse2::sphere, packet_sse2::rect, packet_sse2::slab, packet_sse2::sphere_block,
+        packet_sse2::triangle_block };
+    static const packet_kernels avx2 = {
+        "avx2", packet_avx2::sphere, packet_avx2::rect, packet_avx2::slab, packet_avx2::sphere_block,
+        packet_avx2::triangle_block };
+
+    if (isa == packet_isa::avx2 && packet_isa_supported(packet_isa::avx2))
+        return avx2;
+    if (isa != packet_isa::scalar)
+        return sse2;
+#endif
+    return scalar;
+}
+
+inline const packet_kernels*& packet_kernels_slot() {
+    static const packet_kernels* current = &packet_kernels_for(packet_isa::avx2);
+    return current;
+}
+
+// Kernels used by hit_packet(). Defaults to the widest instruction set the CPU runs.
+inline const packet_kernels& packet_simd() {
+    return *packet_kernels_slot();
+}
+
+inline void use_packet_isa(packet_isa isa) {
+    packet_kernels_slot() = &packet_kernels_for(isa);
+}
+
+#endif
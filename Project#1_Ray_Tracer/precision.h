@@ -0,0 +1,36 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+// Scalar type of the tracing core: vectors, rays, bounding boxes, hit records, cameras,
+// primitives and the packet kernels. Define RT_FLOAT32 to build all of them in single
+// precision. Colors and the accumulation buffer stay in double either way.
+#ifdef RT_FLOAT32
+using real = float;
+#else
+using real = double;
+#endif
+
+template <typename T>
+struct precision_traits;
+
+template <>
+struct precision_traits<double> {
+    // The fixed self-intersection epsilon from the book. Scattered rays start exactly
+    // on the surface and skip every hit closer than this.
+    static constexpr double ray_t_min = 0.001;
+    static constexpr bool offset_origins = false;
+};
+
+template <>
+struct precision_traits<float> {
+    // Too coarse for a fixed epsilon: 0.001 is over a thousand ulps near 1 but less than
+    // one ulp past 8192. Each shape bounds the rounding error of its hit points instead
+    // and scattered rays start just past that bound (hit_record::spawn_ray), so any hit
+    // in front of the origin counts.
+    static constexpr float ray_t_min = 0.0f;
+    static constexpr bool offset_origins = true;
+};
+
+const real ray_t_min = precision_traits<real>::ray_t_min;
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef PRIMITIVE_H
+#define PRIMITIVE_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "sphere.h"
+#include "aarect.h"
+#include "box.h"
+
+#include <cstdint>
+#include <vector>
+
+// A closed set of primitive types stored by value, so a list of them is one contiguous
+// array and intersection is a switch instead of a virtual call per object. Anything
+// outside this set still goes through the virtual hittable interface.
+enum class primitive_type : uint8_t { sphere, xy_rect, xz_rect, yz_rect, box, triangle };
+
+struct sphere_shape { real center[3]; real radius; };
+struct rect_shape { real a0, a1, b0, b1, k; };      // same fields as the matching aarect
+struct box_shape { real min[3]; real max[3]; };
+struct triangle_shape { real v0[3]; real e1[3]; real e2[3]; };  // v0 and two edges
+
+struct primitive {
+    primitive_type type;
+    uint32_t mat_id;   // index into the scene's material_table
+    union {
+        sphere_shape sphere;
+        rect_shape rect;
+        box_shape box;
+        triangle_shape triangle;
+    } shape;
+
+    static primitive make_sphere(const point3& center, real radius, uint32_t mat);
+    static primitive make_rect(primitive_type type, real a0, real a1, real b0, real b1, real k, uint32_t mat);
+    static primitive make_box(const point3& p0, const point3& p1, uint32_t mat);
+    static primitive make_triangle(const point3& a, const point3& b, const point3& c, uint32_t mat);
+
+    // Copies a sphere, aarect or box together with its material ID. Returns false for
+    // any other hittable.
+    static bool from(const hittable& object, primitive& out);
+};
+
+inline point3 to_point(const real v[3]) {
+    return point3(v[0], v[1], v[2]);
+}
+
+inline void store_point(const vec3& v, real out[3]) {
+    out[0] = v.x();
+    out[1] = v.y();
+    out[2] = v.z();
+}
+
+primitive primitive::make_sphere(const point3& center, real radius, uint32_t mat) {
+    primitive p;
+    p.type = primitive_type::sphere;
+    p.mat_id = mat;
+    store_point(center, p.shape.sphere.center);
+    p.shape.sphere.radius = radius;
+    return p;
+}
+
+primitive primitive::make_rect(primitive_type type, real a0, real a1, real b0, real b1, real k, uint32_t mat) {
+    primitive p;
+    p.type = type;
+    p.mat_id = mat;
+    p.shape.rect = { a0, a1, b0, b1, k };
+    return p;
+}
+
+primitive primitive::make_box(const point3& p0, const point3& p1, uint32_t mat) {
+    primitive p;
+    p.type = primitive_type::box;
+    p.mat_id = mat;
+    store_point(p0, p.shape.box.min);
+    store_point(p1, p.shape.box.max);
+    return p;
+}
+
+primitive primitive::make_triangle(const point3& a, const point3& b, const point3& c, uint32_t mat) {
+    primitive p;
+    p.type = primitive_type::triangle;
+    p.mat_id = mat;
+    store_point(a, p.shape.triangle.v0);
+    store_point(b - a, p.shape.triangle.e1);
+    store_point(c - a, p.shape.triangle.e2);
+    return p;
+}
+
+bool primitive::from(const hittable& object, primitive& out) {
+    if (auto s = dynamic_cast<const ::sphere*>(&object))
+        out = make_sphere(s->center, s->radius, s->mat_id);
+    else if (auto r = dynamic_cast<const xy_rect*>(&object))
+        out = make_rect(primitive_type::xy_rect, r->x0, r->x1, r->y0, r->y1, r->k, r->mat_id);
+    else if (auto r = dynamic_cast<const xz_rect*>(&object))
+        out = make_rect(primitive_type::xz_rect, r->x0, r->x1, r->z0, r->z1, r->k, r->mat_id);
+    else if (auto r = dynamic_cast<const yz_rect*>(&object))
+        out = make_rect(primitive_type::yz_rect, r->y0, r->y1, r->z0, r->z1, r->k, r->mat_id);
+    else if (auto b = dynamic_cast<const ::box*>(&object))
+        out = make_box(b->box_min, b->box_max, b->mat_id);
+    else
+        return false;
+    return true;
+}
+
+// Moller-Trumbore; u and v are the barycentric coordinates of the hit.
+inline bool intersect_triangle(const triangle_shape& tri, const ray& r, real t_min, real t_max, hit_record& rec) {
+    count_stat(stat_counter::triangle_tests);
+    vec3 e1 = to_point(tri.e1);
+    vec3 e2 = to_point(tri.e2);
+    vec3 pvec = cross(r.direction(), e2);
+    real det = dot(e1, pvec);
+    if (fabs(det) < 1e-12)
+        return false;
+
+    real inv_det = 1.0 / det;
+    vec3 tvec = r.origin() - to_point(tri.v0);
+    real u = dot(tvec, pvec) * inv_det;
+    if (u < 0 || u > 1)
+        return false;
+
+    vec3 qvec = cross(tvec, e1);
+    real v = dot(r.direction(), qvec) * inv_det;
+    if (v < 0 || u + v > 1)
+        return false;
+
+    real t = dot(e2, qvec) * inv_det;
+    if (t < t_min || t > t_max)
+        return false;
+
+    rec.u = u;
+    rec.v = v;
+    rec.uv_scale = std::sqrt(std::fmin(e1.length_squared(), e2.length_squared()));
+    rec.t = t;
+    rec.p = r.at(t);
+    if (precision_traits<real>::offset_origins) {
+        // Interpolated from the vertices, p does not inherit the error of t.
+        rec.p = to_point(tri.v0) + u * e1 + v * e2;
+    }
+    rec.p_error = rounding_error<real>(5) * (max_abs(to_point(tri.v0)) + max_abs(u * e1) + max_abs(v * e2));
+    rec.set_face_normal(r, unit_vector(cross(e1, e2)));
+    return true;
+}
+
+// Geometry-only intersection; the caller fills in the material ID.
+inline bool intersect_primitive(const primitive& p, const ray& r, real t_min, real t_max, hit_record& rec) {
+    const auto& s = p.shape;
+    switch (p.type) {
+    case primitive_type::sphere:
+        return sphere::intersect(to_point(s.sphere.center), s.sphere.radius, r, t_min, t_max, rec);
+    case primitive_type::xy_rect:
+        return xy_rect::intersect(s.rect.a0, s.rect.a1, s.rect.b0, s.rect.b1, s.rect.k, r, t_min, t_max, rec);
+    case primitive_type::xz_rect:
+        return xz_rect::intersect(s.rect.a0, s.rect.a1, s.rect.b0, s.rect.b1, s.rect.k, r, t_min, t_max, rec);
+    case primitive_type::yz_rect:
+        return yz_rect::intersect(s.rect.a0, s.rect.a1, s.rect.b0, s.rect.b1, s.rect.k, r, t_min, t_max, rec);
+    case primitive_type::box:
+        return box::intersect(s.box.min, s.box.max, r, t_min, t_max, rec);
+    case primitive_type::triangle:
+        return intersect_triangle(s.triangle, r, t_min, t_max, rec);
+    }
+    return false;
+}
+
+inline aabb primitive_bounds(const primitive& p) {
+    const auto& s = p.shape;
+    switch (p.type) {
+    case primitive_type::sphere: {
+        vec3 extent(s.sphere.radius, s.sphere.radius, s.sphere.radius);
+        return aabb(to_point(s.sphere.center) - extent, to_point(s.sphere.center) + extent);
+    }
+    // Rects are padded like the aarect bounding boxes.
+    case primitive_type::xy_rect:
+        return aabb(point3(s.rect.a0, s.rect.b0, s.rect.k - 0.0001), point3(s.rect.a1, s.rect.b1, s.rect.k + 0.0001));
+    case primitive_type::xz_rect:
+        return aabb(point3(s.rect.a0, s.rect.k - 0.0001, s.rect.b0), point3(s.rect.a1, s.rect.k + 0.0001, s.rect.b1));
+    case primitive_type::yz_rect:
+        return aabb(point3(s.rect.k - 0.0001, s.rect.a0, s.rect.b0), point3(s.rect.k + 0.0001, s.rect.a1, s.rect.b1));
+    case primitive_type::box:
+        return aabb(to_point(s.box.min), to_point(s.box.max));
+    case primitive_type::triangle: {
+        point3 a = to_point(s.triangle.v0);
+        point3 b = a + to_point(s.triangle.e1);
+        point3 c = a + to_point(s.triangle.e2);
+        return aabb(
+            point3(fmin(a.x(), fmin(b.x(), c.x())), fmin(a.y(), fmin(b.y(), c.y())), fmin(a.z(), fmin(b.z(), c.z()))),
+            point3(fmax(a.x(), fmax(b.x(), c.x())), fmax(a.y(), fmax(b.y(), c.y())), fmax(a.z(), fmax(b.z(), c.z()))));
+    }
+    }
+    return aabb();
+}
+
+// Primitives of the closed set in one contiguous array. Hits match a hittable_list of
+// the equivalent objects added in the same order.
+class primitive_list : public hittable {
+public:
+    primitive_list() {}
+
+    void add(const primitive& p) { primitives.push_back(p); }
+
+    // Adds a sphere, aarect or box by value; returns false for any other hittable.
+    bool add(const hittable& object);
+
+    size_t size() const { return primitives.size(); }
+
+    virtual bool hit(
+        const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+public:
+    std::vector<primitive> primitives;
+};
+
+bool primitive_list::add(const hittable& object) {
+    primitive p;
+    if (!primitive::from(object, p))
+        return false;
+    add(p);
+    return true;
+}
+
+bool primitive_list::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    const primitive* closest = nullptr;
+    auto closest_so_far = t_max;
+
+    // The geometry tests only write rec when they hit, so no temporary record is needed.
+    for (const auto& p : primitives) {
+        if (intersect_primitive(p, r, t_min, closest_so_far, rec)) {
+            closest = &p;
+            closest_so_far = rec.t;
+        }
+    }
+
+    if (!closest)
+        return false;
+
+    rec.mat_id = closest->mat_id;
+    return true;
+}
+
+bool primitive_list::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (primitives.empty())
+        return false;
+
+    output_box = primitive_bounds(primitives[0]);
+    for (size_t i = 1; i < primitives.size(); ++i)
+        output_box = surrounding_box(output_box, primitive_bounds(primitives[i]));
+    return true;
+}
+
+#endif
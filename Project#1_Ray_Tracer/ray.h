@@ -1,31 +1,46 @@
-#ifndef RAY_H
-#define RAY_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "vec3.h"
-
-class ray {
-public:
-    ray() {}
-    ray(const point3& origin, const vec3& direction)
-        : orig(origin), dir(direction)
-    {}
-
-    point3 origin() const { return orig; }
-    vec3 direction() const { return dir; }
-
-    point3 at(double t) const {
-        return orig + t * dir;
-    }
-
-public:
-    point3 orig;
-    vec3 dir;
-};
-
+#ifndef RAY_H
+#define RAY_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "vec3.h"
+
+// Besides origin and direction, a ray carries what every slab test against it needs:
+// the reciprocal of each direction component and whether it is negative (Williams et
+// al., "An Efficient and Robust Ray-Box Intersection Algorithm", JGT 2005). A zero
+// component gives an infinite reciprocal with the zero's sign, so rays along an axis
+// need no special case.
+template <typename T>
+class basic_ray {
+public:
+    basic_ray() {}
+    basic_ray(const basic_vec3<T>& origin, const basic_vec3<T>& direction)
+        : orig(origin), dir(direction)
+    {
+        for (int a = 0; a < 3; ++a) {
+            inv_dir[a] = 1 / dir[a];
+            sign[a] = inv_dir[a] < 0;
+        }
+    }
+
+    const basic_vec3<T>& origin() const { return orig; }
+    const basic_vec3<T>& direction() const { return dir; }
+
+    basic_vec3<T> at(T t) const {
+        return orig + t * dir;
+    }
+
+public:
+    basic_vec3<T> orig;
+    basic_vec3<T> dir;
+    basic_vec3<T> inv_dir;
+    int sign[3];   // 1 where inv_dir is negative: the ray meets that axis's max plane first
+};
+
+using ray = basic_ray<real>;
+
 #endif
\ No newline at end of file
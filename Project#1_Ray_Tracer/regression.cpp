@@ -0,0 +1,178 @@
+// Golden-image regression renders. Every built-in scene is rendered small, with a fixed
+// seed and sample count, and compared against the reference image stored for it in
+// golden/, so that a change meant only to make the tracer faster is checked for
+// what it does to the picture at the same time. Built on Linux with
+//
+//     make regress          (g++ -std=c++17 -O2 -pthread regression.cpp -o regression)
+//
+// Command line: [--references DIR] [--update] [--out DIR] [--filter TEXT]
+//               [--pixel-tolerance E] [--mean-tolerance E] [--threads N]
+// A scene passes when every pixel is finite, no channel of any pixel is off by more
+// than the pixel tolerance (0.1 by default) and the mean absolute error over all
+// channels is at most the mean tolerance (1e-4). Renders are deterministic, so an unchanged tracer matches exactly;
+// the tolerances leave room for the odd path that takes another turn in the float32
+// build or with another packet instruction set, and catch anything that moves the
+// image as a whole. The exit code is 1 if any scene fails.
+// --update writes the current renders as the new references instead of comparing.
+// --out writes the renders of failing scenes there as NAME.pfm and NAME.png.
+
+#include "rtweekend.h"
+
+#include "bvh.h"
+#include "camera.h"
+#include "framebuffer.h"
+#include "hittable_list.h"
+#include "image_compare.h"
+#include "image_writer.h"
+#include "integrator.h"
+#include "lights.h"
+#include "material_table.h"
+#include "renderer.h"
+#include "scene.h"
+#include "scenes.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The render every reference was made with. Changing any of these invalidates them.
+const int regression_width = 128;
+const int regression_samples = 16;
+const unsigned regression_seed = 405;
+
+// Renders the scene the way main() does by default: Sobol samples, packets for the
+// primary rays, and the iterative integrator with next-event estimation.
+framebuffer render_regression(const scene_description& scene, unsigned threads) {
+    const int roulette_depth = 3;
+    const auto& settings = scene.settings;
+
+    material_table materials;
+    scene.build_materials(materials);
+    light_list lights;
+    for (size_t i = 0; i < scene.primitive_count(); ++i)
+        lights.add(scene.primitives()[i], materials);
+    std::vector<shared_ptr<hittable>> instances;
+    scene.build_instances(instances);
+    bvh_node world(scene.primitives(), scene.primitive_count(), instances);
+
+    const int image_width = regression_width;
+    const int image_height = static_cast<int>(image_width / settings.aspect_ratio);
+    camera cam(settings.lookfrom, settings.lookat, settings.vup, settings.vfov, settings.aspect_ratio);
+
+    tile_renderer renderer(32, threads);
+    renderer.sampling.type = sampler_type::sobol;
+    renderer.sampling.samples_per_pixel = regression_samples;
+
+    packet_tracer tracer;
+    tracer.world = &world;
+    tracer.primary = [&](int i, int j) {
+        double du, dv;
+        sample_2d(du, dv);
+        return cam.get_ray((i + du) / (image_width - 1), (j + dv) / (image_height - 1));
+    };
+    tracer.shade = [&](const ray& r, bool hit, const hit_record& rec) {
+        return shade_path(r, hit, rec, settings.background, world, materials, settings.max_depth, roulette_depth, &lights);
+    };
+
+    framebuffer image(image_width, image_height);
+    renderer.render(image, regression_seed, 0, regression_samples, tracer);
+    return image;
+}
+
+int main(int argc, char* argv[]) {
+    std::string references = "golden";
+    std::string out_dir;
+    std::string filter;
+    bool update = false;
+    double pixel_tolerance = 0.1;
+    double mean_tolerance = 1e-4;
+    unsigned threads = 0;
+
+    for (int a = 1; a < argc; ++a) {
+        std::string arg = argv[a];
+        bool has_value = a + 1 < argc;
+        if (arg == "--references" && has_value)
+            references = argv[++a];
+        else if (arg == "--update")
+            update = true;
+        else if (arg == "--out" && has_value)
+            out_dir = argv[++a];
+        else if (arg == "--filter" && has_value)
+            filter = argv[++a];
+        else if (arg == "--pixel-tolerance" && has_value)
+            pixel_tolerance = std::atof(argv[++a]);
+        else if (arg == "--mean-tolerance" && has_value)
+            mean_tolerance = std::atof(argv[++a]);
+        else if (arg == "--threads" && has_value)
+            threads = static_cast<unsigned>(std::max(0, std::atoi(argv[++a])));
+        else {
+            std::cerr << "Unknown argument " << arg << ".\n";
+            return 1;
+        }
+    }
+
+    std::printf("%-12s %10s %12s %12s  %s\n", "scene", "time (s)", "mean error", "max error", "result");
+    int failures = 0;
+    for (const auto& builtin : builtin_scenes) {
+        std::string name = builtin.name;
+        if (name.find(filter) == std::string::npos)
+            continue;
+
+        hittable_list objects;
+        material_table scene_materials;
+        scene_description scene;
+        builtin.build(objects, scene_materials, scene.settings);
+        if (!scene.capture(objects, scene_materials))
+            return 1;
+
+        auto start = std::chrono::steady_clock::now();
+        auto image = render_regression(scene, threads);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << '\r' << std::flush;   // the table overwrites the renderer's progress line
+
+        auto reference_path = references + "/" + name + ".pfm";
+        if (update) {
+            if (!write_image(reference_path, image))
+                return 1;
+            std::printf("%-12s %10.3f %12s %12s  written to %s\n", name.c_str(), elapsed.count(), "-", "-", reference_path.c_str());
+            continue;
+        }
+
+        int reference_width = 0, reference_height = 0;
+        std::vector<float> reference;
+        std::string result;
+        image_error error;
+        if (!read_pfm(reference_path, reference_width, reference_height, reference))
+            result = "FAIL (no reference; run with --update)";
+        else if (reference_width != image.width || reference_height != image.height)
+            result = "FAIL (reference is " + std::to_string(reference_width) + "x" + std::to_string(reference_height) + ")";
+        else {
+            error = compare_images(image.resolve_hdr(), reference);
+            if (error.non_finite > 0)
+                result = "FAIL (" + std::to_string(error.non_finite) + " non-finite pixels)";
+            else if (error.max_error > pixel_tolerance)
+                result = "FAIL (pixel error)";
+            else if (error.mean_error > mean_tolerance)
+                result = "FAIL (mean error)";
+            else
+                result = "ok";
+        }
+
+        std::printf("%-12s %10.3f %12.3g %12.3g  %s\n", name.c_str(), elapsed.count(), error.mean_error, error.max_error, result.c_str());
+        std::fflush(stdout);
+        if (result != "ok") {
+            ++failures;
+            if (!out_dir.empty()) {
+                write_image(out_dir + "/" + name + ".pfm", image);
+                write_image(out_dir + "/" + name + ".png", image);
+            }
+        }
+    }
+
+    if (failures)
+        std::printf("%d scene%s failed.\n", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "rtweekend.h"
+#include "aov.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Stops sampling a pixel once framebuffer::display_error() drops to the threshold.
+// Every pixel still takes at least min_samples, and never more than the samples asked
+// for by render(). A threshold of zero turns adaptive sampling off.
+struct adaptive_settings {
+    double threshold = 0.0;
+    int min_samples = 16;
+};
+
+// Packet tracing splits a sample in two. primary() makes the camera ray through pixel
+// (i, j); the renderer intersects it with the world together with the rays of the
+// neighbouring pixels in its packet. shade() then carries on from that first hit (or
+// miss) one ray at a time.
+struct packet_tracer {
+    std::function<ray(int i, int j)> primary;
+    std::function<color(const ray& r, bool hit, const hit_record& rec)> shade;
+    const hittable* world = nullptr;
+    real t_min = ray_t_min;
+};
+
+struct tile {
+    int x0, y0; // inclusive lower-left pixel
+    int x1, y1; // exclusive upper-right pixel
+};
+
+// Renders an image as a set of square tiles on a pool of worker threads.
+//
+// Every worker starts with its own contiguous run of tiles and, once that runs dry,
+// steals from the back of the other workers' queues. The RNG is reseeded for every
+// sample from (seed, pixel index, sample index), and so is the sampler, so the result
+// does not depend on the thread count or on which worker ended up with a tile.
+//
+// render() takes samples [first_sample, first_sample + sample_count) of every pixel and
+// adds them to the image one by one, so splitting a render into several passes gives
+// exactly the same sums as a single pass. Pixels that have already converged under the
+// adaptive settings are skipped.
+//
+// The packet_tracer overload traces the primary rays of packet_width pixels in a row
+// together and produces the same image as the per-sample overload.
+//
+// With tile_parts above one, only every tile_parts-th tile, starting from tile_part, is
+// rendered and the rest of the image is left alone, so that separate processes can
+// each take a share of one frame. Interleaving the shares keeps them about equally
+// expensive even when the costly part of the scene sits in one corner.
+//
+// With features set, every sample also adds the first-hit features its sample function
+// or shade function left behind with record_first_hit() (see aov.h).
+class tile_renderer {
+public:
+    // Traces one sample through pixel (i, j) and returns its radiance.
+    using sample_function = std::function<color(int i, int j)>;
+
+    tile_renderer(int size = 32, unsigned threads = 0)
+        : tile_size(size), thread_count(threads ? threads : default_thread_count()) {}
+
+    void render(
+        framebuffer& image, unsigned seed, int first_sample, int sample_count,
+        const sample_function& sample_color) const;
+
+    void render(
+        framebuffer& image, unsigned seed, int first_sample, int sample_count,
+        const packet_tracer& tracer) const;
+
+    static unsigned default_thread_count() {
+        auto n = std::thread::hardware_concurrency();
+        return n ? n : 1;
+    }
+
+public:
+    int tile_size;
+    unsigned thread_count;
+    adaptive_settings adaptive;
+    sampler_settings sampling;
+    int tile_part = 0;
+    int tile_parts = 1;
+    feature_buffers* features = nullptr;
+
+private:
+    struct work_queue {
+        std::mutex lock;
+        std::deque<tile> tiles;
+    };
+
+    std::vector<tile> make_tiles(int width, int height) const;
+    void for_each_tile(const framebuffer& image, const std::function<void(const tile&)>& render_one) const;
+    static bool take_own(work_queue& queue, tile& t);
+    static bool steal(std::vector<work_queue>& queues, unsigned thief, tile& t);
+    void render_tile(
+        framebuffer& image, const tile& t, unsigned seed, int first_sample, int sample_count,
+        const sample_function& sample_color) const;
+    void render_tile_packets(
+        framebuffer& image, const tile& t, unsigned seed, int first_sample, int sample_count,
+        const packet_tracer& tracer) const;
+
+    void start_sample(unsigned seed, int i, int j, size_t pixel, int s) const {
+        seed_random(seed, static_cast<unsigned>(pixel), static_cast<unsigned>(s));
+        current_sampler().start(sampling, seed, i, j, static_cast<unsigned>(pixel), static_cast<unsigned>(s));
+    }
+
+    bool converged(const framebuffer& image, size_t pixel) const {
+        return adaptive.threshold > 0
+            && image.samples[pixel] >= adaptive.min_samples
+            && image.display_error(pixel) <= adaptive.threshold;
+    }
+};
+
+std::vector<tile> tile_renderer::make_tiles(int width, int height) const {
+    // Top row first, matching the order in which the image is written out.
+    std::vector<tile> tiles;
+    int k = 0;
+    for (int y1 = height; y1 > 0; y1 -= tile_size) {
+        for (int x0 = 0; x0 < width; x0 += tile_size, ++k) {
+            if (k % tile_parts == tile_part)
+                tiles.push_back({ x0, std::max(0, y1 - tile_size), std::min(width, x0 + tile_size), y1 });
+        }
+    }
+    return tiles;
+}
+
+bool tile_renderer::take_own(work_queue& queue, tile& t) {
+    std::lock_guard<std::mutex> guard(queue.lock);
+    if (queue.tiles.empty())
+        return false;
+    t = queue.tiles.front();
+    queue.tiles.pop_front();
+    return true;
+}
+
+bool tile_renderer::steal(std::vector<work_queue>& queues, unsigned thief, tile& t) {
+    // Victims are visited starting from the thief's neighbour so that idle workers
+    // spread out over the remaining queues instead of all hitting the same one.
+    for (size_t k = 1; k < queues.size(); ++k) {
+        auto& victim = queues[(thief + k) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if (!victim.tiles.empty()) {
+            t = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void tile_renderer::render_tile(
+    framebuffer& image, const tile& t, unsigned seed, int first_sample, int sample_count,
+    const sample_function& sample_color
+) const {
+    for (int j = t.y1 - 1; j >= t.y0; --j) {
+        for (int i = t.x0; i < t.x1; ++i) {
+            // Tiles never overlap, so each pixel has exactly one writer.
+            auto pixel = image.index(i, j);
+            for (int s = first_sample; s < first_sample + sample_count; ++s) {
+                if (converged(image, pixel))
+                    break;
+                start_sample(seed, i, j, pixel, s);
+                image.add_sample(pixel, sample_color(i, j));
+                if (features)
+                    features->add_sample(pixel, current_features());
+            }
+        }
+    }
+}
+
+void tile_renderer::render_tile_packets(
+    framebuffer& image, const tile& t, unsigned seed, int first_sample, int sample_count,
+    const packet_tracer& tracer
+) const {
+    ray_packet packet;
+    rng lane_generator[packet_width];
+    sampler lane_sampler[packet_width];
+
+    for (int j = t.y1 - 1; j >= t.y0; --j) {
+        for (int i0 = t.x0; i0 < t.x1; i0 += packet_width) {
+            int lanes = std::min(packet_width, t.x1 - i0);
+            for (int s = first_sample; s < first_sample + sample_count; ++s) {
+                // Every lane runs the same random sequence as a scalar sample: it is seeded
+                // and draws its camera ray here, and its generator and sampler are parked
+                // until the packet has been intersected.
+                packet.active = 0;
+                for (int k = 0; k < lanes; ++k) {
+                    auto pixel = image.index(i0 + k, j);
+                    if (converged(image, pixel))
+                        continue;
+                    start_sample(seed, i0 + k, j, pixel, s);
+                    packet.set(k, tracer.primary(i0 + k, j), infinity);
+                    lane_generator[k] = random_generator();
+                    lane_sampler[k] = current_sampler();
+                }
+                if (!packet.active)
+                    break;
+
+                unsigned hits = tracer.world->hit_packet(packet, tracer.t_min);
+                for (int k = 0; k < lanes; ++k) {
+                    if (!(packet.active >> k & 1))
+                        continue;
+                    random_generator() = lane_generator[k];
+                    current_sampler() = lane_sampler[k];
+                    auto sample = tracer.shade(packet.rays[k], (hits >> k & 1) != 0, packet.rec[k]);
+                    auto pixel = image.index(i0 + k, j);
+                    image.add_sample(pixel, sample);
+                    if (features)
+                        features->add_sample(pixel, current_features());
+                }
+            }
+        }
+    }
+}
+
+void tile_renderer::render(
+    framebuffer& image, unsigned seed, int first_sample, int sample_count,
+    const sample_function& sample_color
+) const {
+    for_each_tile(image, [&](const tile& t) {
+        render_tile(image, t, seed, first_sample, sample_count, sample_color);
+    });
+}
+
+void tile_renderer::render(
+    framebuffer& image, unsigned seed, int first_sample, int sample_count,
+    const packet_tracer& tracer
+) const {
+    for_each_tile(image, [&](const tile& t) {
+        render_tile_packets(image, t, seed, first_sample, sample_count, tracer);
+    });
+}
+
+void tile_renderer::for_each_tile(
+    const framebuffer& image, const std::function<void(const tile&)>& render_one
+) const {
+    auto tiles = make_tiles(image.width, image.height);
+    auto workers = std::max(1u, std::min<unsigned>(thread_count, static_cast<unsigned>(tiles.size())));
+
+    // Deal the tiles out in contiguous runs so each worker starts on its own region.
+    std::vector<work_queue> queues(workers);
+    for (size_t k = 0; k < tiles.size(); ++k)
+        queues[k * workers / tiles.size()].tiles.push_back(tiles[k]);
+
+    std::atomic<int> tiles_remaining(static_cast<int>(tiles.size()));
+    std::mutex progress_lock;
+
+    auto work = [&](unsigned id) {
+        tile t;
+        while (take_own(queues[id], t) || steal(queues, id, t)) {
+            {
+                tile_timer timer(t.x0, t.y0, t.x1, t.y1);
+                render_one(t);
+            }
+
+            auto remaining = --tiles_remaining;
+            std::lock_guard<std::mutex> guard(progress_lock);
+            std::cerr << "\rTiles remaining: " << remaining << ' ' << std::flush;
+        }
+        merge_thread_stats(id);
+    };
+
+    // The single-threaded path runs on the calling thread; it produces the same image.
+    if (workers == 1) {
+        work(0);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+    for (unsigned id = 0; id < workers; ++id)
+        pool.emplace_back(work, id);
+    for (auto& thread : pool)
+        thread.join();
+}
+
+#endif
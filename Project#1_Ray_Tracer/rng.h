@@ -0,0 +1,95 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Small, fast generators for the per-thread random stream behind random_double().
+// Both expose the same interface, so the engine is picked at compile time:
+//
+//     seed(seed, stream)   restart the generator on an independent sequence
+//     next_double()        uniform real in [0,1)
+//
+// Build with RT_RNG_XOSHIRO defined to switch from PCG32 to xoshiro256+.
+
+// 64-bit finalizer from SplitMix64; turns structured keys such as (pixel, sample)
+// into well-mixed seeds.
+inline uint64_t mix_bits(uint64_t v) {
+    v ^= v >> 30;
+    v *= 0xbf58476d1ce4e5b9ULL;
+    v ^= v >> 27;
+    v *= 0x94d049bb133111ebULL;
+    v ^= v >> 31;
+    return v;
+}
+
+// PCG-XSH-RR with 64-bit state and a selectable stream (M.E. O'Neill, pcg-random.org).
+class pcg32 {
+public:
+    pcg32() { seed(0, 0); }
+
+    void seed(uint64_t seed_value, uint64_t stream) {
+        state = 0u;
+        inc = (stream << 1u) | 1u;
+        next_uint();
+        state += mix_bits(seed_value);
+        next_uint();
+    }
+
+    uint32_t next_uint() {
+        uint64_t old_state = state;
+        state = old_state * 6364136223846793005ULL + inc;
+        auto xorshifted = static_cast<uint32_t>(((old_state >> 18u) ^ old_state) >> 27u);
+        auto rot = static_cast<uint32_t>(old_state >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31));
+    }
+
+    double next_double() {
+        return next_uint() * (1.0 / 4294967296.0);
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// xoshiro256+ (Blackman & Vigna); the top 53 bits give a full-precision double.
+class xoshiro256plus {
+public:
+    xoshiro256plus() { seed(0, 0); }
+
+    void seed(uint64_t seed_value, uint64_t stream) {
+        // Expand the key with SplitMix64 as recommended by the authors.
+        uint64_t x = mix_bits(seed_value) ^ stream;
+        for (auto& word : s) {
+            x += 0x9e3779b97f4a7c15ULL;
+            word = mix_bits(x);
+        }
+    }
+
+    uint64_t next_uint() {
+        uint64_t result = s[0] + s[3];
+        uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+        return result;
+    }
+
+    double next_double() {
+        return (next_uint() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+private:
+    uint64_t s[4];
+};
+
+#ifdef RT_RNG_XOSHIRO
+using rng = xoshiro256plus;
+#else
+using rng = pcg32;
+#endif
+
+#endif
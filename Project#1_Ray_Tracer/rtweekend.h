@@ -1,50 +1,66 @@
-#ifndef RTWEEKEND_H
-#define RTWEEKEND_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include <cmath>
-#include <limits>
-#include <memory>
-
-
-// Usings
-
-using std::shared_ptr;
-using std::make_shared;
-using std::sqrt;
-
-// Constants
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
-
-// Utility Functions
-inline double degrees_to_radians(double degrees) {
-    return degrees * pi / 180.0;
-}
-
-inline double clamp(double x, double min, double max) {
-    if (x < min) return min;
-    if (x > max) return max;
-    return x;
-}
-
-inline double random_double() {
-    // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
-}
-
-inline double random_double(double min, double max) {
-    // Returns a random real in [min,max).
-    return min + (max - min) * random_double();
-}
-
-// Common Headers
-#include "ray.h"
-#include "vec3.h"
-
+#ifndef RTWEEKEND_H
+#define RTWEEKEND_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+#include "rng.h"
+
+
+// Usings
+
+using std::shared_ptr;
+using std::make_shared;
+using std::sqrt;
+
+// Constants
+const double infinity = std::numeric_limits<double>::infinity();
+const double pi = 3.1415926535897932385;
+
+// Utility Functions
+inline double degrees_to_radians(double degrees) {
+    return degrees * pi / 180.0;
+}
+
+inline double clamp(double x, double min, double max) {
+    if (x < min) return min;
+    if (x > max) return max;
+    return x;
+}
+
+inline rng& random_generator() {
+    // Each render thread owns its generator, so workers never race on rand()'s global state.
+    thread_local rng generator;
+    return generator;
+}
+
+inline void seed_random(unsigned seed, unsigned pixel, unsigned sample) {
+    // Restarts the calling thread's sequence for one sample of one pixel. Every sample
+    // draws the same numbers no matter which thread, pass or process renders it.
+    uint64_t key = (static_cast<uint64_t>(pixel) << 32) | sample;
+    random_generator().seed(key ^ mix_bits(seed), seed);
+}
+
+inline double random_double() {
+    // Returns a random real in [0,1).
+    return random_generator().next_double();
+}
+
+inline double random_double(double min, double max) {
+    // Returns a random real in [min,max).
+    return min + (max - min) * random_double();
+}
+
+// Common Headers
+#include "sampler.h"
+#include "ray.h"
+#include "vec3.h"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,361 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "rtweekend.h"
+#include "rng.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Where the numbers behind a sample come from. Every sample of a pixel is a point in
+// a high-dimensional unit cube: the first two dimensions jitter the camera ray, and
+// each bounce then takes the dimensions it needs for scattering, light sampling, the
+// Fresnel choice and Russian roulette.
+//
+//     random       independent random numbers, the same stream as random_double()
+//     stratified   jittered strata, shuffled independently for every dimension
+//     sobol        Owen-scrambled Sobol points, a fresh scramble per pixel and dimension
+//     blue_noise   one Sobol sequence for the whole image, shifted per pixel by a
+//                  blue-noise mask (Georgiev and Fajardo, "Blue-noise Dithered
+//                  Sampling", 2016), so neighbouring pixels make opposite errors
+//
+// Dimensions beyond the first few are padded: each pair gets its own scramble, which
+// is how pbrt and Burley ("Practical Hash-based Owen Scrambling", JCGT 2020) extend
+// low-dimensional sequences to whole paths.
+enum class sampler_type : uint8_t { random, stratified, sobol, blue_noise };
+
+struct sampler_settings {
+    sampler_type type = sampler_type::random;
+    int samples_per_pixel = 1;   // stratified only: the number of strata
+};
+
+// Kensler's hashed permutation of [0, length) ("Correlated Multi-Jittered Sampling",
+// Pixar technical memo 13-01), so strata can be shuffled without storing a table.
+inline uint32_t permute_index(uint32_t i, uint32_t length, uint32_t p) {
+    uint32_t w = length - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do {
+        i ^= p;             i *= 0xe170893d;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;        i *= 0x0929eb3f;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;  i *= 1 | p >> 27;
+                            i *= 0x6935fa69;
+        i ^= (i & w) >> 11; i *= 0x74dcb303;
+        i ^= (i & w) >> 2;  i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;  i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= length);
+    return (i + p) % length;
+}
+
+inline uint32_t reverse_bits(uint32_t x) {
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+// Laine and Karras' hash, with Burley's constants: every bit is flipped depending only
+// on the bits below it, which is Owen scrambling for a value with its bits reversed.
+inline uint32_t laine_karras(uint32_t x, uint32_t seed) {
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Nested uniform (Owen) scrambling of a 32-bit fixed-point value by hashing (Burley 2020).
+inline uint32_t owen_scramble(uint32_t x, uint32_t seed) {
+    return reverse_bits(laine_karras(reverse_bits(x), seed));
+}
+
+// First two dimensions of the Sobol sequence as 32-bit fixed point. The first is the
+// index with its bits reversed, so scrambling it cancels two of the reversals in
+// owen_scramble().
+inline uint32_t scrambled_sobol_0(uint32_t index, uint32_t seed) {
+    return reverse_bits(laine_karras(index, seed));
+}
+
+// The second dimension is linear in the bits of the index, so it is looked up a byte
+// at a time. Scrambled indices use all 32 bits.
+struct sobol_1_table {
+    uint32_t bytes[4][256];
+
+    sobol_1_table() {
+        uint32_t directions[32];
+        uint32_t v = 1u << 31;
+        for (int bit = 0; bit < 32; ++bit, v ^= v >> 1)
+            directions[bit] = v;
+        for (int b = 0; b < 4; ++b) {
+            for (uint32_t value = 0; value < 256; ++value) {
+                uint32_t result = 0;
+                for (int bit = 0; bit < 8; ++bit)
+                    if (value >> bit & 1)
+                        result ^= directions[8 * b + bit];
+                bytes[b][value] = result;
+            }
+        }
+    }
+};
+
+inline uint32_t sobol_1(uint32_t index) {
+    static const sobol_1_table table;
+    return table.bytes[0][index & 0xff] ^ table.bytes[1][index >> 8 & 0xff]
+         ^ table.bytes[2][index >> 16 & 0xff] ^ table.bytes[3][index >> 24];
+}
+
+inline double to_unit(uint32_t x) {
+    return x * (1.0 / 4294967296.0);
+}
+
+// A 64x64 tileable blue-noise threshold mask made with Ulichney's void-and-cluster
+// method: every value from 0 to 1 is used once, and pixels of similar value lie far
+// apart. Built on first use, the same every time.
+class blue_noise_mask {
+public:
+    static const int size = 64;
+
+    static const blue_noise_mask& get() {
+        static const blue_noise_mask mask;
+        return mask;
+    }
+
+    // Wraps around in both directions.
+    double operator()(int x, int y) const {
+        return values[(y & (size - 1)) * size + (x & (size - 1))];
+    }
+
+private:
+    blue_noise_mask();
+
+    std::vector<float> values;
+};
+
+blue_noise_mask::blue_noise_mask() {
+    const int n = size * size;
+    const double sigma = 1.5;
+
+    // Energy of a point as seen from every offset on the torus.
+    std::vector<double> kernel(n);
+    for (int dy = 0; dy < size; ++dy) {
+        for (int dx = 0; dx < size; ++dx) {
+            int x = std::min(dx, size - dx);
+            int y = std::min(dy, size - dy);
+            kernel[dy * size + dx] = std::exp(-(x * x + y * y) / (2 * sigma * sigma));
+        }
+    }
+
+    std::vector<char> on(n, 0);
+    std::vector<double> energy(n, 0.0);
+    auto toggle = [&](int p, bool set) {
+        on[p] = set;
+        int px = p % size, py = p / size;
+        double sign = set ? 1.0 : -1.0;
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+                energy[y * size + x] += sign * kernel[((y - py) & (size - 1)) * size + ((x - px) & (size - 1))];
+    };
+    auto tightest_cluster = [&]() {
+        int best = -1;
+        for (int p = 0; p < n; ++p)
+            if (on[p] && (best < 0 || energy[p] > energy[best]))
+                best = p;
+        return best;
+    };
+    auto largest_void = [&]() {
+        int best = -1;
+        for (int p = 0; p < n; ++p)
+            if (!on[p] && (best < 0 || energy[p] < energy[best]))
+                best = p;
+        return best;
+    };
+
+    // A random tenth of the pixels, relaxed until moving the tightest point into the
+    // largest void would put it straight back.
+    pcg32 generator;
+    generator.seed(0x5eed, 0);
+    const int initial = n / 10;
+    for (int placed = 0; placed < initial; ) {
+        int p = static_cast<int>(generator.next_uint() % n);
+        if (!on[p]) {
+            toggle(p, true);
+            ++placed;
+        }
+    }
+    for (int step = 0; step < n; ++step) {
+        int cluster = tightest_cluster();
+        toggle(cluster, false);
+        int hole = largest_void();
+        toggle(hole, true);
+        if (hole == cluster)
+            break;
+    }
+
+    // Rank the initial points by taking the tightest ones away first, then fill the
+    // largest voids until every pixel has a rank.
+    std::vector<int> rank(n);
+    auto initial_on = on;
+    auto initial_energy = energy;
+    for (int r = initial - 1; r >= 0; --r) {
+        int cluster = tightest_cluster();
+        toggle(cluster, false);
+        rank[cluster] = r;
+    }
+    on = initial_on;
+    energy = initial_energy;
+    for (int r = initial; r < n; ++r) {
+        int hole = largest_void();
+        toggle(hole, true);
+        rank[hole] = r;
+    }
+
+    values.resize(n);
+    for (int p = 0; p < n; ++p)
+        values[p] = static_cast<float>((rank[p] + 0.5) / n);
+}
+
+// The source of the numbers for the sample being traced on this thread. The renderer
+// starts it for every sample; everything that needs a random decision along the path
+// takes the next dimension from it through sample_1d() and sample_2d(). It is a plain
+// value, so the packet renderer can park one per lane like the RNG.
+class sampler {
+public:
+    sampler() {}
+
+    // Starts sample `index` of pixel (i, j), whose framebuffer index is `pixel`.
+    void start(const sampler_settings& settings, unsigned seed, int i, int j, unsigned pixel, unsigned index);
+
+    // Jumps to a fixed dimension, e.g. the first one of a bounce, so that the same
+    // decision at the same depth uses the same dimension in every sample.
+    void set_dimension(unsigned d) { dimension = d; }
+
+    double get_1d();
+    void get_2d(double& u, double& v);
+
+private:
+    // Scramble seed for one dimension of this pixel, or of the whole image.
+    uint32_t dimension_seed(unsigned d, bool per_pixel) const {
+        return static_cast<uint32_t>(mix_bits((per_pixel ? pixel_key : image_key) | d));
+    }
+
+    // Per-pixel toroidal shift of the blue-noise sequence, read from the mask at an
+    // offset that moves along an R2 sequence (in 32-bit fixed point) from one dimension
+    // to the next.
+    double blue_noise_shift(unsigned d) const {
+        auto ox = static_cast<int>((d * 0xc13fa9a9u) >> 26);
+        auto oy = static_cast<int>((d * 0x91e10da6u) >> 26);
+        return blue_noise_mask::get()(x + ox, y + oy);
+    }
+
+    static double wrap(double u) {
+        return u >= 1 ? u - 1 : u;
+    }
+
+private:
+    sampler_type type = sampler_type::random;
+    int strata = 1;
+    uint64_t pixel_key = 0;   // the seed and the pixel, to be combined with a dimension
+    uint64_t image_key = 0;   // the seed alone
+    unsigned index = 0;
+    unsigned dimension = 0;
+    int x = 0;
+    int y = 0;
+};
+
+void sampler::start(const sampler_settings& settings, unsigned seed_value, int i, int j, unsigned pixel_index, unsigned sample_index) {
+    type = settings.type;
+    strata = std::max(1, settings.samples_per_pixel);
+    image_key = mix_bits(seed_value) << 32;
+    pixel_key = mix_bits(image_key ^ pixel_index) << 32;
+    index = sample_index;
+    dimension = 0;
+    x = i;
+    y = j;
+}
+
+double sampler::get_1d() {
+    unsigned d = dimension++;
+    switch (type) {
+    case sampler_type::random:
+        break;
+    case sampler_type::stratified: {
+        auto n = static_cast<uint32_t>(strata);
+        auto stratum = permute_index(index % n, n, dimension_seed(d, true) + index / n);
+        return (stratum + random_double()) / n;
+    }
+    case sampler_type::sobol: {
+        auto seed_d = dimension_seed(d, true);
+        auto i = owen_scramble(index, seed_d);
+        return to_unit(scrambled_sobol_0(i, seed_d ^ 0x9e3779b9u));
+    }
+    case sampler_type::blue_noise: {
+        auto seed_d = dimension_seed(d, false);
+        auto i = owen_scramble(index, seed_d);
+        return wrap(to_unit(scrambled_sobol_0(i, seed_d ^ 0x9e3779b9u)) + blue_noise_shift(d));
+    }
+    }
+    return random_double();
+}
+
+void sampler::get_2d(double& u, double& v) {
+    unsigned d = dimension;
+    dimension += 2;
+    switch (type) {
+    case sampler_type::random:
+        break;
+    case sampler_type::stratified: {
+        // m x m strata; samples past m * m start over on a new shuffle.
+        auto m = static_cast<uint32_t>(std::max(1.0, std::floor(std::sqrt(static_cast<double>(strata)))));
+        auto cells = m * m;
+        auto cell = permute_index(index % cells, cells, dimension_seed(d, true) + index / cells);
+        u = (cell % m + random_double()) / m;
+        v = (cell / m + random_double()) / m;
+        return;
+    }
+    case sampler_type::sobol: {
+        auto seed_d = dimension_seed(d, true);
+        auto i = owen_scramble(index, seed_d);
+        u = to_unit(scrambled_sobol_0(i, seed_d ^ 0x9e3779b9u));
+        v = to_unit(owen_scramble(sobol_1(i), seed_d ^ 0x7f4a7c15u));
+        return;
+    }
+    case sampler_type::blue_noise: {
+        auto seed_d = dimension_seed(d, false);
+        auto i = owen_scramble(index, seed_d);
+        u = wrap(to_unit(scrambled_sobol_0(i, seed_d ^ 0x9e3779b9u)) + blue_noise_shift(d));
+        v = wrap(to_unit(owen_scramble(sobol_1(i), seed_d ^ 0x7f4a7c15u)) + blue_noise_shift(d + 1));
+        return;
+    }
+    }
+    u = random_double();
+    v = random_double();
+}
+
+inline sampler& current_sampler() {
+    // One per render thread, like random_generator().
+    thread_local sampler s;
+    return s;
+}
+
+// Next dimension (or pair of dimensions) of the current sample.
+inline double sample_1d() {
+    return current_sampler().get_1d();
+}
+
+inline void sample_2d(double& u, double& v) {
+    current_sampler().get_2d(u, v);
+}
+
+#endif
@@ -0,0 +1,1020 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "rtweekend.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "image_texture.h"
+#include "instance.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "material_table.h"
+#include "mesh.h"
+#include "obj_loader.h"
+#include "primitive.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Everything about a render that is not a command-line option: image and sampling
+// settings, background, camera, materials, primitives and instances of objects.
+//
+// Text form (.scene), one statement per line; a '#' at the start of a word begins a
+// comment:
+//
+//     width 1920                          image width in pixels
+//     aspect 16 9                         aspect ratio, as W H or a single number
+//     samples 100                         samples per pixel
+//     max_depth 50
+//     seed 405
+//     background R G B
+//     camera FROM_X FROM_Y FROM_Z AT_X AT_Y AT_Z UP_X UP_Y UP_Z VFOV
+//     material NAME lambertian R G B
+//     material NAME metal R G B FUZZ
+//     material NAME dielectric IR
+//     material NAME diffuse_light R G B
+//     material NAME image FILE [SCALE]    lambertian with its albedo from an image (PNG,
+//                                         JPEG, ...) relative to the scene file, repeated
+//                                         SCALE times across u and v
+//     sphere X Y Z RADIUS MATERIAL
+//     box X0 Y0 Z0 X1 Y1 Z1 MATERIAL
+//     xy_rect X0 X1 Y0 Y1 K MATERIAL      (xz_rect X0 X1 Z0 Z1 K, yz_rect Y0 Y1 Z0 Z1 K)
+//     triangle AX AY AZ BX BY BZ CX CY CZ MATERIAL
+//     object NAME                         the shapes up to "end" make up object NAME,
+//     end                                 which is not drawn by itself
+//     mesh NAME FILE.obj [MATERIAL]       the OBJ model in FILE, relative to the scene
+//                                         file, as object NAME; MATERIAL replaces the
+//                                         model's own materials
+//     instance NAME OPERATION...          draws object NAME transformed by each of
+//         translate X Y Z                 the operations in turn
+//         scale X Y Z
+//         rotate AXIS_X AXIS_Y AXIS_Z DEGREES
+//         matrix M00 M01 M02 M03 M10 ... M23   (rows of [A | t], p -> A p + t)
+//
+// A material is named before the primitives that use it, and an object before its
+// instances. Objects cannot be nested. Settings left out keep the defaults below.
+// The materials of a model's MTL files are added as NAME.MTL_NAME (see load_obj());
+// its triangles are not light sources for next-event estimation. Image files are read
+// when a ray first looks them up (see image_texture.h).
+//
+// Next-event estimation only samples the diffuse_light spheres, rectangles and boxes
+// drawn directly. Emissive triangles, and whatever emits inside an object, are lit up
+// only by the scattered rays that happen to hit them, which is unbiased but noisier; put
+// a light that matters outside any object.
+//
+// Binary form (.rtscene): scene_file_header | material_count material_records
+//                         | object_count scene_objects | instance_count instance_records
+//                         | primitive_count primitives
+// The primitives are the in-memory primitive structs, so a mapped file is used in
+// place. That ties the file to builds with the same real type; convert from the text
+// form to move between them. The first world_primitive_count primitives are drawn
+// directly; each object's follow as one contiguous range. Meshes and image materials
+// have no binary form.
+struct scene_settings {
+    int image_width = 1920;
+    double aspect_ratio = 16.0 / 9.0;
+    int samples_per_pixel = 100;
+    int max_depth = 50;
+    uint32_t seed = 405;
+    color background = color(0, 0, 0);
+    point3 lookfrom = point3(0, 0, 0);
+    point3 lookat = point3(0, 0, -1);
+    vec3 vup = vec3(0, 1, 0);
+    double vfov = 90;
+};
+
+struct material_record {
+    uint32_t type;       // material_type
+    uint32_t reserved;   // 1 for the materials of a mesh, which the text form leaves to it
+    double albedo[3];    // lambertian, metal
+    double fuzz;         // metal
+    double ir;           // dielectric
+    double emit[3];      // diffuse_light
+};
+
+struct scene_object {
+    uint32_t first;   // range in the primitive array
+    uint32_t count;
+};
+
+struct instance_record {
+    uint32_t object;
+    uint32_t reserved;
+    double matrix[3][4];   // object to world, as in transform
+};
+
+// A model from an OBJ file, loaded along with the text form.
+struct scene_mesh {
+    std::string file;    // as written in the scene
+    uint32_t material;   // replaces the model's materials unless no_index
+    shared_ptr<triangle_mesh> mesh;
+};
+
+// The image of a textured lambertian, from the text form.
+struct scene_texture {
+    std::string file;   // as written in the scene or MTL file; empty if the material has none
+    std::string path;   // where it is read from
+    double scale = 1;
+};
+
+struct scene_file_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t real_size;
+    uint32_t primitive_size;
+    uint32_t material_count;
+    uint32_t primitive_count;
+    uint32_t world_primitive_count;
+    uint32_t object_count;
+    uint32_t instance_count;
+    uint32_t reserved;
+    int32_t image_width;
+    int32_t samples_per_pixel;
+    int32_t max_depth;
+    uint32_t seed;
+    double aspect_ratio;
+    double background[3];
+    double lookfrom[3];
+    double lookat[3];
+    double vup[3];
+    double vfov;
+};
+
+const uint32_t scene_file_version = 2;
+
+class scene_description {
+public:
+    scene_description() {}
+
+    scene_description(const scene_description&) = delete;
+    scene_description& operator=(const scene_description&) = delete;
+
+    // Reads the binary form if the file starts with its magic, the text form otherwise.
+    bool load(const std::string& path);
+
+    // Writes the binary form to a .rtscene path and the text form to anything else.
+    bool save(const std::string& path) const;
+
+    // Takes over a scene built in code. Fails on objects outside the closed primitive
+    // set and on materials the table cannot describe. An instance becomes an object
+    // (once per shared child) and an instance record; its child must be a primitive or
+    // a hittable_list of them.
+    bool capture(const hittable_list& world, const material_table& table);
+
+    void build_materials(material_table& table) const;
+
+    // FNV-1a hash of the scene's text form, which checkpoints and partial renders record
+    // so that samples of different scenes are never added together. Meshes and images
+    // count by file name, not content.
+    uint64_t fingerprint() const;
+
+    // Builds one BVH per object and an instance of it for every instance record, and
+    // an instance of its mesh for every mesh instance record.
+    void build_instances(std::vector<shared_ptr<hittable>>& out) const;
+
+    // The primitives drawn directly, i.e. not part of an object.
+    const primitive* primitives() const { return prims; }
+    size_t primitive_count() const { return world_count; }
+
+public:
+    scene_settings settings;
+    std::vector<material_record> materials;
+    std::vector<std::string> material_names;   // from the text form; may be empty
+    std::vector<scene_texture> material_textures;   // from the text form; may be empty
+    std::vector<scene_object> objects;
+    std::vector<std::string> object_names;     // from the text form; may be empty
+    std::vector<instance_record> instances;
+    std::vector<scene_mesh> meshes;
+    std::vector<std::string> mesh_names;
+    std::vector<instance_record> mesh_instances;   // object indexes meshes
+
+private:
+    bool load_text(const std::string& path);
+    bool load_binary(const std::string& path);
+    bool save_text(const std::string& path) const;
+    bool save_binary(const std::string& path) const;
+    void write_text(std::ostream& out) const;
+
+    void clear() {
+        materials.clear();
+        material_names.clear();
+        material_textures.clear();
+        objects.clear();
+        object_names.clear();
+        instances.clear();
+        meshes.clear();
+        mesh_names.clear();
+        mesh_instances.clear();
+        owned.clear();
+        mapping.close();
+        prims = nullptr;
+        count = world_count = 0;
+    }
+
+    std::string material_name(uint32_t id) const {
+        if (id < material_names.size() && !material_names[id].empty())
+            return material_names[id];
+        return "material_" + std::to_string(id);
+    }
+
+    std::string object_name(uint32_t id) const {
+        if (id < object_names.size() && !object_names[id].empty())
+            return object_names[id];
+        return "object_" + std::to_string(id);
+    }
+
+    // A file named in a scene or model, relative to directory unless it is absolute.
+    static std::string relative_to(const std::string& directory, const std::string& file) {
+        bool absolute = !file.empty() && (file[0] == '/' || file[0] == '\\' || (file.size() > 1 && file[1] == ':'));
+        return absolute ? file : directory + file;
+    }
+
+    // Lays out world primitives followed by each object's, as the binary form does.
+    void set_owned(std::vector<primitive>& world, const std::vector<std::vector<primitive>>& object_prims);
+
+    // Loads the model of m, its file relative to directory, and adds its materials as
+    // NAME.MTL_NAME unless m has a material of its own.
+    bool load_mesh(const std::string& directory, const std::string& name, scene_mesh& m);
+
+    static void write_primitive(std::ostream& out, const primitive& p);
+
+private:
+    std::vector<primitive> owned;   // text and captured scenes
+    mapped_file mapping;            // binary scenes; the primitives stay in the file
+    const primitive* prims = nullptr;
+    size_t count = 0;         // all primitives, objects' included
+    size_t world_count = 0;
+};
+
+bool scene_description::load(const std::string& path) {
+    std::ifstream probe(path, std::ios::binary);
+    char magic[4] = {};
+    if (!probe.read(magic, 4) || std::memcmp(magic, "RTSC", 4) != 0) {
+        probe.close();
+        return load_text(path);
+    }
+    probe.close();
+    return load_binary(path);
+}
+
+bool scene_description::save(const std::string& path) const {
+    const std::string extension = ".rtscene";
+    bool binary = path.size() >= extension.size()
+        && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    return binary ? save_binary(path) : save_text(path);
+}
+
+bool scene_description::load_text(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "Cannot open " << path << ".\n";
+        return false;
+    }
+
+    settings = scene_settings();
+    clear();
+    std::map<std::string, uint32_t> ids;
+    std::map<std::string, uint32_t> object_ids;
+    std::map<std::string, uint32_t> mesh_ids;
+    std::vector<primitive> world;
+    std::vector<std::vector<primitive>> object_prims;
+    bool in_object = false;   // shapes go to object_prims.back()
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line)) {
+        ++line_number;
+        // Only a word can start a comment, so file names may contain '#'.
+        for (size_t c = line.find('#'); c != std::string::npos; c = line.find('#', c + 1)) {
+            if (c == 0 || line[c - 1] == ' ' || line[c - 1] == '\t') {
+                line.erase(c);
+                break;
+            }
+        }
+
+        std::istringstream words(line);
+        std::string keyword;
+        if (!(words >> keyword))
+            continue;
+
+        auto fail = [&](const std::string& message) {
+            std::cerr << path << ':' << line_number << ": " << message << '\n';
+            return false;
+        };
+        auto read_point = [&](point3& p) {
+            double x, y, z;
+            if (!(words >> x >> y >> z))
+                return false;
+            p = point3(x, y, z);
+            return true;
+        };
+        auto read_color = [&](double c[3]) {
+            return static_cast<bool>(words >> c[0] >> c[1] >> c[2]);
+        };
+        auto add = [&](const primitive& p) {
+            (in_object ? object_prims.back() : world).push_back(p);
+        };
+        auto read_material = [&](uint32_t& id) {
+            std::string name;
+            if (!(words >> name))
+                return fail("missing material name");
+            auto found = ids.find(name);
+            if (found == ids.end())
+                return fail("unknown material " + name);
+            id = found->second;
+            return true;
+        };
+
+        if (keyword == "width") {
+            if (!(words >> settings.image_width) || settings.image_width <= 0)
+                return fail("width needs a positive number of pixels");
+        }
+        else if (keyword == "aspect") {
+            double w, h;
+            if (!(words >> w) || w <= 0)
+                return fail("aspect needs W H or a single ratio");
+            settings.aspect_ratio = w;
+            if (words >> h) {
+                if (h <= 0)
+                    return fail("aspect needs W H or a single ratio");
+                settings.aspect_ratio = w / h;
+            }
+        }
+        else if (keyword == "samples") {
+            if (!(words >> settings.samples_per_pixel) || settings.samples_per_pixel <= 0)
+                return fail("samples needs a positive count");
+        }
+        else if (keyword == "max_depth") {
+            if (!(words >> settings.max_depth) || settings.max_depth <= 0)
+                return fail("max_depth needs a positive count");
+        }
+        else if (keyword == "seed") {
+            if (!(words >> settings.seed))
+                return fail("seed needs a number");
+        }
+        else if (keyword == "background") {
+            double c[3];
+            if (!read_color(c))
+                return fail("background needs R G B");
+            settings.background = color(c[0], c[1], c[2]);
+        }
+        else if (keyword == "camera") {
+            if (!read_point(settings.lookfrom) || !read_point(settings.lookat) || !read_point(settings.vup)
+                || !(words >> settings.vfov))
+                return fail("camera needs lookfrom, lookat, vup and a vertical field of view");
+        }
+        else if (keyword == "material") {
+            std::string name, type;
+            if (!(words >> name >> type))
+                return fail("material needs a name and a type");
+            if (ids.count(name))
+                return fail("material " + name + " is already defined");
+
+            material_record m = {};
+            m.ir = 1;
+            scene_texture image;
+            if (type == "lambertian") {
+                m.type = static_cast<uint32_t>(material_type::lambertian);
+                if (!read_color(m.albedo))
+                    return fail("lambertian needs R G B");
+            }
+            else if (type == "metal") {
+                m.type = static_cast<uint32_t>(material_type::metal);
+                if (!read_color(m.albedo) || !(words >> m.fuzz))
+                    return fail("metal needs R G B FUZZ");
+            }
+            else if (type == "dielectric") {
+                m.type = static_cast<uint32_t>(material_type::dielectric);
+                if (!(words >> m.ir))
+                    return fail("dielectric needs an index of refraction");
+            }
+            else if (type == "diffuse_light") {
+                m.type = static_cast<uint32_t>(material_type::diffuse_light);
+                if (!read_color(m.emit))
+                    return fail("diffuse_light needs R G B");
+            }
+            else if (type == "image") {
+                m.type = static_cast<uint32_t>(material_type::lambertian);
+                m.albedo[0] = m.albedo[1] = m.albedo[2] = 1;
+                if (!(words >> image.file))
+                    return fail("image needs a file");
+                if (!(words >> std::ws).eof() && (!(words >> image.scale) || image.scale <= 0))
+                    return fail("image needs a positive SCALE");
+                image.path = relative_to(obj_detail::directory_of(path), image.file);
+                if (!std::ifstream(image.path, std::ios::binary))
+                    return fail("cannot open image " + image.path);
+            }
+            else {
+                return fail("unknown material type " + type);
+            }
+
+            ids[name] = static_cast<uint32_t>(materials.size());
+            materials.push_back(m);
+            material_names.push_back(name);
+            material_textures.push_back(image);
+        }
+        else if (keyword == "sphere") {
+            point3 center;
+            double radius;
+            uint32_t mat;
+            if (!read_point(center) || !(words >> radius))
+                return fail("sphere needs X Y Z RADIUS MATERIAL");
+            if (!read_material(mat))
+                return false;
+            add(primitive::make_sphere(center, radius, mat));
+        }
+        else if (keyword == "box") {
+            point3 p0, p1;
+            uint32_t mat;
+            if (!read_point(p0) || !read_point(p1))
+                return fail("box needs X0 Y0 Z0 X1 Y1 Z1 MATERIAL");
+            if (!read_material(mat))
+                return false;
+            add(primitive::make_box(p0, p1, mat));
+        }
+        else if (keyword == "xy_rect" || keyword == "xz_rect" || keyword == "yz_rect") {
+            double a0, a1, b0, b1, k;
+            uint32_t mat;
+            if (!(words >> a0 >> a1 >> b0 >> b1 >> k))
+                return fail(keyword + " needs A0 A1 B0 B1 K MATERIAL");
+            if (!read_material(mat))
+                return false;
+            auto type = keyword == "xy_rect" ? primitive_type::xy_rect
+                      : keyword == "xz_rect" ? primitive_type::xz_rect : primitive_type::yz_rect;
+            add(primitive::make_rect(type, a0, a1, b0, b1, k, mat));
+        }
+        else if (keyword == "triangle") {
+            point3 a, b, c;
+            uint32_t mat;
+            if (!read_point(a) || !read_point(b) || !read_point(c))
+                return fail("triangle needs three vertices and a material");
+            if (!read_material(mat))
+                return false;
+            add(primitive::make_triangle(a, b, c, mat));
+        }
+        else if (keyword == "object") {
+            std::string name;
+            if (!(words >> name))
+                return fail("object needs a name");
+            if (in_object)
+                return fail("objects cannot be nested");
+            if (object_ids.count(name) || mesh_ids.count(name))
+                return fail("object " + name + " is already defined");
+            object_ids[name] = static_cast<uint32_t>(object_prims.size());
+            object_names.push_back(name);
+            object_prims.emplace_back();
+            in_object = true;
+        }
+        else if (keyword == "end") {
+            if (!in_object)
+                return fail("end without object");
+            if (object_prims.back().empty())
+                return fail("object " + object_names.back() + " is empty");
+            in_object = false;
+        }
+        else if (keyword == "mesh") {
+            std::string name;
+            scene_mesh m;
+            m.material = triangle_mesh::no_index;
+            if (!(words >> name >> m.file))
+                return fail("mesh needs a name and an OBJ file");
+            if (in_object)
+                return fail("meshes cannot be part of an object");
+            if (object_ids.count(name) || mesh_ids.count(name))
+                return fail("object " + name + " is already defined");
+            if (!(words >> std::ws).eof() && !read_material(m.material))
+                return false;
+            if (!load_mesh(obj_detail::directory_of(path), name, m))
+                return fail("cannot load mesh " + m.file);
+            mesh_ids[name] = static_cast<uint32_t>(meshes.size());
+            mesh_names.push_back(name);
+            meshes.push_back(m);
+        }
+        else if (keyword == "instance") {
+            std::string name;
+            if (!(words >> name))
+                return fail("instance needs an object name");
+            if (in_object)
+                return fail("instances cannot be part of an object");
+            auto found = object_ids.find(name);
+            auto found_mesh = mesh_ids.find(name);
+            if (found == object_ids.end() && found_mesh == mesh_ids.end())
+                return fail("unknown object " + name);
+
+            transform to_world;
+            std::string operation;
+            while (words >> operation) {
+                if (operation == "translate" || operation == "scale") {
+                    point3 v;
+                    if (!read_point(v))
+                        return fail(operation + " needs X Y Z");
+                    to_world = (operation == "translate" ? transform::translate(v) : transform::scale(v)) * to_world;
+                }
+                else if (operation == "rotate") {
+                    point3 axis;
+                    double degrees;
+                    if (!read_point(axis) || !(words >> degrees) || axis.length_squared() == 0)
+                        return fail("rotate needs an axis and an angle in degrees");
+                    to_world = transform::rotate(axis, degrees) * to_world;
+                }
+                else if (operation == "matrix") {
+                    transform m;
+                    for (int i = 0; i < 12; ++i) {
+                        if (!(words >> m.m[i / 4][i % 4]))
+                            return fail("matrix needs 12 numbers");
+                    }
+                    to_world = m * to_world;
+                }
+                else {
+                    return fail("unknown instance operation " + operation);
+                }
+            }
+            // A zero scale or a matrix that flattens space has no inverse to carry rays
+            // into the object with.
+            if (!std::isnormal(to_world.determinant()))
+                return fail("instance of " + name + " has a singular transform");
+
+            instance_record record = {};
+            std::memcpy(record.matrix, to_world.m, sizeof(record.matrix));
+            if (found != object_ids.end()) {
+                record.object = found->second;
+                instances.push_back(record);
+            }
+            else {
+                record.object = found_mesh->second;
+                mesh_instances.push_back(record);
+            }
+        }
+        else {
+            return fail("unknown statement " + keyword);
+        }
+
+        std::string extra;
+        if (words >> extra)
+            return fail("unexpected " + extra);
+    }
+
+    if (in_object) {
+        std::cerr << path << ": object " << object_names.back() << " has no end\n";
+        return false;
+    }
+    set_owned(world, object_prims);
+    return true;
+}
+
+void scene_description::set_owned(std::vector<primitive>& world, const std::vector<std::vector<primitive>>& object_prims) {
+    owned.swap(world);
+    world_count = owned.size();
+    for (const auto& shapes : object_prims) {
+        objects.push_back({ static_cast<uint32_t>(owned.size()), static_cast<uint32_t>(shapes.size()) });
+        owned.insert(owned.end(), shapes.begin(), shapes.end());
+    }
+    prims = owned.data();
+    count = owned.size();
+}
+
+bool scene_description::load_mesh(const std::string& directory, const std::string& name, scene_mesh& m) {
+    auto mesh = make_shared<triangle_mesh>();
+    std::vector<obj_material> model_materials;
+    if (!load_obj(relative_to(directory, m.file), *mesh, model_materials))
+        return false;
+
+    auto first = static_cast<uint32_t>(materials.size());
+    if (m.material != triangle_mesh::no_index) {
+        for (auto& f : mesh->faces)
+            f.mat_id = m.material;
+        model_materials.clear();
+    }
+    for (const auto& model : model_materials) {
+        material_record record = {};
+        record.reserved = 1;
+        record.ir = 1;
+        scene_texture image;
+        if (model.emission.length_squared() > 0) {
+            record.type = static_cast<uint32_t>(material_type::diffuse_light);
+            for (int a = 0; a < 3; ++a)
+                record.emit[a] = model.emission[a];
+        }
+        else {
+            record.type = static_cast<uint32_t>(material_type::lambertian);
+            for (int a = 0; a < 3; ++a)
+                record.albedo[a] = model.diffuse[a];
+            image.file = image.path = model.diffuse_map;
+        }
+        materials.push_back(record);
+        material_names.push_back(name + "." + model.name);
+        material_textures.push_back(image);
+    }
+    if (!model_materials.empty()) {
+        for (auto& f : mesh->faces)
+            f.mat_id += first;
+    }
+
+    m.mesh = mesh;
+    return true;
+}
+
+bool scene_description::load_binary(const std::string& path) {
+    clear();
+    if (!mapping.open(path))
+        return false;
+
+    scene_file_header header;
+    if (mapping.size() < sizeof(header)) {
+        std::cerr << path << " is truncated.\n";
+        return false;
+    }
+    std::memcpy(&header, mapping.data(), sizeof(header));
+    if (header.version != scene_file_version) {
+        std::cerr << path << " is version " << header.version << ", expected " << scene_file_version << ".\n";
+        return false;
+    }
+    if (header.real_size != sizeof(real) || header.primitive_size != sizeof(primitive)) {
+        std::cerr << path << " was written by a build with a different precision; convert it again from the text form.\n";
+        return false;
+    }
+
+    auto materials_offset = sizeof(header);
+    auto objects_offset = materials_offset + size_t(header.material_count) * sizeof(material_record);
+    auto instances_offset = objects_offset + size_t(header.object_count) * sizeof(scene_object);
+    auto primitives_offset = instances_offset + size_t(header.instance_count) * sizeof(instance_record);
+    if (mapping.size() < primitives_offset + size_t(header.primitive_count) * sizeof(primitive)) {
+        std::cerr << path << " is truncated.\n";
+        return false;
+    }
+
+    settings.image_width = header.image_width;
+    settings.aspect_ratio = header.aspect_ratio;
+    settings.samples_per_pixel = header.samples_per_pixel;
+    settings.max_depth = header.max_depth;
+    settings.seed = header.seed;
+    settings.background = color(header.background[0], header.background[1], header.background[2]);
+    settings.lookfrom = point3(header.lookfrom[0], header.lookfrom[1], header.lookfrom[2]);
+    settings.lookat = point3(header.lookat[0], header.lookat[1], header.lookat[2]);
+    settings.vup = vec3(header.vup[0], header.vup[1], header.vup[2]);
+    settings.vfov = header.vfov;
+
+    materials.resize(header.material_count);
+    std::memcpy(materials.data(), mapping.data() + materials_offset, materials.size() * sizeof(material_record));
+    for (const auto& m : materials) {
+        if (m.type > static_cast<uint32_t>(material_type::diffuse_light)) {
+            std::cerr << path << " has a material of unknown type " << m.type << ".\n";
+            return false;
+        }
+    }
+
+    objects.resize(header.object_count);
+    std::memcpy(objects.data(), mapping.data() + objects_offset, objects.size() * sizeof(scene_object));
+    instances.resize(header.instance_count);
+    std::memcpy(instances.data(), mapping.data() + instances_offset, instances.size() * sizeof(instance_record));
+    if (header.world_primitive_count > header.primitive_count) {
+        std::cerr << path << " has more world primitives than primitives.\n";
+        return false;
+    }
+    for (const auto& object : objects) {
+        if (object.count == 0 || object.first < header.world_primitive_count
+            || object.first > header.primitive_count || object.count > header.primitive_count - object.first) {
+            std::cerr << path << " has an object outside its primitives.\n";
+            return false;
+        }
+    }
+    for (const auto& record : instances) {
+        if (record.object >= objects.size()) {
+            std::cerr << path << " has an instance of unknown object " << record.object << ".\n";
+            return false;
+        }
+        transform to_world;
+        std::memcpy(to_world.m, record.matrix, sizeof(to_world.m));
+        if (!std::isnormal(to_world.determinant())) {
+            std::cerr << path << " has an instance with a singular transform.\n";
+            return false;
+        }
+    }
+
+    // The primitives are used where they lie; check them once so a damaged file cannot
+    // send the tracer into the wrong case of a switch or past the material table.
+    auto mapped = reinterpret_cast<const primitive*>(mapping.data() + primitives_offset);
+    for (size_t i = 0; i < header.primitive_count; ++i) {
+        if (static_cast<unsigned>(mapped[i].type) > static_cast<unsigned>(primitive_type::triangle)
+            || mapped[i].mat_id >= header.material_count) {
+            std::cerr << path << ": primitive " << i << " is damaged.\n";
+            return false;
+        }
+    }
+    prims = mapped;
+    count = header.primitive_count;
+    world_count = header.world_primitive_count;
+    return true;
+}
+
+bool scene_description::save_text(const std::string& path) const {
+    std::ofstream out(path);
+    write_text(out);
+    if (!out) {
+        std::cerr << "Cannot write " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+uint64_t scene_description::fingerprint() const {
+    std::ostringstream text;
+    write_text(text);
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : text.str()) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+void scene_description::write_text(std::ostream& out) const {
+    out.precision(9);
+
+    const auto& s = settings;
+    out << "width " << s.image_width << '\n'
+        << "aspect " << std::setprecision(17) << s.aspect_ratio << std::setprecision(9) << '\n'
+        << "samples " << s.samples_per_pixel << '\n'
+        << "max_depth " << s.max_depth << '\n'
+        << "seed " << s.seed << '\n'
+        << "background " << s.background << '\n'
+        << "camera " << s.lookfrom << "  " << s.lookat << "  " << s.vup << "  " << s.vfov << "\n\n";
+
+    for (uint32_t id = 0; id < materials.size(); ++id) {
+        const auto& m = materials[id];
+        if (m.reserved)
+            continue;
+        out << "material " << material_name(id) << ' ';
+        switch (static_cast<material_type>(m.type)) {
+        case material_type::lambertian:
+            if (id < material_textures.size() && !material_textures[id].file.empty())
+                out << "image " << material_textures[id].file << ' ' << material_textures[id].scale;
+            else
+                out << "lambertian " << m.albedo[0] << ' ' << m.albedo[1] << ' ' << m.albedo[2];
+            break;
+        case material_type::metal:
+            out << "metal " << m.albedo[0] << ' ' << m.albedo[1] << ' ' << m.albedo[2] << ' ' << m.fuzz;
+            break;
+        case material_type::dielectric:
+            out << "dielectric " << m.ir;
+            break;
+        default:
+            out << "diffuse_light " << m.emit[0] << ' ' << m.emit[1] << ' ' << m.emit[2];
+            break;
+        }
+        out << '\n';
+    }
+    out << '\n';
+
+    for (size_t id = 0; id < meshes.size(); ++id) {
+        out << "mesh " << mesh_names[id] << ' ' << meshes[id].file;
+        if (meshes[id].material != triangle_mesh::no_index)
+            out << ' ' << material_name(meshes[id].material);
+        out << '\n';
+    }
+    if (!meshes.empty())
+        out << '\n';
+
+    for (uint32_t id = 0; id < objects.size(); ++id) {
+        out << "object " << object_name(id) << '\n';
+        for (uint32_t i = 0; i < objects[id].count; ++i) {
+            out << "    ";
+            write_primitive(out, prims[objects[id].first + i]);
+            out << ' ' << material_name(prims[objects[id].first + i].mat_id) << '\n';
+        }
+        out << "end\n\n";
+    }
+
+    for (size_t i = 0; i < world_count; ++i) {
+        write_primitive(out, prims[i]);
+        out << ' ' << material_name(prims[i].mat_id) << '\n';
+    }
+
+    // Matrices are written in full so instances land exactly where they were.
+    out << std::setprecision(17);
+    for (const auto& record : instances) {
+        out << "instance " << object_name(record.object) << " matrix";
+        for (int i = 0; i < 12; ++i)
+            out << ' ' << record.matrix[i / 4][i % 4];
+        out << '\n';
+    }
+    for (const auto& record : mesh_instances) {
+        out << "instance " << mesh_names[record.object] << " matrix";
+        for (int i = 0; i < 12; ++i)
+            out << ' ' << record.matrix[i / 4][i % 4];
+        out << '\n';
+    }
+}
+
+void scene_description::write_primitive(std::ostream& out, const primitive& p) {
+    const auto& g = p.shape;
+    switch (p.type) {
+    case primitive_type::sphere:
+        out << "sphere " << to_point(g.sphere.center) << ' ' << g.sphere.radius;
+        break;
+    case primitive_type::xy_rect:
+    case primitive_type::xz_rect:
+    case primitive_type::yz_rect:
+        out << (p.type == primitive_type::xy_rect ? "xy_rect " : p.type == primitive_type::xz_rect ? "xz_rect " : "yz_rect ")
+            << g.rect.a0 << ' ' << g.rect.a1 << ' ' << g.rect.b0 << ' ' << g.rect.b1 << ' ' << g.rect.k;
+        break;
+    case primitive_type::box:
+        out << "box " << to_point(g.box.min) << ' ' << to_point(g.box.max);
+        break;
+    case primitive_type::triangle: {
+        point3 a = to_point(g.triangle.v0);
+        out << "triangle " << a << ' ' << a + to_point(g.triangle.e1) << ' ' << a + to_point(g.triangle.e2);
+        break;
+    }
+    }
+}
+
+bool scene_description::save_binary(const std::string& path) const {
+    if (!meshes.empty()) {
+        std::cerr << "Meshes have no binary form; save the scene as text.\n";
+        return false;
+    }
+    for (const auto& image : material_textures) {
+        if (!image.file.empty()) {
+            std::cerr << "Image materials have no binary form; save the scene as text.\n";
+            return false;
+        }
+    }
+
+    scene_file_header header = {};
+    std::memcpy(header.magic, "RTSC", 4);
+    header.version = scene_file_version;
+    header.real_size = sizeof(real);
+    header.primitive_size = sizeof(primitive);
+    header.material_count = static_cast<uint32_t>(materials.size());
+    header.primitive_count = static_cast<uint32_t>(count);
+    header.world_primitive_count = static_cast<uint32_t>(world_count);
+    header.object_count = static_cast<uint32_t>(objects.size());
+    header.instance_count = static_cast<uint32_t>(instances.size());
+
+    const auto& s = settings;
+    header.image_width = s.image_width;
+    header.samples_per_pixel = s.samples_per_pixel;
+    header.max_depth = s.max_depth;
+    header.seed = s.seed;
+    header.aspect_ratio = s.aspect_ratio;
+    header.vfov = s.vfov;
+    for (int a = 0; a < 3; ++a) {
+        header.background[a] = s.background[a];
+        header.lookfrom[a] = s.lookfrom[a];
+        header.lookat[a] = s.lookat[a];
+        header.vup[a] = s.vup[a];
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(materials.data()), materials.size() * sizeof(material_record));
+    out.write(reinterpret_cast<const char*>(objects.data()), objects.size() * sizeof(scene_object));
+    out.write(reinterpret_cast<const char*>(instances.data()), instances.size() * sizeof(instance_record));
+    out.write(reinterpret_cast<const char*>(prims), count * sizeof(primitive));
+    if (!out) {
+        std::cerr << "Cannot write " << path << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool scene_description::capture(const hittable_list& world, const material_table& table) {
+    clear();
+
+    for (uint32_t id = 0; id < table.size(); ++id) {
+        material_record m = {};
+        m.type = static_cast<uint32_t>(table.type[id]);
+        m.fuzz = table.fuzz[id];
+        m.ir = table.ir[id];
+        for (int a = 0; a < 3; ++a)
+            m.albedo[a] = table.albedo[id][a];
+
+        switch (table.type[id]) {
+        case material_type::lambertian:
+            if (table.albedo_map[id]) {
+                std::cerr << "Material " << id << " has a texture, which has no scene file form.\n";
+                return false;
+            }
+            break;
+        case material_type::diffuse_light: {
+            // Only uniform emitters can be written out; a solid_color gives the same
+            // value everywhere.
+            color e = table.emit[id]->value(0, 0, point3(0, 0, 0));
+            for (int a = 0; a < 3; ++a)
+                m.emit[a] = e[a];
+            break;
+        }
+        case material_type::other:
+            std::cerr << "Material " << id << " has no scene file form.\n";
+            return false;
+        default:
+            break;
+        }
+        materials.push_back(m);
+    }
+
+    std::vector<primitive> top;
+    std::vector<std::vector<primitive>> object_prims;
+    std::map<const hittable*, uint32_t> object_ids;   // instances sharing a child share an object
+    for (size_t i = 0; i < world.objects.size(); ++i) {
+        const auto& object = world.objects[i];
+        primitive p;
+        if (primitive::from(*object, p)) {
+            top.push_back(p);
+            continue;
+        }
+
+        const auto* placed = dynamic_cast<const instance*>(object.get());
+        if (!placed) {
+            std::cerr << "Object " << i << " has no scene file form.\n";
+            return false;
+        }
+
+        const hittable* child = placed->object.get();
+        auto found = object_ids.find(child);
+        if (found == object_ids.end()) {
+            std::vector<primitive> shapes;
+            if (const auto* list = dynamic_cast<const hittable_list*>(child)) {
+                for (const auto& part : list->objects) {
+                    if (!primitive::from(*part, p)) {
+                        shapes.clear();
+                        break;
+                    }
+                    shapes.push_back(p);
+                }
+            }
+            else if (primitive::from(*child, p)) {
+                shapes.push_back(p);
+            }
+            if (shapes.empty()) {
+                std::cerr << "Object " << i << " is an instance of something with no scene file form.\n";
+                return false;
+            }
+            found = object_ids.emplace(child, static_cast<uint32_t>(object_prims.size())).first;
+            object_prims.push_back(shapes);
+        }
+
+        instance_record record = {};
+        record.object = found->second;
+        std::memcpy(record.matrix, placed->to_world.m, sizeof(record.matrix));
+        instances.push_back(record);
+    }
+
+    set_owned(top, object_prims);
+    return true;
+}
+
+void scene_description::build_instances(std::vector<shared_ptr<hittable>>& out) const {
+    std::vector<shared_ptr<hittable>> shared(objects.size());
+    for (size_t id = 0; id < objects.size(); ++id)
+        shared[id] = make_shared<bvh_node>(prims + objects[id].first, objects[id].count);
+
+    for (const auto& record : instances) {
+        transform to_world;
+        std::memcpy(to_world.m, record.matrix, sizeof(to_world.m));
+        out.push_back(make_shared<instance>(shared[record.object], to_world));
+    }
+    for (const auto& record : mesh_instances) {
+        transform to_world;
+        std::memcpy(to_world.m, record.matrix, sizeof(to_world.m));
+        out.push_back(make_shared<instance>(meshes[record.object].mesh, to_world));
+    }
+}
+
+void scene_description::build_materials(material_table& table) const {
+    for (size_t id = 0; id < materials.size(); ++id) {
+        const auto& m = materials[id];
+        color albedo(m.albedo[0], m.albedo[1], m.albedo[2]);
+        switch (static_cast<material_type>(m.type)) {
+        case material_type::lambertian:
+            if (id < material_textures.size() && !material_textures[id].path.empty()) {
+                const auto& image = material_textures[id];
+                table.add(make_shared<lambertian>(make_shared<image_texture>(image.path, image.scale)));
+            }
+            else {
+                table.add(make_shared<lambertian>(albedo));
+            }
+            break;
+        case material_type::metal:
+            table.add(make_shared<metal>(albedo, m.fuzz));
+            break;
+        case material_type::dielectric:
+            table.add(make_shared<dielectric>(m.ir));
+            break;
+        default:
+            table.add(make_shared<diffuse_light>(color(m.emit[0], m.emit[1], m.emit[2])));
+            break;
+        }
+    }
+}
+
+#endif
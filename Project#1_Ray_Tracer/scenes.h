@@ -0,0 +1,214 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "rtweekend.h"
+#include "box.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "material.h"
+#include "material_table.h"
+#include "scene.h"
+#include "sphere.h"
+
+// The built-in scenes: Mickey Mouse, with the earlier test objects kept in comments,
+// and those test objects on their own. main() captures one into a scene_description
+// like any scene file, and --save-scene writes it out as a starting point for new ones.
+void set_camera(scene_settings& settings, const point3& lookfrom, const point3& lookat, const vec3& vup, double vfov) {
+    settings.lookfrom = lookfrom;
+    settings.lookat = lookat;
+    settings.vup = vup;
+    settings.vfov = vfov;
+}
+
+void mickey_scene(hittable_list& world, material_table& materials, scene_settings& settings) {
+    // Image
+    //settings.aspect_ratio = 4.0 / 3.0;
+    //settings.image_width = 800;
+    settings.aspect_ratio = 16.0 / 9.0;
+    settings.image_width = 1920;
+    settings.samples_per_pixel = 100;
+    settings.max_depth = 50;
+    settings.seed = 405;
+
+    //Blackout
+    //settings.background = color(0, 0, 0);
+    
+    //Navy Room
+    settings.background = color(0.0, 0.0, 0.4);
+
+    // Materials, referenced by the objects below through their table IDs; those only
+    // the commented-out MAIN OBJECTS use are commented out with them
+    auto material_ground = materials.add(make_shared<lambertian>(color(0.0, 0.0, 0.6)));
+
+    //Metal
+    auto metal_gold = materials.add(make_shared<metal>(color(1.0, 0.95, 0.0),0.15));
+    //auto metal_green = materials.add(make_shared<metal>(color(0.37, 1.0, 0.37),0.075));
+
+    //Lambert
+    //auto material_orange = materials.add(make_shared<lambertian>(color(0.7, 0.3, 0.3)));
+    //auto material_aqua = materials.add(make_shared<lambertian>(color(0.2, 1.0, 1.0)));
+    //auto material_pink = materials.add(make_shared<lambertian>(color(1.0, 0.6, 1.0)));
+    //auto material_lambert = materials.add(make_shared<lambertian>(color(1.0, 1.0, 0.4)));
+
+    //Glass
+    //auto material_glass = materials.add(make_shared<dielectric>(2.5));
+
+    //Diffuse Light
+    //auto light_green = materials.add(make_shared<diffuse_light>(color(0.4, 0.9, 0.1)));
+    auto light_moon = materials.add(make_shared<diffuse_light>(color(1.0, 1.0, 0.4)));
+    //auto light_orange = materials.add(make_shared<diffuse_light>(color(0.7, 0.3, 0.3)));
+    //auto light_pink = materials.add(make_shared<diffuse_light>(color(1.0, 0.6, 1.0)));
+
+
+    /*
+    MAIN OBJECTS
+
+    //Ground
+    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
+    
+    //1
+    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, material_orange));
+    
+    //Glass 1
+    world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, material_glass));
+    
+    //Hollow Glass 1
+    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), -0.175, material_glass));
+
+    //Orange Light 1
+    //world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, light_orange));
+    
+    //2
+    world.add(make_shared<sphere>(point3(-0.6, 0.2, -1.0), 0.05, metal_gold));
+    
+    //3
+    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, metal_green));
+
+    //Green Light 3
+    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, light_green));
+    
+    //4
+    world.add(make_shared<sphere>(point3(0.5, 0.4, -1.0), 0.1, metal_gold));
+    
+    //5
+    //world.add(make_shared<sphere>(point3(0.95, 0.1, -1.0), 0.25, material_lambert));
+
+    //Orange Light 5
+    world.add(make_shared<sphere>(point3(0.95, 0.1, -1.0), 0.25, light_orange));
+
+    //Blue Cube Lambert
+    //world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), material_aqua));
+    
+    //Glass Cube
+    //world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), material_glass));
+
+    //Yellow Light Cube
+    world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), light_moon));
+    
+    //Pink Rectangle Prism Lambert
+    //world.add(make_shared<box>(point3(-0.15, -0.45, -0.15), point3(0.0, 0.0, 0.0), material_pink));
+
+    //Pink Light Rectangle Prism
+    world.add(make_shared<box>(point3(-0.15, -0.45, -0.15), point3(0.0, 0.0, 0.0), light_pink));
+
+    //Metal Green
+    world.add(make_shared<sphere>(point3(-0.4, -0.16, 0.18), 0.15, metal_green));
+    */
+
+    //LET'S GET CREATIVE - MICKEY MOUSE
+    
+    //Ground
+    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
+    
+    //Head
+    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, light_moon));
+
+    //Right Ear
+    world.add(make_shared<sphere>(point3(0.5, 0.4, -1.0), 0.2, metal_gold));
+
+    //Left Ear
+    world.add(make_shared<sphere>(point3(-0.5, 0.4, -1.0), 0.2, metal_gold));
+
+    //Nose
+    world.add(make_shared<sphere>(point3(0.02, -0.125, -0.6), 0.04, metal_gold));
+    world.add(make_shared<sphere>(point3(0.01, -0.125, -0.6), 0.0425, metal_gold));
+    world.add(make_shared<sphere>(point3(0.00, -0.125, -0.6), 0.045, metal_gold));
+    world.add(make_shared<sphere>(point3(-0.01, -0.125, -0.6), 0.0425, metal_gold));
+    world.add(make_shared<sphere>(point3(-0.02, -0.125, -0.6), 0.04, metal_gold));
+
+    //Eyes: one column of spheres, placed twice
+    auto eye = make_shared<hittable_list>();
+    for (int k = 0; k < 15; ++k)
+        eye->add(make_shared<sphere>(point3(0.0, 0.1 - 0.01 * k, 0.0), 0.04, metal_gold));
+
+    //Left Eye
+    world.add(make_shared<instance>(eye, transform::translate(vec3(-0.125, 0.0, -0.6))));
+
+    //Right Eye
+    world.add(make_shared<instance>(eye, transform::translate(vec3(0.125, 0.0, -0.6))));
+
+    //Front Camera
+    //set_camera(settings, point3(0, 0, 2), point3(0, 0.0, -1), vec3(0, 1, 0), 45);
+    
+    //Angle #1
+    //set_camera(settings, point3(-1, 0, 2), point3(0, 0.5, -1), vec3(0, 1, 0), 40);
+
+    //Angle #2
+    set_camera(settings, point3(-4.85, -0.45, 1.5), point3(1.25, 1.25, -1.5), vec3(0, 1, 0), 35);
+
+    // Camera
+    //Task1 Angle1
+    //set_camera(settings, point3(-1, 0, 2), point3(0, 0.5, -1), vec3(0, 1, 0), 60);
+    
+    //Task1 Angle2
+    //set_camera(settings, point3(-4.85, -0.45, 1.5), point3(1.25, 1.25, -1.5), vec3(0, 1, 0), 30);
+}
+
+
+// The first scene, the "MAIN OBJECTS" block above: spheres of every material, a glass
+// sphere and two emissive boxes. The metal sphere that shared its place with Green
+// Light 3 is left out, since two coincident surfaces would make the image depend on
+// the order in which they are intersected.
+void objects_scene(hittable_list& world, material_table& materials, scene_settings& settings) {
+    settings.aspect_ratio = 16.0 / 9.0;
+    settings.image_width = 1920;
+    settings.samples_per_pixel = 100;
+    settings.max_depth = 50;
+    settings.seed = 405;
+    settings.background = color(0.0, 0.0, 0.4);
+
+    auto material_ground = materials.add(make_shared<lambertian>(color(0.0, 0.0, 0.6)));
+    auto metal_gold = materials.add(make_shared<metal>(color(1.0, 0.95, 0.0), 0.15));
+    auto metal_green = materials.add(make_shared<metal>(color(0.37, 1.0, 0.37), 0.075));
+    auto material_glass = materials.add(make_shared<dielectric>(2.5));
+    auto light_green = materials.add(make_shared<diffuse_light>(color(0.4, 0.9, 0.1)));
+    auto light_moon = materials.add(make_shared<diffuse_light>(color(1.0, 1.0, 0.4)));
+    auto light_orange = materials.add(make_shared<diffuse_light>(color(0.7, 0.3, 0.3)));
+    auto light_pink = materials.add(make_shared<diffuse_light>(color(1.0, 0.6, 1.0)));
+
+    world.add(make_shared<sphere>(point3(0.0, -100.5, -1.0), 100.0, material_ground));
+    world.add(make_shared<sphere>(point3(-1.0, 0.0, -1.0), 0.175, material_glass));
+    world.add(make_shared<sphere>(point3(-0.6, 0.2, -1.0), 0.05, metal_gold));
+    world.add(make_shared<sphere>(point3(0.0, 0.0, -1.0), 0.4, light_green));
+    world.add(make_shared<sphere>(point3(0.5, 0.4, -1.0), 0.1, metal_gold));
+    world.add(make_shared<sphere>(point3(0.95, 0.1, -1.0), 0.25, light_orange));
+    world.add(make_shared<box>(point3(0, 0, 0), point3(0.2, 0.2, 0.2), light_moon));
+    world.add(make_shared<box>(point3(-0.15, -0.45, -0.15), point3(0.0, 0.0, 0.0), light_pink));
+    world.add(make_shared<sphere>(point3(-0.4, -0.16, 0.18), 0.15, metal_green));
+
+    //Task1 Angle1
+    set_camera(settings, point3(-1, 0, 2), point3(0, 0.5, -1), vec3(0, 1, 0), 60);
+}
+
+// The built-in scenes by name, for --builtin and the regression renders.
+struct builtin_scene {
+    const char* name;
+    void (*build)(hittable_list& world, material_table& materials, scene_settings& settings);
+};
+
+const builtin_scene builtin_scenes[] = {
+    { "mickey", mickey_scene },
+    { "objects", objects_scene },
+};
+
+#endif
@@ -1,65 +1,101 @@
-#ifndef SPHERE_H
-#define SPHERE_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
-//(accessed 11.06, 2022)
-//==============================================================================================
-
-#include "hittable.h"
-#include "aabb.h"
-#include "vec3.h"
-
-class sphere : public hittable {
-public:
-    sphere() {}
-    sphere(point3 cen, double r, shared_ptr<material> m)
-        : center(cen), radius(r), mat_ptr(m) {};
-
-    virtual bool hit(
-        const ray& r, double t_min, double t_max, hit_record& rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
-
-public:
-    point3 center;
-    double radius;
-    shared_ptr<material> mat_ptr;
-};
-
-bool sphere::hit(const ray& r, double t_min, double t_max, hit_record& rec) const {
-    vec3 oc = r.origin() - center;
-    auto a = r.direction().length_squared();
-    auto half_b = dot(oc, r.direction());
-    auto c = oc.length_squared() - radius * radius;
-
-    auto discriminant = half_b * half_b - a * c;
-    if (discriminant < 0) return false;
-    auto sqrtd = sqrt(discriminant);
-
-    // Find the nearest root that lies in the acceptable range.
-    auto root = (-half_b - sqrtd) / a;
-    if (root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
-        if (root < t_min || t_max < root)
-            return false;
-    }
-
-    rec.t = root;
-    rec.p = r.at(rec.t);
-    vec3 outward_normal = (rec.p - center) / radius;
-    rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mat_ptr;
-
-    return true;
-}
-
-bool sphere::bounding_box(double time0, double time1, aabb& output_box) const {
-    output_box = aabb(
-        center - vec3(radius, radius, radius),
-        center + vec3(radius, radius, radius));
-    return true;
-}
-
+#ifndef SPHERE_H
+#define SPHERE_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing in One Weekend. raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "hittable.h"
+#include "aabb.h"
+#include "vec3.h"
+
+class sphere : public hittable {
+public:
+    sphere() {}
+    sphere(point3 cen, real r, uint32_t m)
+        : center(cen), radius(r), mat_id(m) {};
+
+    virtual bool hit(
+        const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    // Geometry-only test shared with primitive_list; leaves rec.mat_id alone.
+    static bool intersect(
+        const point3& center, real radius, const ray& r, real t_min, real t_max, hit_record& rec);
+
+    // Fills in the geometry of a hit at r.at(root), for intersect() and sphere_set.
+    static void record_hit(const point3& center, real radius, const ray& r, real root, hit_record& rec);
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+    virtual unsigned hit_packet(ray_packet& packet, real t_min) const override {
+        return finish_packet(packet, packet_simd().sphere(packet, center.e, radius, t_min), t_min);
+    }
+
+public:
+    point3 center;
+    real radius;
+    uint32_t mat_id;
+};
+
+bool sphere::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    if (!intersect(center, radius, r, t_min, t_max, rec))
+        return false;
+    rec.mat_id = mat_id;
+    return true;
+}
+
+bool sphere::intersect(
+    const point3& center, real radius, const ray& r, real t_min, real t_max, hit_record& rec
+) {
+    count_stat(stat_counter::sphere_tests);
+    vec3 oc = r.origin() - center;
+    auto a = r.direction().length_squared();
+    auto half_b = dot(oc, r.direction());
+    auto c = oc.length_squared() - radius * radius;
+
+    auto discriminant = half_b * half_b - a * c;
+    if (discriminant < 0) return false;
+    auto sqrtd = sqrt(discriminant);
+
+    // Find the nearest root that lies in the acceptable range.
+    auto root = (-half_b - sqrtd) / a;
+    if (root < t_min || t_max < root) {
+        root = (-half_b + sqrtd) / a;
+        if (root < t_min || t_max < root)
+            return false;
+    }
+
+    record_hit(center, radius, r, root, rec);
+    return true;
+}
+
+void sphere::record_hit(const point3& center, real radius, const ray& r, real root, hit_record& rec) {
+    rec.t = root;
+    rec.p = r.at(rec.t);
+    if (precision_traits<real>::offset_origins) {
+        // The root is least accurate at grazing angles; project the point back onto the
+        // sphere so its error no longer depends on the ray.
+        auto local = rec.p - center;
+        rec.p = center + local * (radius / local.length());
+    }
+    rec.p_error = rounding_error<real>(8) * (max_abs(center) + std::fabs(radius));
+
+    vec3 outward_normal = (rec.p - center) / radius;
+    rec.set_face_normal(r, outward_normal);
+
+    // Spheres have no (u, v): the angles of the book's get_sphere_uv() would cost more
+    // than the rest of the hit, and only image textures read them.
+    rec.u = rec.v = 0;
+    rec.uv_scale = 0;
+}
+
+bool sphere::bounding_box(double time0, double time1, aabb& output_box) const {
+    output_box = aabb(
+        center - vec3(radius, radius, radius),
+        center + vec3(radius, radius, radius));
+    return true;
+}
+
 #endif
\ No newline at end of file
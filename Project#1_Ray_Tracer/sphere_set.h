@@ -0,0 +1,105 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "rtweekend.h"
+#include "hittable.h"
+#include "sphere.h"
+
+#include <cstdint>
+#include <vector>
+
+// Many spheres behind one hittable. Centers and radii live in separate arrays so a ray
+// is tested against sphere_block_size spheres per kernel call, and the hit record is
+// only built once, for the closest sphere.
+//
+// Hits are the same as those of a hittable_list holding the same spheres in the same
+// order, including ties, which go to the sphere added last.
+class sphere_set : public hittable {
+public:
+    sphere_set() {}
+
+    void add(const point3& center, real radius, uint32_t mat);
+    void add(const sphere& s) { add(s.center, s.radius, s.mat_id); }
+
+    size_t size() const { return count; }
+
+    virtual bool hit(
+        const ray& r, real t_min, real t_max, hit_record& rec) const override;
+
+    virtual bool bounding_box(double time0, double time1, aabb& output_box) const override;
+
+public:
+    // Padded to a multiple of sphere_block_size; entries past size() are never reported.
+    std::vector<real> center_x, center_y, center_z, radius;
+    std::vector<uint32_t> material_id;
+
+private:
+    size_t count = 0;
+};
+
+void sphere_set::add(const point3& center, real r, uint32_t mat) {
+    if (count % sphere_block_size == 0) {
+        auto padded = count + sphere_block_size;
+        center_x.resize(padded, 0.0);
+        center_y.resize(padded, 0.0);
+        center_z.resize(padded, 0.0);
+        radius.resize(padded, 0.0);
+        material_id.resize(padded, 0);
+    }
+
+    center_x[count] = center.x();
+    center_y[count] = center.y();
+    center_z[count] = center.z();
+    radius[count] = r;
+    material_id[count] = mat;
+    ++count;
+}
+
+bool sphere_set::hit(const ray& r, real t_min, real t_max, hit_record& rec) const {
+    const sphere_lanes lanes = { { center_x.data(), center_y.data(), center_z.data() }, radius.data() };
+    const auto origin = r.origin();
+    const auto direction = r.direction();
+    const auto& kernels = packet_simd();
+    count_stat(stat_counter::sphere_tests, count);
+
+    size_t closest = count;
+    real closest_t = t_max;
+    real roots[sphere_block_size];
+
+    for (size_t first = 0; first < count; first += sphere_block_size) {
+        unsigned mask = kernels.sphere_block(lanes, first, origin.e, direction.e, t_min, closest_t, roots);
+        if (count - first < static_cast<size_t>(sphere_block_size))
+            mask &= (1u << (count - first)) - 1;
+
+        for (int k = 0; mask; ++k, mask >>= 1) {
+            if ((mask & 1) && roots[k] <= closest_t) {
+                closest_t = roots[k];
+                closest = first + k;
+            }
+        }
+    }
+
+    if (closest == count)
+        return false;
+
+    point3 center(center_x[closest], center_y[closest], center_z[closest]);
+    sphere::record_hit(center, radius[closest], r, closest_t, rec);
+    rec.mat_id = material_id[closest];
+
+    return true;
+}
+
+bool sphere_set::bounding_box(double time0, double time1, aabb& output_box) const {
+    if (count == 0)
+        return false;
+
+    for (size_t i = 0; i < count; ++i) {
+        point3 center(center_x[i], center_y[i], center_z[i]);
+        vec3 extent(radius[i], radius[i], radius[i]);
+        aabb box(center - extent, center + extent);
+        output_box = i == 0 ? box : surrounding_box(output_box, box);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,249 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Render statistics, compiled in only when RT_STATS is defined. Without it the hooks
+// below are empty inline functions and tile_timer is an empty object, so a release
+// build carries no counters at all.
+//
+// The hooks count into the calling thread's own render_stats without any locking. A
+// render worker hands its counts over with merge_thread_stats() when it runs out of
+// tiles, and render_statistics() keeps them per worker until the report is written.
+
+// What the hooks count. Rays are counted where they are traced: camera rays by the
+// camera, bounces by the integrators, shadow rays by next-event estimation. Tests are
+// counted by the scalar intersection routines, so a packet counts only the lanes its
+// SIMD kernel passes on to them; BVH nodes count one box test per ray.
+enum class stat_counter : uint8_t {
+    primary_rays, secondary_rays, shadow_rays,
+    sphere_tests, xy_rect_tests, xz_rect_tests, yz_rect_tests, box_tests, triangle_tests,
+    bvh_nodes,
+    count
+};
+
+inline const char* stat_name(stat_counter s) {
+    static const char* const names[] = {
+        "primary_rays", "secondary_rays", "shadow_rays",
+        "sphere", "xy_rect", "xz_rect", "yz_rect", "box", "triangle",
+        "bvh_nodes",
+    };
+    return names[static_cast<int>(s)];
+}
+
+// Histogram bins for the number of surface hits on a path; the last bin takes every
+// longer path too. Paths are recorded by shade_path(), not by the recursive
+// ray_color().
+const int path_length_bins = 65;
+
+struct tile_time {
+    int x0, y0, x1, y1;
+    double seconds;   // summed over passes
+};
+
+struct render_stats {
+    uint64_t counters[static_cast<int>(stat_counter::count)] = {};
+    uint64_t path_lengths[path_length_bins] = {};
+    uint64_t tiles = 0;
+    double busy_seconds = 0;
+    std::vector<tile_time> tile_times;
+
+    uint64_t operator[](stat_counter s) const { return counters[static_cast<int>(s)]; }
+
+    uint64_t rays() const {
+        return (*this)[stat_counter::primary_rays] + (*this)[stat_counter::secondary_rays] + (*this)[stat_counter::shadow_rays];
+    }
+
+    void merge(const render_stats& other);
+};
+
+void render_stats::merge(const render_stats& other) {
+    for (int i = 0; i < static_cast<int>(stat_counter::count); ++i)
+        counters[i] += other.counters[i];
+    for (int i = 0; i < path_length_bins; ++i)
+        path_lengths[i] += other.path_lengths[i];
+    tiles += other.tiles;
+    busy_seconds += other.busy_seconds;
+
+    // Tiles come back once per pass; keep one entry per tile.
+    std::map<std::pair<int, int>, size_t> index;
+    for (size_t i = 0; i < tile_times.size(); ++i)
+        index[{ tile_times[i].x0, tile_times[i].y0 }] = i;
+    for (const auto& t : other.tile_times) {
+        auto found = index.find({ t.x0, t.y0 });
+        if (found != index.end())
+            tile_times[found->second].seconds += t.seconds;
+        else
+            tile_times.push_back(t);
+    }
+}
+
+// Counts per render worker, filled in as the workers finish.
+class stats_registry {
+public:
+    void add(unsigned worker, const render_stats& stats);
+
+    render_stats total() const;
+
+    bool write_json(const std::string& path, double wall_seconds) const;
+
+public:
+    std::vector<render_stats> workers;
+
+private:
+    mutable std::mutex lock;
+};
+
+void stats_registry::add(unsigned worker, const render_stats& stats) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (workers.size() <= worker)
+        workers.resize(worker + 1);
+    workers[worker].merge(stats);
+}
+
+render_stats stats_registry::total() const {
+    std::lock_guard<std::mutex> guard(lock);
+    render_stats sum;
+    for (const auto& w : workers)
+        sum.merge(w);
+    return sum;
+}
+
+// The report: ray counts, tests per primitive type, BVH nodes, the path-length
+// histogram, and then the time of every worker and of every tile, which shows where
+// a slow render spent its time and whether the workers were kept busy.
+bool stats_registry::write_json(const std::string& path, double wall_seconds) const {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Cannot write " << path << ".\n";
+        return false;
+    }
+
+    auto sum = total();
+    auto rays = sum.rays();
+    uint64_t paths = 0, vertices = 0;
+    for (int i = 0; i < path_length_bins; ++i) {
+        paths += sum.path_lengths[i];
+        vertices += i * sum.path_lengths[i];
+    }
+
+    out << "{\n";
+    out << "  \"wall_seconds\": " << wall_seconds << ",\n";
+    out << "  \"rays\": { \"primary\": " << sum[stat_counter::primary_rays] << ", \"secondary\": " << sum[stat_counter::secondary_rays]
+        << ", \"shadow\": " << sum[stat_counter::shadow_rays] << ", \"total\": " << rays
+        << ", \"mrays_per_s\": " << (wall_seconds > 0 ? rays / wall_seconds / 1e6 : 0) << " },\n";
+
+    out << "  \"intersection_tests\": {";
+    for (int i = static_cast<int>(stat_counter::sphere_tests); i <= static_cast<int>(stat_counter::triangle_tests); ++i)
+        out << (i == static_cast<int>(stat_counter::sphere_tests) ? " \"" : ", \"") << stat_name(static_cast<stat_counter>(i)) << "\": " << sum.counters[i];
+    out << " },\n";
+
+    out << "  \"bvh_nodes_visited\": " << sum[stat_counter::bvh_nodes] << ",\n";
+    out << "  \"bvh_nodes_per_ray\": " << (rays ? static_cast<double>(sum[stat_counter::bvh_nodes]) / rays : 0) << ",\n";
+
+    out << "  \"mean_path_length\": " << (paths ? static_cast<double>(vertices) / paths : 0) << ",\n";
+    out << "  \"path_lengths\": [";
+    int last = path_length_bins - 1;
+    while (last > 0 && sum.path_lengths[last] == 0)
+        --last;
+    for (int i = 0; i <= last; ++i)
+        out << (i ? ", " : " ") << sum.path_lengths[i];
+    out << " ],\n";
+
+    out << "  \"workers\": [\n";
+    for (size_t w = 0; w < workers.size(); ++w) {
+        const auto& s = workers[w];
+        out << "    { \"worker\": " << w << ", \"tiles\": " << s.tiles << ", \"busy_seconds\": " << s.busy_seconds
+            << ", \"rays\": " << s.rays() << " }" << (w + 1 < workers.size() ? "," : "") << '\n';
+    }
+    out << "  ],\n";
+
+    out << "  \"tiles\": [\n";
+    for (size_t i = 0; i < sum.tile_times.size(); ++i) {
+        const auto& t = sum.tile_times[i];
+        out << "    { \"x0\": " << t.x0 << ", \"y0\": " << t.y0 << ", \"x1\": " << t.x1 << ", \"y1\": " << t.y1
+            << ", \"seconds\": " << t.seconds << " }" << (i + 1 < sum.tile_times.size() ? "," : "") << '\n';
+    }
+    out << "  ]\n}\n";
+    return true;
+}
+
+inline stats_registry& render_statistics() {
+    static stats_registry registry;
+    return registry;
+}
+
+#ifdef RT_STATS
+
+const bool stats_enabled = true;
+
+inline render_stats& thread_stats() {
+    thread_local render_stats stats;
+    return stats;
+}
+
+inline void count_stat(stat_counter s, uint64_t n = 1) {
+    thread_stats().counters[static_cast<int>(s)] += n;
+}
+
+inline void count_lanes(stat_counter s, unsigned mask) {
+    uint64_t n = 0;
+    for (; mask; mask &= mask - 1)
+        ++n;
+    count_stat(s, n);
+}
+
+inline void count_path(int vertices) {
+    thread_stats().path_lengths[vertices < path_length_bins ? vertices : path_length_bins - 1] += 1;
+}
+
+// Hands the calling thread's counts to the registry under its worker index.
+inline void merge_thread_stats(unsigned worker) {
+    render_statistics().add(worker, thread_stats());
+    thread_stats() = render_stats();
+}
+
+// Times one tile from construction to destruction.
+class tile_timer {
+public:
+    tile_timer(int x0, int y0, int x1, int y1)
+        : area{ x0, y0, x1, y1, 0 }, start(std::chrono::steady_clock::now()) {}
+
+    ~tile_timer() {
+        area.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        auto& stats = thread_stats();
+        stats.tiles += 1;
+        stats.busy_seconds += area.seconds;
+        stats.tile_times.push_back(area);
+    }
+
+private:
+    tile_time area;
+    std::chrono::steady_clock::time_point start;
+};
+
+#else
+
+const bool stats_enabled = false;
+
+inline void count_stat(stat_counter, uint64_t = 1) {}
+inline void count_lanes(stat_counter, unsigned) {}
+inline void count_path(int) {}
+inline void merge_thread_stats(unsigned) {}
+
+class tile_timer {
+public:
+    tile_timer(int, int, int, int) {}
+};
+
+#endif
+
+#endif
@@ -1,33 +1,39 @@
-#ifndef TEXTURE_H
-#define TEXTURE_H
-
-//==============================================================================================
-// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
-// Ray Tracing: The Next Week. raytracing.github.io/books/RayTracingTheNextWeek.html
-// (accessed 11.06, 2022)
-//==============================================================================================
-
-#include "rtweekend.h"
-
-class texture {
-public:
-    virtual color value(double u, double v, const point3& p) const = 0;
-};
-
-class solid_color : public texture {
-public:
-    solid_color() {}
-    solid_color(color c) : color_value(c) {}
-
-    solid_color(double red, double green, double blue)
-        : solid_color(color(red, green, blue)) {}
-
-    virtual color value(double u, double v, const vec3& p) const override {
-        return color_value;
-    }
-
-private:
-    color color_value;
-};
-
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// Ray Tracing: The Next Week. raytracing.github.io/books/RayTracingTheNextWeek.html
+// (accessed 11.06, 2022)
+//==============================================================================================
+
+#include "rtweekend.h"
+
+class texture {
+public:
+    virtual color value(double u, double v, const point3& p) const = 0;
+
+    // The texture averaged over a footprint about width across in (u, v), as seen by a
+    // ray cone; textures that do not need filtering return the point value.
+    virtual color filtered(double u, double v, const point3& p, double width) const {
+        return value(u, v, p);
+    }
+};
+
+class solid_color : public texture {
+public:
+    solid_color() {}
+    solid_color(color c) : color_value(c) {}
+
+    solid_color(double red, double green, double blue)
+        : solid_color(color(red, green, blue)) {}
+
+    virtual color value(double u, double v, const vec3& p) const override {
+        return color_value;
+    }
+
+private:
+    color color_value;
+};
+
 #endif
\ No newline at end of file
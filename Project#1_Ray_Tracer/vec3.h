@@ -0,0 +1,196 @@
+#ifndef VEC3_H
+#define VEC3_H
+
+//==============================================================================================
+// Originally written in 2020 by Peter Shirley <ptrshrl@gmail.com>
+// "Ray Tracing in One Weekend." raytracing.github.io/books/RayTracingInOneWeekend.html
+//(accessed 11.06, 2022)
+//==============================================================================================
+
+#include "precision.h"
+
+#include <cmath>
+#include <iostream>
+
+using std::sqrt;
+
+// Three components of scalar type T. Geometry uses vec3 (and point3), whose precision
+// follows real; colors are always double.
+template <typename T>
+class basic_vec3 {
+public:
+    using value_type = T;
+
+    basic_vec3() : e{ 0, 0, 0 } {}
+    basic_vec3(T e0, T e1, T e2) : e{ e0, e1, e2 } {}
+
+    // Converts between precisions, e.g. a single-precision normal to a color.
+    template <typename U>
+    explicit basic_vec3(const basic_vec3<U>& v) : e{ T(v.e[0]), T(v.e[1]), T(v.e[2]) } {}
+
+    T x() const { return e[0]; }
+    T y() const { return e[1]; }
+    T z() const { return e[2]; }
+
+    basic_vec3 operator-() const { return basic_vec3(-e[0], -e[1], -e[2]); }
+    T operator[](int i) const { return e[i]; }
+    T& operator[](int i) { return e[i]; }
+
+    basic_vec3& operator+=(const basic_vec3& v) {
+        e[0] += v.e[0];
+        e[1] += v.e[1];
+        e[2] += v.e[2];
+        return *this;
+    }
+
+    basic_vec3& operator*=(const T t) {
+        e[0] *= t;
+        e[1] *= t;
+        e[2] *= t;
+        return *this;
+    }
+
+    basic_vec3& operator/=(const T t) {
+        return *this *= 1 / t;
+    }
+
+    T length() const {
+        return sqrt(length_squared());
+    }
+
+    T length_squared() const {
+        return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
+    }
+
+    bool near_zero() const {
+        // Return true if the vector is close to zero in all dimensions.
+        const auto s = 1e-8;
+        return (fabs(e[0]) < s) && (fabs(e[1]) < s) && (fabs(e[2]) < s);
+    }
+
+    inline static basic_vec3 random() {
+        return basic_vec3(random_double(), random_double(), random_double());
+    }
+
+    inline static basic_vec3 random(double min, double max) {
+        return basic_vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    }
+
+public:
+    T e[3];
+};
+
+// Type aliases for basic_vec3
+using vec3 = basic_vec3<real>;      // 3D point or direction
+using point3 = vec3;                // 3D point
+using color = basic_vec3<double>;   // RGB color
+
+// basic_vec3 Utility Functions
+//
+// Scalars are taken as the vector's own value_type, so a double literal can scale a
+// single-precision vector without a cast.
+
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const basic_vec3<T>& v) {
+    return out << v.e[0] << ' ' << v.e[1] << ' ' << v.e[2];
+}
+
+template <typename T>
+inline basic_vec3<T> operator+(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] + v.e[0], u.e[1] + v.e[1], u.e[2] + v.e[2]);
+}
+
+template <typename T>
+inline basic_vec3<T> operator-(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] - v.e[0], u.e[1] - v.e[1], u.e[2] - v.e[2]);
+}
+
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
+}
+
+template <typename T>
+inline basic_vec3<T> operator*(typename basic_vec3<T>::value_type t, const basic_vec3<T>& v) {
+    return basic_vec3<T>(t * v.e[0], t * v.e[1], t * v.e[2]);
+}
+
+template <typename T>
+inline basic_vec3<T> operator*(const basic_vec3<T>& v, typename basic_vec3<T>::value_type t) {
+    return t * v;
+}
+
+template <typename T>
+inline basic_vec3<T> operator/(basic_vec3<T> v, typename basic_vec3<T>::value_type t) {
+    return (1 / t) * v;
+}
+
+template <typename T>
+inline T dot(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return u.e[0] * v.e[0]
+         + u.e[1] * v.e[1]
+         + u.e[2] * v.e[2];
+}
+
+template <typename T>
+inline basic_vec3<T> cross(const basic_vec3<T>& u, const basic_vec3<T>& v) {
+    return basic_vec3<T>(u.e[1] * v.e[2] - u.e[2] * v.e[1],
+                         u.e[2] * v.e[0] - u.e[0] * v.e[2],
+                         u.e[0] * v.e[1] - u.e[1] * v.e[0]);
+}
+
+template <typename T>
+inline basic_vec3<T> unit_vector(basic_vec3<T> v) {
+    return v / v.length();
+}
+
+// The random directions and points below are warped from a fixed number of sampler
+// dimensions (sample_1d, sample_2d) instead of rejection sampling, so a low-discrepancy
+// sampler keeps its structure through them.
+
+inline vec3 random_unit_vector() {
+    double u, v;
+    sample_2d(u, v);
+    auto z = 1 - 2 * u;
+    auto r = sqrt(std::fmax(0.0, 1 - z * z));
+    auto phi = 2 * pi * v;
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+inline vec3 random_in_unit_sphere() {
+    auto direction = random_unit_vector();
+    return std::cbrt(sample_1d()) * direction;
+}
+
+inline vec3 random_in_hemisphere(const vec3& normal) {
+    vec3 in_unit_sphere = random_in_unit_sphere();
+    if (dot(in_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
+        return in_unit_sphere;
+    else
+        return -in_unit_sphere;
+}
+
+inline vec3 random_in_unit_disk() {
+    double u, v;
+    sample_2d(u, v);
+    auto r = sqrt(u);
+    auto phi = 2 * pi * v;
+    return vec3(r * cos(phi), r * sin(phi), 0);
+}
+
+template <typename T>
+inline basic_vec3<T> reflect(const basic_vec3<T>& v, const basic_vec3<T>& n) {
+    return v - 2 * dot(v, n) * n;
+}
+
+template <typename T>
+inline basic_vec3<T> refract(
+    const basic_vec3<T>& uv, const basic_vec3<T>& n, typename basic_vec3<T>::value_type etai_over_etat
+) {
+    auto cos_theta = fmin(dot(-uv, n), T(1.0));
+    basic_vec3<T> r_out_perp = etai_over_etat * (uv + cos_theta * n);
+    basic_vec3<T> r_out_parallel = -sqrt(fabs(1 - r_out_perp.length_squared())) * n;
+    return r_out_perp + r_out_parallel;
+}
+
+#endif